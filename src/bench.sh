@@ -0,0 +1,238 @@
+#!/bin/sh
+#
+# benchmark imd_grd_to_nc with synthetic grd files, under a range of
+# options, reporting the time taken, MB/s of input and files/s:
+#
+#   ./bench.sh [years]
+#
+# rainfall and temperature files are generated with grd_gen for the number
+# of years (default 4) in BENCH_DIR (default bench_data), and are kept for
+# the next run. each benchmark is run BENCH_REPEAT (default 3) times, and
+# the fastest time is reported. if the netCDF4 python module is available,
+# bin/imd_grd_to_nc.py is also benchmarked. the number of netCDF calls
+# putting values is also checked, and the script fails if it is not as
+# expected. a benchmark is skipped if it uses a compression codec which is
+# not available, and the script fails if a benchmark fails for any other
+# reason. if ncgen is available, netCDF files with time values counted from
+# different dates are also read back with nc_to_grd, and the script fails
+# if the days do not match
+#
+
+set -e
+
+PROGRAM=./imd_grd_to_nc
+GENERATOR=./grd_gen
+REVERSE=./nc_to_grd
+PYTHON_PROGRAM=../bin/imd_grd_to_nc.py
+BENCH_DIR=${BENCH_DIR:-bench_data}
+BENCH_REPEAT=${BENCH_REPEAT:-3}
+YEARS=${1:-4}
+FIRST_YEAR=2001
+LAST_YEAR=$((FIRST_YEAR + YEARS - 1))
+
+# current time in seconds:
+now() {
+  date +%s.%N
+}
+
+# total size in bytes of files:
+size_of() {
+  cat "$@" | wc -c
+}
+
+# run a benchmark: bench name nfiles nbytes command ...
+bench() {
+  NAME=$1
+  NFILES=$2
+  NBYTES=$3
+  shift 3
+  BEST=
+  i=0
+  while [ ${i} -lt ${BENCH_REPEAT} ] ; do
+    rm -f ${BENCH_DIR}/*.nc
+    T0=$(now)
+    if ! "$@" > /dev/null 2> ${BENCH_DIR}/bench.err ; then
+      # skip benchmarks using a codec this build does not have, and stop on
+      # any other failure:
+      if grep -q -e "^Invalid compression specified" \
+                 -e "^Compression codec not available" \
+                 ${BENCH_DIR}/bench.err ; then
+        printf "%-36s %s\n" "${NAME}" "skipped (codec not available)"
+        rm -f ${BENCH_DIR}/bench.err
+        return 0
+      fi
+      printf "%-36s %s\n" "${NAME}" "failed"
+      cat ${BENCH_DIR}/bench.err >&2
+      exit 1
+    fi
+    T1=$(now)
+    BEST=$(awk -v t0=${T0} -v t1=${T1} -v best="${BEST}" \
+           'BEGIN { t = t1 - t0 ; print (best == "" || t < best) ? t : best }')
+    i=$((i + 1))
+  done
+  awk -v name="${NAME}" -v t=${BEST} -v n=${NFILES} -v b=${NBYTES} \
+      'BEGIN { printf "%-36s %8.3f s %9.1f MB/s %8.2f files/s\n",
+               name, t, b / (t * 1048576), n / t }'
+}
+
+# check the number of netcdf calls putting values, from --stats:
+# calls name expected command ...
+calls() {
+  NAME=$1
+  EXPECTED=$2
+  shift 2
+  rm -f ${BENCH_DIR}/*.nc
+  if ! "$@" --stats=${BENCH_DIR}/stats.json > /dev/null ; then
+    printf "%-36s %s\n" "${NAME}" "failed"
+    exit 1
+  fi
+  CALLS=$(sed -n 's/.*"put_calls": \([0-9]*\).*/\1/p' ${BENCH_DIR}/stats.json)
+  rm -f ${BENCH_DIR}/stats.json
+  if [ "${CALLS}" != "${EXPECTED}" ] ; then
+    printf "%-36s %s\n" "${NAME}" "${CALLS} calls, expected ${EXPECTED}"
+    exit 1
+  fi
+  printf "%-36s %8d calls\n" "${NAME}" ${CALLS}
+}
+
+# write a netCDF file of three days at one grid point from 2001-01-01 with
+# ncgen, and read it back with nc_to_grd, checking the days against the
+# first file read: epoch name units first-time time-step
+epoch() {
+  NAME=$1
+  UNITS=$2
+  TIME=$3
+  STEP=$4
+  cat > ${BENCH_DIR}/epoch.cdl << EOF
+netcdf epoch {
+dimensions:
+  time = 3 ; lat = 1 ; lon = 1 ;
+variables:
+  double time(time) ;
+    time:units = "${UNITS}" ;
+    time:calendar = "standard" ;
+  float lat(lat) ;
+  float lon(lon) ;
+  float rainfall(time, lat, lon) ;
+data:
+  time = ${TIME}, $((TIME + STEP)), $((TIME + 2 * STEP)) ;
+  lat = 6.5 ;
+  lon = 66.5 ;
+  rainfall = 1.5, 0, 12.25 ;
+}
+EOF
+  rm -f ${BENCH_DIR}/epoch.nc ${BENCH_DIR}/epoch????.grd
+  if ! ncgen -o ${BENCH_DIR}/epoch.nc ${BENCH_DIR}/epoch.cdl ||
+     ! ${REVERSE} -i ${BENCH_DIR}/epoch.nc -o ${BENCH_DIR}/epoch%Y.grd -p \
+                 > /dev/null ; then
+    printf "%-36s %s\n" "${NAME}" "failed"
+    exit 1
+  fi
+  if [ ! -e ${BENCH_DIR}/epoch_first.grd ] ; then
+    mv ${BENCH_DIR}/epoch2001.grd ${BENCH_DIR}/epoch_first.grd
+  elif ! cmp -s ${BENCH_DIR}/epoch2001.grd ${BENCH_DIR}/epoch_first.grd ||
+       [ $(ls ${BENCH_DIR}/epoch????.grd | wc -l) -ne 1 ] ; then
+    printf "%-36s %s\n" "${NAME}" "days do not match"
+    exit 1
+  fi
+  printf "%-36s %s\n" "${NAME}" "ok"
+}
+
+# generate the input files:
+mkdir -p ${BENCH_DIR}
+YEAR=${FIRST_YEAR}
+while [ ${YEAR} -le ${LAST_YEAR} ] ; do
+  for FILE in ind${YEAR}_rfp25.grd:rain Maxtemp_MaxT_${YEAR}.GRD:maxtemp \
+              Mintemp_MinT_${YEAR}.GRD:mintemp ; do
+    if [ ! -e ${BENCH_DIR}/${FILE%:*} ] ; then
+      ${GENERATOR} -t ${FILE#*:} -y ${YEAR} -s ${YEAR} \
+                   -o ${BENCH_DIR}/${FILE%:*}
+    fi
+  done
+  YEAR=$((YEAR + 1))
+done
+if [ ! -e ${BENCH_DIR}/swapped${FIRST_YEAR}_rfp25.grd ] ; then
+  ${GENERATOR} -t rain -y ${FIRST_YEAR} -s ${FIRST_YEAR} -x \
+               -o ${BENCH_DIR}/swapped${FIRST_YEAR}_rfp25.grd
+fi
+
+RAIN=${BENCH_DIR}/ind${FIRST_YEAR}_rfp25.grd
+RAIN_SIZE=$(size_of ${RAIN})
+RAIN_ALL=$(ls ${BENCH_DIR}/ind*_rfp25.grd)
+RAIN_ALL_SIZE=$(size_of ${RAIN_ALL})
+RAIN_DAYS=$((RAIN_SIZE / (129 * 135 * 4)))
+TEMP=${BENCH_DIR}/Maxtemp_MaxT_${FIRST_YEAR}.GRD
+TEMP_SIZE=$(size_of ${TEMP})
+OUT=${BENCH_DIR}/out.nc
+
+echo "single rainfall file (${FIRST_YEAR}), best of ${BENCH_REPEAT}:"
+bench "default" 1 ${RAIN_SIZE} ${PROGRAM} -i ${RAIN} -o ${OUT}
+bench "mmap" 1 ${RAIN_SIZE} ${PROGRAM} -i ${RAIN} -o ${OUT} -m
+bench "stream" 1 ${RAIN_SIZE} ${PROGRAM} -i ${RAIN} -o ${OUT} -s
+bench "pipeline (8 days)" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --pipeline-depth 8
+bench "chunking map" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --chunking map
+bench "chunking timeseries" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --chunking timeseries
+bench "layout time-major" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --layout time-major
+bench "compression none" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --compression none
+bench "compression deflate:1 shuffle" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --compression deflate:1 --shuffle
+bench "compression zstd shuffle" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --compression zstd --shuffle
+bench "precision short" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --precision short
+bench "precision bits=10" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --precision bits=10
+bench "no quality control" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --no-qc
+bench "aggregate" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --aggregate ${BENCH_DIR}/stats.nc
+bench "zarr" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${BENCH_DIR}/out.zarr --zarr -c
+bench "zarr, 1 thread" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${RAIN} -o ${BENCH_DIR}/out.zarr --zarr -c \
+      --zarr-threads 1
+bench "byte swapped" 1 ${RAIN_SIZE} \
+      ${PROGRAM} -i ${BENCH_DIR}/swapped${FIRST_YEAR}_rfp25.grd -o ${OUT}
+if python -c 'import netCDF4' > /dev/null 2>&1 ; then
+  bench "python" 1 ${RAIN_SIZE} python ${PYTHON_PROGRAM} -i ${RAIN} -o ${OUT}
+fi
+
+# the latitude, longitude and time values are each put with a single call,
+# and the data with one call for the year, or one for each day:
+echo "netCDF put calls, single rainfall file (${FIRST_YEAR}):"
+calls "default" 4 ${PROGRAM} -i ${RAIN} -o ${OUT}
+calls "stream" $((RAIN_DAYS + 3)) ${PROGRAM} -i ${RAIN} -o ${OUT} -s
+calls "layout time-major" 4 \
+      ${PROGRAM} -i ${RAIN} -o ${OUT} --layout time-major
+
+# 1900 is not a leap year, so these are all the same days:
+if command -v ncgen > /dev/null 2>&1 ; then
+  echo "netCDF time values, read back with nc_to_grd:"
+  rm -f ${BENCH_DIR}/epoch_first.grd
+  epoch "days since 2001-01-01" "days since 2001-01-01" 0 1
+  epoch "days since 1900-01-01" "days since 1900-01-01" 36890 1
+  epoch "hours since 1900-01-01" "hours since 1900-01-01 00:00:00" \
+        885360 24
+  epoch "days since 1900-03-01" "days since 1900-03-01" 36831 1
+  rm -f ${BENCH_DIR}/epoch*
+fi
+
+echo "single temperature file (${FIRST_YEAR}):"
+bench "default" 1 ${TEMP_SIZE} ${PROGRAM} -i ${TEMP} -o ${OUT}
+
+echo "all rainfall files (${FIRST_YEAR}-${LAST_YEAR}):"
+bench "batch, 1 job" ${YEARS} ${RAIN_ALL_SIZE} ${PROGRAM} -c -j 1 ${RAIN_ALL}
+bench "batch, 4 jobs" ${YEARS} ${RAIN_ALL_SIZE} ${PROGRAM} -c -j 4 ${RAIN_ALL}
+bench "merge" ${YEARS} ${RAIN_ALL_SIZE} ${PROGRAM} -M -o ${OUT} ${RAIN_ALL}
+bench "merge, pipeline (8 days)" ${YEARS} ${RAIN_ALL_SIZE} \
+      ${PROGRAM} -M -o ${OUT} --pipeline-depth 8 ${RAIN_ALL}
+bench "merge, time-major" ${YEARS} ${RAIN_ALL_SIZE} \
+      ${PROGRAM} -M -o ${OUT} --layout time-major ${RAIN_ALL}
+
+rm -f ${BENCH_DIR}/*.nc ${BENCH_DIR}/bench.err
+rm -rf ${BENCH_DIR}/out.zarr
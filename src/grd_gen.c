@@ -0,0 +1,196 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <imdgrd.h>
+#include <grd_gen.h>
+
+/*
+ * generate synthetic IMD GRD files, of the same size and layout as the real
+ * files, for benchmarking. values are generated from a fixed seed, so the
+ * same options always give the same file
+ */
+
+/* random number generator state: */
+uint64_t rng_state;
+
+/* return a random number between 0 and 1, from a xorshift64* generator: */
+double rng_uniform(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return ((rng_state * UINT64_C(2685821657736338717)) >> 11) *
+         (1.0 / 9007199254740992.0);
+}
+
+/* print program usage information, and exit: */
+void usage(const char *program_name) {
+  printf("Usage: %s -t data-type -y data-year [-s seed] [-x] "
+         "-o output-file\n"
+         "\n"
+         "Generate a synthetic IMD GRD file, for benchmarking\n"
+         "\n"
+         "  -t --type     Data type: 'rain', 'mintemp' or 'maxtemp'\n"
+         "  -y --year     Year of the data, which sets the number of days\n"
+         "  -s --seed     Random number seed (default %d)\n"
+         "  -x --swap     Write values in the opposite byte order to this\n"
+         "                system\n"
+         "  -o --outfile  The output GRD file to create\n",
+         program_name, DEFAULT_SEED);
+  exit(1);
+}
+
+/* get program options: */
+struct _options get_options(int argc, char **argv) {
+  /* create the struct for storing program options: */
+  struct _options options = DEFAULT_OPTIONS;
+  /* define the possible getopt options: */
+  static struct option long_options[] = {
+    {"type", required_argument, 0, 't'},
+    {"year", required_argument, 0, 'y'},
+    {"seed", required_argument, 0, 's'},
+    {"swap", no_argument, 0, 'x'},
+    {"outfile", required_argument, 0, 'o'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+  /* opt will be returned by getopt_long: */
+  int opt;
+  /* loop through arguments: */
+  while ((opt = getopt_long(argc, argv, "t:y:s:xo:h", long_options,
+                            NULL)) != -1) {
+    switch (opt) {
+      case 't':
+        if (strcmp(optarg, "rain") == 0) {
+          options.type = IMDGRD_RAIN;
+        } else if (strcmp(optarg, "mintemp") == 0) {
+          options.type = IMDGRD_MINTEMP;
+        } else if (strcmp(optarg, "maxtemp") == 0) {
+          options.type = IMDGRD_MAXTEMP;
+        } else {
+          fprintf(stderr, "Invalid data type specified: %s\n", optarg);
+          exit(1);
+        }
+        break;
+      case 'y':
+        options.year = atoi(optarg);
+        break;
+      case 's':
+        options.seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'x':
+        options.swap = 1;
+        break;
+      case 'o':
+        options.outfile = optarg;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  /* type, year and output file are required: */
+  if ((options.type == -1) || (options.year == -1) ||
+      (strcmp(options.outfile, "") == 0)) {
+    usage(argv[0]);
+  }
+  /* return the program options: */
+  return options;
+}
+
+/*
+ * generate the values for a single day. rainfall is zero or exponentially
+ * distributed, with more rain during june to september. temperature follows
+ * an annual cycle, and is cooler further north:
+ */
+void generate_day(struct _options *options, const struct imdgrd_grid *grid,
+                  int day, int ndays, float *values) {
+  /* whether the day is in june to september, and seasonal temperature: */
+  int monsoon = (day >= 151) && (day < 273);
+  double season = sin(2 * M_PI * (day - 105) / ndays);
+  /* lat and lon of the grid point, and distance from the land centre: */
+  double lat, lon, distance;
+  /* generated value: */
+  double value;
+  /* for loop integers: */
+  int i, j;
+  /* loop through grid points: */
+  for (i = 0; i < grid->nlats; i++) {
+    lat = grid->lat0 + i * grid->grid;
+    for (j = 0; j < grid->nlons; j++) {
+      lon = grid->lon0 + j * grid->grid;
+      distance = pow((lat - LAND_LAT) / LAND_LAT_RADIUS, 2) +
+                 pow((lon - LAND_LON) / LAND_LON_RADIUS, 2);
+      /* random numbers are drawn for every point, so that the sequence
+         does not depend on the land area: */
+      if (options->type == IMDGRD_RAIN) {
+        value = (rng_uniform() < (monsoon ? MONSOON_RAIN_PROBABILITY :
+                                  RAIN_PROBABILITY)) ?
+                -log(1 - rng_uniform()) *
+                (monsoon ? MONSOON_RAIN_MEAN : RAIN_MEAN) : 0;
+        value = round(value * 10) / 10;
+      } else {
+        value = TEMP_BASE + TEMP_LAT_GRADIENT * lat +
+                TEMP_AMPLITUDE * season +
+                ((options->type == IMDGRD_MAXTEMP) ?
+                 TEMP_RANGE : -TEMP_RANGE) +
+                TEMP_NOISE * (2 * rng_uniform() - 1);
+        value = round(value * 100) / 100;
+      }
+      values[i * grid->nlons + j] = (distance <= 1) ? value : grid->fill;
+    }
+  }
+}
+
+/* main program: */
+int main(int argc, char **argv) {
+  /* program options: */
+  struct _options options = get_options(argc, argv);
+  /* grid, number of days and values for a day: */
+  const struct imdgrd_grid *grid =
+    &imdgrd_builtin_grids[(options.type == IMDGRD_RAIN) ? 0 : 1];
+  int ndays = imdgrd_year_days(options.year);
+  size_t count = (size_t) grid->nlats * grid->nlons;
+  float *values;
+  /* output file: */
+  FILE *output_file;
+  /* for loop integers: */
+  int i;
+  /* allocate the values: */
+  if ((values = malloc(count * sizeof(float))) == NULL) {
+    fprintf(stderr, "Unable to allocate memory\n");
+    exit(1);
+  }
+  /* open the output file: */
+  if ((output_file = fopen(options.outfile, "wb")) == NULL) {
+    fprintf(stderr, "Unable to open output file: %s\n", options.outfile);
+    free(values);
+    exit(1);
+  }
+  /* write the days, then the trailing byte found at the end of grd files: */
+  rng_state = options.seed * UINT64_C(0x9e3779b97f4a7c15) + 1;
+  for (i = 0; i < ndays; i++) {
+    generate_day(&options, grid, i, ndays, values);
+    if (options.swap == 1) {
+      imdgrd_swap_values(values, values, count);
+    }
+    if (fwrite(values, sizeof(float), count, output_file) != count) {
+      break;
+    }
+  }
+  if ((i < ndays) || (fputc(0, output_file) == EOF)) {
+    fprintf(stderr, "Error writing output file: %s\n", options.outfile);
+    fclose(output_file);
+    free(values);
+    exit(1);
+  }
+  free(values);
+  /* close the output file: */
+  if (fclose(output_file) != 0) {
+    fprintf(stderr, "Error writing output file: %s\n", options.outfile);
+    exit(1);
+  }
+  /* exit: */
+  exit(0);
+}
@@ -0,0 +1,48 @@
+/* default random number seed: */
+#define DEFAULT_SEED 1
+
+/*
+ * land area, as an ellipse (centre lat and lon, and radii in degrees).
+ * points outside of the ellipse are set to the fill value:
+ */
+#define LAND_LAT 22.5
+#define LAND_LON 80.0
+#define LAND_LAT_RADIUS 15.0
+#define LAND_LON_RADIUS 12.0
+
+/*
+ * probability of rain and mean rainfall (mm) on a rainy day, outside of
+ * and during june to september:
+ */
+#define RAIN_PROBABILITY 0.15
+#define MONSOON_RAIN_PROBABILITY 0.65
+#define RAIN_MEAN 4.0
+#define MONSOON_RAIN_MEAN 18.0
+
+/*
+ * temperature (celsius) at the equator, change per degree of latitude,
+ * amplitude of the annual cycle, difference of max and min temperatures
+ * from the daily mean, and amplitude of daily noise:
+ */
+#define TEMP_BASE 31.0
+#define TEMP_LAT_GRADIENT -0.35
+#define TEMP_AMPLITUDE 7.0
+#define TEMP_RANGE 6.0
+#define TEMP_NOISE 1.5
+
+/* define struct for storing program options: */
+struct _options {
+  /* output file: */
+  const char *outfile;
+  /* data type: */
+  int type;
+  /* data year: */
+  int year;
+  /* random number seed: */
+  unsigned long seed;
+  /* whether values should be written in the opposite byte order: */
+  int swap;
+};
+const struct _options DEFAULT_OPTIONS = {
+  "", -1, -1, DEFAULT_SEED, 0
+};
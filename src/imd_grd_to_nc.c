@@ -1,9 +1,22 @@
+#include <dirent.h>
 #include <getopt.h>
+#include <glob.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
 #include <regex.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
 #include <netcdf.h>
+#include <imdgrd.h>
 #include <imd_grd_to_nc.h>
 
 /* program name: */
@@ -27,15 +40,51 @@ const char *basename(char *path) {
   return bn;
 }
 
+/*
+ * return the current time in seconds, from a monotonic clock, for timing
+ * sections of the program:
+ */
+double get_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 /*
  * print program usage information
  */
 int usage(int full) {
   /* short usage: */
   printf("Usage: %s "
-         "-i input-file "
+         "-i input-file | [-l list-file] [-j jobs] input-files ... "
          "[-o output-file] "
          "[-c] "
+         "[-m] "
+         "[-s] "
+         "[-M] "
+         "[--pipeline-depth n] "
+         "[--chunking layout] "
+         "[--layout layout] "
+         "[--precision precision] "
+         "[--compression codec[:level]] "
+         "[--shuffle] "
+         "[--benchmark-codecs] "
+         "[--grids grid-file] "
+         "[--bbox lat0,lat1,lon0,lon1] "
+         "[--mask mask-file] "
+         "[--aggregate stats-file] "
+         "[--missing value[,value ...]] "
+         "[--qc-report csv-file] "
+         "[--no-qc] "
+         "[--endian byte-order] "
+         "[--stats[=json-file]] "
+         "[--incremental] "
+         "[--zarr] "
+         "[--zarr-threads n] "
+         "[--query lat,lon[,start,end]] "
+         "[--regrid grid] "
+         "[--regrid-threads n] "
+         "[--regrid-cache directory] "
          "[-t data-type] "
          "[-t data-year] "
          "[-v netcdf-varname] "
@@ -48,10 +97,124 @@ int usage(int full) {
            "\n"
            "  -h --help         Display this help message and exit\n"
            "  -i --infile       The input GRD file to read\n"
+           "  input-files       Convert more than one input file. Glob patterns are\n"
+           "                    expanded. The output file name for each input file is\n"
+           "                    determined from the input file name\n"
+           "  -l --list         A file containing input files to convert, one per line\n"
+           "                    Use '-' to read the list from standard input\n"
+           "  -j --jobs         Number of input files to convert in parallel\n"
+           "                    A summary of the conversions is displayed\n"
+           "  -M --merge        Merge the input files, which should be consecutive\n"
+           "                    years of the same data type, in to a single output\n"
+           "                    file (-o) with a continuous time axis. When built\n"
+           "                    with 'make mpi' and run with mpirun, the years are\n"
+           "                    converted and written in parallel\n"
            "  -o --outfile      The output NetCDF file to create\n"
            "                    If not specified, the input file name will be used to\n"
            "                    determine a name for the output file\n"
            "  -c --clobber      Overwrite an existing output file\n"
+           "  -m --mmap         Memory map the input file, rather than reading it in\n"
+           "                    to memory. Data is passed to NetCDF directly from the\n"
+           "                    mapped file\n"
+           "  -s --stream       Convert the data one day at a time, so that only a\n"
+           "                    single day of data is held in memory\n"
+           "  --pipeline-depth  Read the input in a separate thread, while the data\n"
+           "                    is written to NetCDF, using this many day buffers\n"
+           "                    Implies --stream. Read and write times are reported\n"
+           "  --chunking        Chunk layout of the data in the NetCDF output file\n"
+           "                    'map' stores each day as a single chunk, for fast\n"
+           "                    reading of daily maps\n"
+           "                    'timeseries' stores up to a year of days for small\n"
+           "                    tiles of grid points, for fast reading of point time\n"
+           "                    series\n"
+           "                    A custom chunk size can be specified as time,lat,lon\n"
+           "                    If not specified, the NetCDF library default is used\n"
+           "  --layout          Order of the dimensions of the data in the NetCDF\n"
+           "                    output file\n"
+           "                    'day-major' is (time, lat, lon), as in the GRD file\n"
+           "                    (default)\n"
+           "                    'time-major' is (lat, lon, time), so that the time\n"
+           "                    series for each grid point is contiguous. The days\n"
+           "                    are transposed in memory, a chunk of days at a\n"
+           "                    time, and 'timeseries' chunking is the default\n"
+           "  --precision       Precision of the data in the NetCDF output file\n"
+           "                    'float' stores the values unchanged (default)\n"
+           "                    'short' packs values in to shorts with a scale factor\n"
+           "                    and offset, to 0.1 mm for rainfall and 0.01 celsius\n"
+           "                    for temperature\n"
+           "                    'bits=n' rounds float values to n mantissa bits, so\n"
+           "                    that they compress better\n"
+           "  --compression     Compression codec, and optionally level, for the data\n"
+           "                    in the NetCDF output file, e.g. 'deflate:6'\n"
+           "                    Valid codecs are 'none', 'deflate' (default, level 3)\n"
+           "                    and, if available in the NetCDF library, 'zstd',\n"
+           "                    'szip' and 'blosc'\n"
+           "  --shuffle         Enable the shuffle filter before compression\n"
+           "  --benchmark-codecs\n"
+           "                    Convert the input file with a range of compression\n"
+           "                    settings, and report the output size, write time and\n"
+           "                    read time for each. No output file is kept\n"
+           "  --grids           A file describing additional grids, one per line as:\n"
+           "                    name type lat0 lon0 grid nlats nlons fill [var [units]]\n"
+           "                    Grids are recognised from the input file size. The\n"
+           "                    file can also be set with the IMDGRD_GRIDS environment\n"
+           "                    variable\n"
+           "  --bbox            Only convert grid points within a bounding box,\n"
+           "                    specified as lat0,lat1,lon0,lon1\n"
+           "  --mask            Only convert grid points selected by a mask, from a\n"
+           "                    NetCDF file containing a 'mask' variable on the same\n"
+           "                    grid. Grid points which are not selected are set to\n"
+           "                    the fill value\n"
+           "  --aggregate       Also write monthly, June to September (monsoon) and\n"
+           "                    annual statistics to this NetCDF file. The mean,\n"
+           "                    maximum and minimum are calculated for each grid\n"
+           "                    point, and for rainfall the sum and the number of\n"
+           "                    rainy days (at least 2.5 mm)\n"
+           "  --missing         Alternative missing value markers in the input file,\n"
+           "                    which are replaced with the fill value, e.g. -99.9\n"
+           "  --qc-report       Write the number of valid, fill, missing and out of\n"
+           "                    range values, and the minimum and maximum valid\n"
+           "                    values, for each day to this CSV file\n"
+           "  --no-qc           Do not check the values. By default, the number of\n"
+           "                    values outside of the possible range for the data\n"
+           "                    type (negative rainfall, temperatures outside of\n"
+           "                    -60 to 60 celsius) is reported\n"
+           "  --endian          Byte order of the values in the input file\n"
+           "                    'auto' checks which byte order gives plausible values\n"
+           "                    for the first days of the file (default)\n"
+           "                    'native', 'little' or 'big' use a fixed byte order\n"
+           "  --stats           Output performance statistics as JSON, to standard\n"
+           "                    output or a file: the time spent in each phase of\n"
+           "                    the conversion, bytes read and written, compression\n"
+           "                    ratio and peak memory use\n"
+           "  --incremental     Skip the conversion if the output file is up to\n"
+           "                    date with the input file, or only convert the new\n"
+           "                    days if the input file has grown. The size,\n"
+           "                    modification time and a hash of the input file are\n"
+           "                    recorded in the output file. An output file which is\n"
+           "                    out of date is converted again, without -c\n"
+           "  --zarr            Write a Zarr (version 2) directory store, rather\n"
+           "                    than a NetCDF file. The default output name ends\n"
+           "                    with '.zarr'. Only 'none' and 'deflate' compression\n"
+           "                    are available, and chunks are compressed in\n"
+           "                    parallel\n"
+           "  --zarr-threads    Number of threads compressing Zarr chunks\n"
+           "                    (default: one per processor)\n"
+           "  --query           Write the time series for the grid point nearest\n"
+           "                    to lat,lon from the input files as CSV to standard\n"
+           "                    output, rather than converting. Optionally from\n"
+           "                    start to end, as YYYY-MM-DD dates. Only the values\n"
+           "                    for the point are read\n"
+           "  --regrid          Regrid the values to another grid, e.g. 'temp_1.0'\n"
+           "                    or 'rain_0.25', or a grid from the grid file, by\n"
+           "                    first order conservative remapping. Grid points\n"
+           "                    less than half covered by valid values are set\n"
+           "                    to the fill value\n"
+           "  --regrid-threads  Number of threads regridding days\n"
+           "                    (default: one per processor)\n"
+           "  --regrid-cache    Directory for cached regridding weights. The\n"
+           "                    default is set by the IMDGRD_REGRID_CACHE\n"
+           "                    environment variable, or is ~/.cache/imdgrd\n"
            "  -t --type         Data type of the input file\n"
            "                    Valid options are 'rain', 'mintemp' and 'maxtemp'\n"
            "                    If not specified, the input data type will be will be\n"
@@ -69,6 +232,245 @@ int usage(int full) {
   exit(1);
 }
 
+/*
+ * parse a compression option, of the form codec[:level], and store the
+ * codec and level. returns 0 on success:
+ */
+int parse_compression(const char *arg) {
+  /* codec name length: */
+  size_t name_len = strcspn(arg, ":");
+  /* compression level: */
+  int level;
+  /* for loop integers: */
+  int i;
+  /* find the codec: */
+  for (i = 0; i <= IMDGRD_CODEC_BLOSC; i++) {
+    if ((strlen(imdgrd_codec_names[i]) == name_len) &&
+        (strncmp(arg, imdgrd_codec_names[i], name_len) == 0)) {
+      break;
+    }
+  }
+  if ((i > IMDGRD_CODEC_BLOSC) || (imdgrd_codec_available(i) == 0)) {
+    return 1;
+  }
+  /* get the level, if specified, otherwise use the default: */
+  level = imdgrd_codec_levels[i];
+  if ((arg[name_len] == ':') &&
+      (sscanf(arg + name_len + 1, "%d", &level) != 1)) {
+    return 1;
+  }
+  /* check the level is valid for the codec: */
+  if (((i == IMDGRD_CODEC_DEFLATE) && ((level < 1) || (level > 9))) ||
+      ((i == IMDGRD_CODEC_ZSTD) && ((level < 1) || (level > 22))) ||
+      ((i == IMDGRD_CODEC_BLOSC) && ((level < 0) || (level > 9)))) {
+    return 1;
+  }
+  /* store the codec and level: */
+  compression_codec = i;
+  compression_level = level;
+  return 0;
+}
+
+/*
+ * get the number of days in a month of a year, using the same rule for leap
+ * years as the input files, which are checked against the year:
+ */
+int month_length(int year, int month) {
+  /* days in each month: */
+  const int month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30,
+                              31};
+  return ((month == 2) && (imdgrd_year_days(year) == 366)) ? 29 :
+         month_days[month - 1];
+}
+
+/*
+ * parse a date, of the form YYYY-MM-DD, and store the year and day of the
+ * year (from 0). returns 0 on success:
+ */
+int parse_date(const char *arg, int *year, int *day) {
+  /* month and day of the month, and number of characters parsed: */
+  int month, mday, n = 0;
+  /* for loop integers: */
+  int i;
+  if ((sscanf(arg, "%4d-%2d-%2d%n", year, &month, &mday, &n) != 3) ||
+      (arg[n] != '\0') || (month < 1) || (month > 12) || (mday < 1) ||
+      (mday > month_length(*year, month))) {
+    return 1;
+  }
+  *day = mday - 1;
+  for (i = 1; i < month; i++) {
+    *day += month_length(*year, i);
+  }
+  return 0;
+}
+
+/*
+ * format a year and day of the year (from 0) as YYYY-MM-DD, in to str of
+ * size bytes:
+ */
+void format_date(int year, int day, char *str, size_t size) {
+  /* month: */
+  int month = 1;
+  while (day >= month_length(year, month)) {
+    day -= month_length(year, month);
+    month++;
+  }
+  snprintf(str, size, "%04d-%02d-%02d", year, month, day + 1);
+}
+
+/*
+ * parse a query option, of the form lat,lon[,start,end], and store the
+ * point and the dates. returns 0 on success:
+ */
+int parse_query(const char *arg) {
+  /* number of characters parsed, and the dates: */
+  int n = 0;
+  char start[11], end[11];
+  if (sscanf(arg, "%f,%f%n", &query_point[0], &query_point[1], &n) != 2) {
+    return 1;
+  }
+  /* all days: */
+  if (arg[n] == '\0') {
+    return 0;
+  }
+  /* first and last day: */
+  if ((sscanf(arg + n, ",%10[^,],%10s", start, end) != 2) ||
+      (parse_date(start, &query_start[0], &query_start[1]) != 0) ||
+      (parse_date(end, &query_end[0], &query_end[1]) != 0) ||
+      (query_start[0] * 1000 + query_start[1] >
+       query_end[0] * 1000 + query_end[1])) {
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * parse a comma separated list of missing value markers, and store them in
+ * the quality control settings. returns 0 on success:
+ */
+int parse_missing(const char *arg) {
+  /* end of the parsed value: */
+  char *end;
+  /* loop through values: */
+  while (qc.nmissing < IMDGRD_QC_MAX_MISSING) {
+    qc.missing[qc.nmissing] = strtof(arg, &end);
+    if (end == arg) {
+      return 1;
+    }
+    qc.nmissing++;
+    if (*end == '\0') {
+      return 0;
+    }
+    if (*end != ',') {
+      return 1;
+    }
+    arg = end + 1;
+  }
+  /* too many values: */
+  return 1;
+}
+
+/* add a file to the list of input files in the options: */
+void add_infile(struct _options *options, const char *filename) {
+  options->infiles = realloc(options->infiles,
+                             (options->ninfiles + 1) * sizeof(char *));
+  options->infiles[options->ninfiles] = strdup(filename);
+  options->ninfiles++;
+}
+
+/*
+ * get the full list of input files, from the -i option, any remaining
+ * command line arguments (expanding any glob patterns) and the list file.
+ * if there is a single input file, it is stored as the infile option:
+ */
+void get_infiles(struct _options *options, int nargs, char **args) {
+  /* list file handle: */
+  FILE *list_file;
+  /* line from the list file: */
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t line_len;
+  /* glob results: */
+  glob_t glob_result;
+  /* for loop integers: */
+  int i;
+  size_t j;
+  /* input file specified with -i: */
+  if (strcmp(options->infile, "") != 0) {
+    add_infile(options, options->infile);
+  }
+  /* remaining arguments. try to expand each one as a glob pattern: */
+  for (i = 0; i < nargs; i++) {
+    if ((glob(args[i], 0, NULL, &glob_result) == 0) &&
+        (glob_result.gl_pathc > 0)) {
+      for (j = 0; j < glob_result.gl_pathc; j++) {
+        add_infile(options, glob_result.gl_pathv[j]);
+      }
+    } else {
+      /* no matches, use as is, so that the missing file is reported: */
+      add_infile(options, args[i]);
+    }
+    globfree(&glob_result);
+  }
+  /* list file: */
+  if (strcmp(options->listfile, "") != 0) {
+    if (strcmp(options->listfile, "-") == 0) {
+      list_file = stdin;
+    } else if ((list_file = fopen(options->listfile, "r")) == NULL) {
+      fprintf(stderr, "Unable to open list file: %s\n", options->listfile);
+      exit(1);
+    }
+    /* one file per line, ignoring blank lines: */
+    while ((line_len = getline(&line, &line_size, list_file)) != -1) {
+      while ((line_len > 0) &&
+             ((line[line_len - 1] == '\n') || (line[line_len - 1] == '\r') ||
+              (line[line_len - 1] == ' '))) {
+        line[--line_len] = '\0';
+      }
+      if (line_len > 0) {
+        add_infile(options, line);
+      }
+    }
+    free(line);
+    if (list_file != stdin) {
+      fclose(list_file);
+    }
+  }
+  /* a single input file is converted as before: */
+  if (options->ninfiles == 1) {
+    options->infile = options->infiles[0];
+  }
+}
+
+/*
+ * set up the regridding, to the grid named by the regrid option, with
+ * weights cached in the regrid-cache directory, the directory from the
+ * environment, or the default directory in the home directory:
+ */
+void setup_regrid(void) {
+  /* target grid: */
+  const struct imdgrd_grid *target = imdgrd_get_grid(regrid_grid);
+  /* default cache directory: */
+  char *cache_dir;
+  if (target == NULL) {
+    fprintf(stderr, "Unknown grid specified: %s\n", regrid_grid);
+    fprintf(stderr, "Valid grids: %s, %s, or a grid from the grid file\n",
+            imdgrd_builtin_grids[0].name, imdgrd_builtin_grids[1].name);
+    exit(1);
+  }
+  if ((regrid_cache == NULL) && (getenv(IMDGRD_REGRID_CACHE_ENV) != NULL)) {
+    regrid_cache = getenv(IMDGRD_REGRID_CACHE_ENV);
+  }
+  if ((regrid_cache == NULL) && (getenv("HOME") != NULL)) {
+    cache_dir = malloc(strlen(getenv("HOME")) + strlen(REGRID_CACHE_DIR) + 2);
+    if (cache_dir != NULL) {
+      sprintf(cache_dir, "%s/%s", getenv("HOME"), REGRID_CACHE_DIR);
+    }
+    regrid_cache = cache_dir;
+  }
+  imdgrd_init_regrid(&regrid, target, regrid_cache, regrid_threads);
+}
+
 /*
  * get the program options and return an _options struct containing the options
  */
@@ -78,8 +480,36 @@ struct _options get_options(int argc, char **argv) {
   /* define the possible getopt options: */
   static struct option long_options[] = {
     {"infile", required_argument, 0, 'i'},
+    {"list", required_argument, 0, 'l'},
+    {"jobs", required_argument, 0, 'j'},
+    {"merge", no_argument, 0, 'M'},
     {"outfile", required_argument, 0, 'o'},
     {"clobber", no_argument, 0, 'c'},
+    {"mmap", no_argument, 0, 'm'},
+    {"stream", no_argument, 0, 's'},
+    {"pipeline-depth", required_argument, 0, OPT_PIPELINE_DEPTH},
+    {"chunking", required_argument, 0, OPT_CHUNKING},
+    {"layout", required_argument, 0, OPT_LAYOUT},
+    {"precision", required_argument, 0, OPT_PRECISION},
+    {"compression", required_argument, 0, OPT_COMPRESSION},
+    {"shuffle", no_argument, 0, OPT_SHUFFLE},
+    {"benchmark-codecs", no_argument, 0, OPT_BENCHMARK_CODECS},
+    {"grids", required_argument, 0, OPT_GRIDS},
+    {"bbox", required_argument, 0, OPT_BBOX},
+    {"mask", required_argument, 0, OPT_MASK},
+    {"aggregate", required_argument, 0, OPT_AGGREGATE},
+    {"missing", required_argument, 0, OPT_MISSING},
+    {"qc-report", required_argument, 0, OPT_QC_REPORT},
+    {"no-qc", no_argument, 0, OPT_NO_QC},
+    {"endian", required_argument, 0, OPT_ENDIAN},
+    {"stats", optional_argument, 0, OPT_STATS},
+    {"incremental", no_argument, 0, OPT_INCREMENTAL},
+    {"zarr", no_argument, 0, OPT_ZARR},
+    {"zarr-threads", required_argument, 0, OPT_ZARR_THREADS},
+    {"query", required_argument, 0, OPT_QUERY},
+    {"regrid", required_argument, 0, OPT_REGRID},
+    {"regrid-threads", required_argument, 0, OPT_REGRID_THREADS},
+    {"regrid-cache", required_argument, 0, OPT_REGRID_CACHE},
     {"ncvar", required_argument, 0, 'v'},
     {"ncunits", required_argument, 0, 'u'},
     {"type", required_argument, 0, 't'},
@@ -91,10 +521,12 @@ struct _options get_options(int argc, char **argv) {
   int opt;
   /* for storing char representations of the option: */
   char opt_char, arg_char;
+  /* for loop integers: */
+  int i;
   /* don't print getopt error messages: */
   opterr = 0;
   /* getopt_long() is not -1, i.e. parse all program options: */
-  while((opt = getopt_long(argc, argv, "i:o:cv:u:t:y:h", long_options,
+  while((opt = getopt_long(argc, argv, "i:l:j:Mo:cmsv:u:t:y:h", long_options,
                            NULL)) != -1) {
     /* switch for argument checking: */
     switch (opt) {
@@ -102,6 +534,25 @@ struct _options get_options(int argc, char **argv) {
       case 'i':
         options.infile = optarg;
         break;
+      /* file containing list of input files: */
+      case 'l':
+        options.listfile = optarg;
+        break;
+      /* number of parallel conversions: */
+      case 'j':
+        /* convert to integer: */
+        options.jobs = atoi(optarg);
+        /* check value is within valid range: */
+        if ((options.jobs < 1) ||
+            (options.jobs > MAX_JOBS)) {
+          fprintf(stderr, "Invalid number of jobs specified: %s\n", optarg);
+          exit(1);
+        }
+        break;
+      /* merge input files: */
+      case 'M':
+        merge_flag = 1;
+        break;
       /* output file name: */
       case 'o':
         options.outfile = optarg;
@@ -110,6 +561,201 @@ struct _options get_options(int argc, char **argv) {
       case 'c':
         clobber_flag = 1;
         break;
+      /* enable memory mapping of input: */
+      case 'm':
+        mmap_flag = 1;
+        break;
+      /* enable day by day conversion: */
+      case 's':
+        stream_flag = 1;
+        break;
+      /* number of day buffers for reader thread: */
+      case OPT_PIPELINE_DEPTH:
+        /* convert to integer: */
+        pipeline_depth = atoi(optarg);
+        /* check value is within valid range: */
+        if ((pipeline_depth < 1) ||
+            (pipeline_depth > MAX_PIPELINE_DEPTH)) {
+          fprintf(stderr, "Invalid pipeline depth specified: %s\n", optarg);
+          exit(1);
+        }
+        /* the pipeline converts one day at a time: */
+        stream_flag = 1;
+        break;
+      /* chunk layout: */
+      case OPT_CHUNKING:
+        if (strcmp(optarg, "map") == 0) {
+          chunk_layout = IMDGRD_CHUNK_MAP;
+        } else if (strcmp(optarg, "timeseries") == 0) {
+          chunk_layout = IMDGRD_CHUNK_TIMESERIES;
+        } else if ((sscanf(optarg, "%zu,%zu,%zu", &chunk_sizes[0],
+                           &chunk_sizes[1], &chunk_sizes[2]) == 3) &&
+                   (chunk_sizes[0] > 0) && (chunk_sizes[1] > 0) &&
+                   (chunk_sizes[2] > 0)) {
+          chunk_layout = IMDGRD_CHUNK_CUSTOM;
+        } else {
+          fprintf(stderr, "Invalid chunk layout specified: %s\n", optarg);
+          fprintf(stderr, "Valid chunk layouts: map, timeseries, "
+                          "time,lat,lon\n");
+          exit(1);
+        }
+        break;
+      /* data variable layout: */
+      case OPT_LAYOUT:
+        if (strcmp(optarg, "day-major") == 0) {
+          data_layout = IMDGRD_LAYOUT_DAY_MAJOR;
+        } else if (strcmp(optarg, "time-major") == 0) {
+          data_layout = IMDGRD_LAYOUT_TIME_MAJOR;
+        } else {
+          fprintf(stderr, "Invalid layout specified: %s\n", optarg);
+          fprintf(stderr, "Valid layouts: day-major, time-major\n");
+          exit(1);
+        }
+        break;
+      /* output precision: */
+      case OPT_PRECISION:
+        if (strcmp(optarg, "float") == 0) {
+          precision_type = IMDGRD_PRECISION_FLOAT;
+        } else if (strcmp(optarg, "short") == 0) {
+          precision_type = IMDGRD_PRECISION_SHORT;
+        } else if ((sscanf(optarg, "bits=%d", &precision_bits) == 1) &&
+                   (precision_bits > 0) &&
+                   (precision_bits <= IMDGRD_FLOAT_MANTISSA_BITS)) {
+          precision_type = IMDGRD_PRECISION_BITS;
+        } else {
+          fprintf(stderr, "Invalid precision specified: %s\n", optarg);
+          fprintf(stderr, "Valid precisions: float, short, bits=1 ... "
+                          "bits=%d\n", IMDGRD_FLOAT_MANTISSA_BITS);
+          exit(1);
+        }
+        break;
+      /* compression codec and level: */
+      case OPT_COMPRESSION:
+        if (parse_compression(optarg) != 0) {
+          fprintf(stderr, "Invalid compression specified: %s\n", optarg);
+          fprintf(stderr, "Valid compression codecs:");
+          for (i = 0; i <= IMDGRD_CODEC_BLOSC; i++) {
+            if (imdgrd_codec_available(i) == 1) {
+              fprintf(stderr, " %s", imdgrd_codec_names[i]);
+            }
+          }
+          fprintf(stderr, "\n");
+          exit(1);
+        }
+        break;
+      /* enable shuffle filter: */
+      case OPT_SHUFFLE:
+        shuffle_flag = 1;
+        break;
+      /* benchmark compression codecs: */
+      case OPT_BENCHMARK_CODECS:
+        benchmark_codecs_flag = 1;
+        break;
+      /* file containing additional grids: */
+      case OPT_GRIDS:
+        options.gridfile = optarg;
+        break;
+      /* bounding box: */
+      case OPT_BBOX:
+        if (sscanf(optarg, "%f,%f,%f,%f", &bbox[0], &bbox[1], &bbox[2],
+                   &bbox[3]) != 4) {
+          fprintf(stderr, "Invalid bounding box specified: %s\n", optarg);
+          fprintf(stderr, "Bounding box should be specified as "
+                          "lat0,lat1,lon0,lon1\n");
+          exit(1);
+        }
+        bbox_flag = 1;
+        break;
+      /* mask file: */
+      case OPT_MASK:
+        mask_file = optarg;
+        break;
+      /* statistics file: */
+      case OPT_AGGREGATE:
+        aggregate_file = optarg;
+        break;
+      /* alternative missing value markers: */
+      case OPT_MISSING:
+        if (parse_missing(optarg) != 0) {
+          fprintf(stderr, "Invalid missing values specified: %s\n", optarg);
+          fprintf(stderr, "Up to %d comma separated values can be "
+                          "specified\n", IMDGRD_QC_MAX_MISSING);
+          exit(1);
+        }
+        break;
+      /* quality control report: */
+      case OPT_QC_REPORT:
+        qc_report_file = optarg;
+        break;
+      /* disable quality control: */
+      case OPT_NO_QC:
+        qc_flag = 0;
+        break;
+      /* byte order: */
+      case OPT_ENDIAN:
+        for (i = IMDGRD_ENDIAN_AUTO; i <= IMDGRD_ENDIAN_BIG; i++) {
+          if (strcmp(optarg, imdgrd_endian_names[i]) == 0) {
+            break;
+          }
+        }
+        if (i > IMDGRD_ENDIAN_BIG) {
+          fprintf(stderr, "Invalid byte order specified: %s\n", optarg);
+          fprintf(stderr, "Valid byte orders: auto, native, little, big\n");
+          exit(1);
+        }
+        endian = i;
+        break;
+      /* performance statistics: */
+      case OPT_STATS:
+        perf_flag = 1;
+        perf_file = optarg;
+        break;
+      /* incremental conversion: */
+      case OPT_INCREMENTAL:
+        incremental_flag = 1;
+        break;
+      /* zarr output: */
+      case OPT_ZARR:
+        output_format = IMDGRD_FORMAT_ZARR;
+        nc_ext = zarr_ext;
+        break;
+      /* number of threads compressing zarr chunks: */
+      case OPT_ZARR_THREADS:
+        zarr_threads = atoi(optarg);
+        if ((zarr_threads < 1) || (zarr_threads > IMDGRD_ZARR_MAX_THREADS)) {
+          fprintf(stderr, "Invalid number of Zarr threads specified: %s\n",
+                  optarg);
+          exit(1);
+        }
+        break;
+      /* time series query: */
+      case OPT_QUERY:
+        if (parse_query(optarg) != 0) {
+          fprintf(stderr, "Invalid query specified: %s\n", optarg);
+          fprintf(stderr, "The query should be lat,lon or "
+                          "lat,lon,YYYY-MM-DD,YYYY-MM-DD\n");
+          exit(1);
+        }
+        query_flag = 1;
+        break;
+      /* grid to regrid to: */
+      case OPT_REGRID:
+        regrid_grid = optarg;
+        break;
+      /* number of threads regridding days: */
+      case OPT_REGRID_THREADS:
+        regrid_threads = atoi(optarg);
+        if ((regrid_threads < 1) ||
+            (regrid_threads > IMDGRD_REGRID_MAX_THREADS)) {
+          fprintf(stderr, "Invalid number of regridding threads specified: "
+                          "%s\n", optarg);
+          exit(1);
+        }
+        break;
+      /* directory for cached regridding weights: */
+      case OPT_REGRID_CACHE:
+        regrid_cache = optarg;
+        break;
       /* variable name for netcdf output: */
       case 'v':
         options.ncvar = optarg;
@@ -133,11 +779,11 @@ struct _options get_options(int argc, char **argv) {
       case 't':
         /* acceptable types are 'rain' or 'temp': */
         if (strcmp(optarg, "rain") == 0) {
-          options.type = RAIN;
+          options.type = IMDGRD_RAIN;
         } else if (strcmp(optarg, "mintemp") == 0) {
-          options.type = MINTEMP;
+          options.type = IMDGRD_MINTEMP;
         } else if (strcmp(optarg, "maxtemp") == 0) {
-          options.type = MAXTEMP;
+          options.type = IMDGRD_MAXTEMP;
         } else {
           fprintf(stderr, "Invalid data type specified: %s\n", optarg);
           fprintf(stderr, "Valid data types: rain, mintemp, maxtemp\n");
@@ -157,7 +803,7 @@ struct _options get_options(int argc, char **argv) {
         /* compare to work out which argv is at fault: */
         if (opt_char == arg_char) {
           /* check for argument missing an option: */
-          if (strchr("iovuty", opt_char) != NULL) {
+          if (strchr("iljovuty", opt_char) != NULL) {
             fprintf(stderr, "Option -%c requires an argument\n", opt_char);
             usage(0);
             break;
@@ -179,136 +825,60 @@ struct _options get_options(int argc, char **argv) {
     }
   /* end while parsing arguments: */
   }
+  /* get the list of input files: */
+  get_infiles(&options, argc - optind, argv + optind);
+  /* load additional grids, from the grids option or environment: */
+  if ((strcmp(options.gridfile, "") == 0) &&
+      (getenv(IMDGRD_GRIDS_ENV) != NULL)) {
+    options.gridfile = getenv(IMDGRD_GRIDS_ENV);
+  }
+  if (strcmp(options.gridfile, "") != 0) {
+    switch (imdgrd_load_grids(options.gridfile, &i)) {
+      case IMDGRD_OK:
+        break;
+      case IMDGRD_EGRIDFILE:
+        fprintf(stderr, "Unable to open grid file: %s\n", options.gridfile);
+        exit(1);
+      default:
+        fprintf(stderr, "Invalid grid definition in grid file %s, line %d\n",
+                options.gridfile, i);
+        exit(1);
+    }
+  }
+  /* find the grid to regrid to, once any additional grids are loaded: */
+  if (regrid_grid != NULL) {
+    setup_regrid();
+  }
   /* return the program options: */
   return options;
 }
 
-/*
- * file_exists does a simple check to see if a file exists.
- * if successful, returns file size, otherwise, returns -1.
- */
-int file_exists(const char *filename) {
-  /* file handle: */
-  FILE *file;
-  /* file size: */
-  int size;
-  /* check input file exists: */
-  if ((file = fopen(filename, "r")) == NULL) {
-    return -1;
-  } else {
-    /* file exists ... get file size: */
-    fseek(file, 0L, SEEK_END);
-    size = ftell(file);
-    /* close the file: */
-    fclose(file);
-  }
-  /* return the file size: */
-  return size;
-}
-
 /* get input information using options and file properties: */
-struct _input get_input(struct _options *options) {
+struct imdgrd_input get_input(struct _options *options) {
   /* create the struct for storing input information: */
-  struct _input input = DEFAULT_INPUT;
-  /* regular expression bits for matching year: */
-  regex_t regex;
-  const char *pattern;
-  regmatch_t match;
-  /* init year string: */
-  char *yr_str;
-  /* check input is specified: */
-  if (strcmp(options->infile, "") == 0) {
-    /* give up: */
-    fprintf(stderr, "No input file specified (-i)\n");
-    exit(1);
-  }
-  /* check input file exists and get file size: */
-  if ((input.size = file_exists(options->infile)) == -1) {
-    /* give up: */
-    fprintf(stderr, "input file does not exist: %s\n", options->infile);
-    exit(1);
-  } else {
-    /* store filename: */
-    input.filename = options->infile;
-  }
-  /*
-   * from the file size, we can work out the type of data, and the number of
-   * days in the year.
-   *
-   * e.g., for rainfall data, for a 365 day year:
-   *   file size = 129 * 135 * 4 * 365 + 1 = 25425901
-   */
-  if (input.size == 25425901) {
-    /* rainfall, 365 days: */
-    input.type = RAIN;
-    input.days = 365;
-  } else if (input.size == 25495561) {
-    /* rainfall, 366 days: */
-    input.type = RAIN;
-    input.days = 366;
-  } else if (input.size == 1403061) {
-    /* temperature, 365 days: */
-    input.type = TEMP;
-    input.days = 365;
-  } else if (input.size == 1406905) {
-    /* temperature, 366 days: */
-    input.type = TEMP;
-    input.days = 366;
-  } else {
-    /* invalid file size ... give up: */
-    fprintf(stderr, "Invalid input file size\n");
-    exit(1);
-  }
+  struct imdgrd_input input;
+  /* start time: */
+  double t0 = get_time();
   /*
-   * if this is temperature data, try to guess whether min or max data
-   * from the file name:
+   * inspect the input file. when converting incrementally, or querying, a
+   * file for the current year may only hold the first days of the year:
    */
-  if (input.type == TEMP) {
-    /* regular expression to match for min: */
-    pattern = "min";
-    /* try to compile the regex: */
-    if (regcomp(&regex, pattern, REG_EXTENDED|REG_ICASE) == 0) {
-      /* see if anything matches: */
-      if (regexec(&regex, input.filename, 1, &match, 0) == 0) {
-        /* set the data type: */
-        input.type = MINTEMP;
-      }
-    }
-    /* free the regex: */
-    regfree(&regex);
-    /* regular expression to match for max: */
-    pattern = "max";
-    /* try to compile the regex: */
-    if (regcomp(&regex, pattern, REG_EXTENDED|REG_ICASE) == 0) {
-      /* see if anything matches: */
-      if (regexec(&regex, input.filename, 1, &match, 0) == 0) {
-        /* set the data type: */
-        input.type = MAXTEMP;
-      }
-    }
-    /* free the regex: */
-    regfree(&regex);
+  switch (((incremental_flag == 1) || (query_flag == 1)) ?
+          imdgrd_get_partial_input(options->infile, &input) :
+          imdgrd_get_input(options->infile, &input)) {
+    case IMDGRD_OK:
+      break;
+    case IMDGRD_ENOINPUT:
+      fprintf(stderr, "No input file specified (-i)\n");
+      exit(1);
+    case IMDGRD_ENOFILE:
+      fprintf(stderr, "input file does not exist: %s\n", options->infile);
+      exit(1);
+    default:
+      fprintf(stderr, "Invalid input file size\n");
+      exit(1);
   }
-  /* try to guess the year from the file name: */
-  input.year = -1;
-  /* regular expression to match: */
-  pattern = "[0-9]{4}";
-  /* try to compile the regex: */
-  if (regcomp(&regex, pattern, REG_EXTENDED) == 0) {
-    /* see if anything matches: */
-    if (regexec(&regex, input.filename, 1, &match, 0) == 0) {
-      /* allocate the yr_str: */
-      yr_str = calloc(4 + 1, sizeof(char));
-      /* get the match: */
-      memcpy(yr_str, input.filename + match.rm_so, 4);
-      /* convert to int and store: */
-      input.year = atoi(yr_str);
-      /* free the yr_str: */
-      free(yr_str);
-    }
-  }
-  /* free the regex: */
-  regfree(&regex);
+  perf.get_input += get_time() - t0;
   /* return the input information: */
   return input;
 }
@@ -317,105 +887,68 @@ struct _input get_input(struct _options *options) {
  * check program options and input file information, to make sure everything
  * makes sense:
  */
-struct _input check_input(struct _options *options,
-                          struct _input *input_in) {
+struct imdgrd_input check_input(struct _options *options,
+                                struct imdgrd_input *input_in) {
   /* create the struct for storing input information: */
-  struct _input input_out = DEFAULT_INPUT;
-  /*
-   * Certain command line option might disagree with the information obtained
-   * by inspecting the input file, it's worth double checking some things.
-   * If a data type is specified in the options, use that:
-   */
-  if (options->type != -1) {
-    input_out.type = options->type;
-  } else {
-    /* otherwise, use value from file inspection: */
-    input_out.type = input_in->type;
-  }
-  /*
-   * if type is 1, we know it is temperature data, but not whether it is
-   * min or max temperature:
-   */
-  if (input_out.type == 1) {
-    fprintf(stderr, "Temperature data detected, but can not detect whether"
-                    " it is min or max data\n");
-    fprintf(stderr, "Try specifying data type with the -t option\n");
-    exit(1);
-  }
-  /* check if the user specifed type matches the detected data type: */
-  if ((input_out.type == 0 && input_in->type != 0) ||
-      (input_out.type == 2 && input_in->type < 1) ||
-      (input_out.type == 3 && input_in->type < 1)) {
-    fprintf(stderr, "Specified data type: %s does not match detected data"
-                    " type: %s\n", data_types[input_out.type],
-                    data_types[input_in->type]);
-    exit(1);
-  }
-  /* If a year is specified in the options, use that: */
-  if (options->year != -1) {
-    input_out.year = options->year;
-    input_out.year_match = 0;
-  } else {
-    /* otherwise, use value from file inspection: */
-    input_out.year = input_in->year;
-    input_out.year_match = 1;
-  }
-  /* if we don't have a valid year, give up: */
-  if (input_out.year == -1) {
-    fprintf(stderr, "Please specify a year for the input data\n");
-    exit(1);
-  }
-  /*
-   * If the data file contains data for 366 days, then the year should be
-   *  divisble by 4, i.e. a leap year:
-   */
-  if (input_in->days == 366) {
-    if (input_out.year % 4 != 0) {
+  struct imdgrd_input input_out;
+  /* return status: */
+  int status;
+  /* start time: */
+  double t0 = get_time();
+  /* check the options against the input file information: */
+  switch (imdgrd_check_input(input_in, options->type, options->year,
+                             &input_out)) {
+    case IMDGRD_OK:
+      /* work out whether the values need byte swapping: */
+      if ((status = imdgrd_set_byte_order(&input_out,
+                                          endian)) != IMDGRD_OK) {
+        fprintf(stderr, "%s: %s\n", imdgrd_strerror(status),
+                input_out.filename);
+        exit(1);
+      }
+      perf.check_input += get_time() - t0;
+      return input_out;
+    case IMDGRD_ETEMP:
+      fprintf(stderr, "Temperature data detected, but can not detect whether"
+                      " it is min or max data\n");
+      fprintf(stderr, "Try specifying data type with the -t option\n");
+      exit(1);
+    case IMDGRD_ETYPE:
+      fprintf(stderr, "Specified data type: %s does not match detected data"
+                      " type: %s\n", imdgrd_data_types[input_out.type],
+                      imdgrd_data_types[input_in->type]);
+      exit(1);
+    case IMDGRD_ENOYEAR:
+      fprintf(stderr, "Please specify a year for the input data\n");
+      exit(1);
+    case IMDGRD_ELEAP:
       fprintf(stderr, "Data file %s contains data for 366 days\n",
               input_in->filename);
       fprintf(stderr, "Year %d does not appear to be a leap year\n",
               input_out.year);
-      /* additional information if year was matched from file name: */
-      if (input_out.year_match == 1) {
-        fprintf(stderr, "Try specifying a year with the -y option\n");
-      }
-      exit(1);
-    }
-  }
-  /*
-   * If the data file contains data for 365 days, then the year should not be
-   *  divisible by 4, i.e. not a leap year:
-   */
-  if (input_in->days == 365) {
-    if (input_out.year % 4 == 0) {
+      break;
+    default:
       fprintf(stderr, "Data file %s contains data for 365 days\n",
               input_in->filename);
       fprintf(stderr, "Year %d appears to be a leap year\n",
               input_out.year);
-      /* additional information if year was matched from file name: */
-      if (input_out.year_match == 1) {
-        fprintf(stderr, "Try specifying a year with the -y option\n");
-      }
-      exit(1);
-    }
+      break;
   }
-  /*
-   * At this point, these options should be o.k. ... :
-   */
-  input_out.filename = input_in->filename;
-  input_out.size = input_in->size;
-  input_out.days = input_in->days;
-  /* return the checked options: */
-  return input_out;
+  /* additional information if year was matched from file name: */
+  if (input_out.year_match == 1) {
+    fprintf(stderr, "Try specifying a year with the -y option\n");
+  }
+  exit(1);
 }
 
 /*
  * check program options and output file information, to make sure everything
  * makes sense:
  */
-struct _output check_output(struct _options *options, struct _input *input) {
+struct imdgrd_output check_output(struct _options *options,
+                                  struct imdgrd_input *input) {
   /* create the struct for storing output information: */
-  struct _output output = DEFAULT_OUTPUT;
+  struct imdgrd_output output = IMDGRD_DEFAULT_OUTPUT;
   /* regular expression bits for matching file extension: */
   regex_t regex;
   const char *pattern;
@@ -427,14 +960,17 @@ struct _output check_output(struct _options *options, struct _input *input) {
   /* used for output file name allocation: */
   char *out_file;
   int out_file_set = 0;
+  /* input file information recorded in an existing output file: */
+  struct imdgrd_source recorded;
+  /* output file information: */
+  struct stat file_stat;
   /* if ouput file name is specified ... : */
   if (strcmp(options->outfile, "") != 0) {
     /* use provided output file name: */
     out_file = calloc(outfile_len + 1,
                       sizeof(char));
     out_file[0] = '\0';
-    strncat(out_file, options->outfile, sizeof(options->outfile) *
-            sizeof(char));
+    strcat(out_file, options->outfile);
     /* output file name is set: */
     out_file_set = 1;
   } else {
@@ -472,7 +1008,7 @@ struct _output check_output(struct _options *options, struct _input *input) {
                         sizeof(char));
       out_file[0] = '\0';
       /* append '.nc' to input file name: */
-      strncat(out_file, options->infile, sizeof(options->infile) * sizeof(char));
+      strcat(out_file, options->infile);
       strncat(out_file, nc_ext, sizeof(nc_ext) * sizeof(char));
       /* output file name is set: */
       out_file_set = 1;
@@ -480,9 +1016,17 @@ struct _output check_output(struct _options *options, struct _input *input) {
   }
   /* set output file name: */
   output.filename = out_file;
-  /* check if the output file exists and if clobber flag is set: */
-  if ((file_exists(output.filename) != -1) &&
-      (clobber_flag != 1)) {
+  /*
+   * check if the output file exists and if clobber flag is set. when
+   * converting incrementally, an output file which records the input file
+   * it was converted from can be updated. a zarr store is a directory:
+   */
+  if (((imdgrd_file_exists(output.filename) != -1) ||
+       ((output_format == IMDGRD_FORMAT_ZARR) &&
+        (stat(output.filename, &file_stat) == 0))) &&
+      (clobber_flag != 1) &&
+      ((incremental_flag != 1) ||
+       (imdgrd_read_source(output.filename, &recorded) != IMDGRD_OK))) {
     /* give up: */
     fprintf(stderr, "Output file: %s exists. Use -c option to overwrite\n",
             output.filename);
@@ -490,339 +1034,1830 @@ struct _output check_output(struct _options *options, struct _input *input) {
     free(output.filename);
     exit(1);
   }
+  /* same for the statistics file, which is kept with the output file: */
+  if ((aggregate_file != NULL) &&
+      (imdgrd_file_exists(aggregate_file) != -1) && (clobber_flag != 1) &&
+      (incremental_flag != 1)) {
+    fprintf(stderr, "Output file: %s exists. Use -c option to overwrite\n",
+            aggregate_file);
+    free(output.filename);
+    exit(1);
+  }
   /* if ouput netcdf variable name is specified ... : */
   if (strcmp(options->ncvar, "") != 0) {
     /* use provided variable name: */
     output.ncvar = options->ncvar;
+  } else if (input->grid->ncvar != NULL) {
+    /* use value for the grid: */
+    output.ncvar = input->grid->ncvar;
   } else {
     /* use default value: */
-    output.ncvar = nc_vars[input->type];
+    output.ncvar = imdgrd_nc_vars[input->type];
   }
   /* if ouput netcdf units are specified ... : */
   if (strcmp(options->ncunits, "") != 0) {
     /* use provided units: */
     output.ncunits = options->ncunits;
+  } else if (input->grid->ncunits != NULL) {
+    /* use value for the grid: */
+    output.ncunits = input->grid->ncunits;
   } else {
     /* use default value: */
-    output.ncunits = nc_units[input->type];
+    output.ncunits = imdgrd_nc_units[input->type];
   }
   /* return the output options: */
   return output;
 }
 
-/* read in data from grd file, and return struct of values: */
-struct _data read_data(struct _input *input, struct _output *output) {
-  /* create the struct for storing data: */
-  struct _data data;
-  /* input file: */
-  FILE *input_file;
-  /* for loop integers: */
-  int i, j, k;
-  /* dat index: */
-  int data_index = 0;
-  /* return value of fread: */
-  size_t fread_size;
-  /* returned data value: */
-  float fread_data;
-  /* set up the data struct. if rain data ... : */
-  if (input-> type == 0) {
-    data.grid = rain_grid;
-    data.nlats = rain_lats;
-    data.nlons = rain_lons;
-    data.lat0 = rain_lat0;
-    data.lon0 = rain_lon0;
-    data.lats = calloc(rain_lats, sizeof(float));
-    data.lons = calloc(rain_lons, sizeof(float));
-    data.datasize = input->size / (input->days * rain_lats * rain_lons);
-    data.data = calloc(input->days * rain_lats * rain_lons, sizeof(float *));
-    data.fill = rain_fill;
+/*
+ * display an error returned by the library. netcdf and zarr errors are
+ * described using the information stored in ncfile, other errors using the
+ * input file:
+ */
+void print_error(int status, struct imdgrd_input *input,
+                 struct imdgrd_ncfile *ncfile) {
+  if ((status == IMDGRD_ENETCDF) && (ncfile != NULL)) {
+    fprintf(stderr, "NetCDF error %s: %s\n", ncfile->error,
+            nc_strerror(ncfile->ncerr));
+  } else if ((status == IMDGRD_EZARR) && (ncfile != NULL)) {
+    fprintf(stderr, "Zarr error %s: %s\n", ncfile->error,
+            strerror(ncfile->ncerr));
+  } else if ((status == IMDGRD_ECOMPRESS) && (ncfile != NULL)) {
+    fprintf(stderr, "Zarr error %s: %s\n", ncfile->error,
+            zError(ncfile->ncerr));
+  } else if (input != NULL) {
+    fprintf(stderr, "%s: %s\n", imdgrd_strerror(status), input->filename);
   } else {
-    data.grid = temp_grid;
-    data.nlats = temp_lats;
-    data.nlons = temp_lons;
-    data.lat0 = temp_lat0;
-    data.lon0 = temp_lon0;
-    data.lats = calloc(temp_lats, sizeof(float));
-    data.lons = calloc(temp_lons, sizeof(float));
-    data.datasize = input->size / (input->days * temp_lats * temp_lons);
-    data.data = calloc(input->days * temp_lats * temp_lons, sizeof(float *));
-    data.fill = temp_fill;
-  }
-  data.year = input->year;
-  data.ndays = input->days;
-  data.days = calloc(input->days, sizeof(float));
-  /* store the lat and lon values: */
-  for (i = 0; i < data.nlats; i++) {
-    /* store the lat value: */
-    data.lats[i] = data.lat0 + (i * data.grid);
-  }
-  for (i = 0; i < data.nlons; i++) {
-    /* store the lon value: */
-    data.lons[i] = data.lon0 + (i * data.grid);
-  }
-  /* open the input file: */
-  input_file = fopen(input->filename, "rb");
-  /* loop over values: */
-  for (i = 0; i < data.ndays; i++) {
-    /* store the day value: */
-    data.days[i] = i;
-    for (j = 0; j < data.nlats; j++) {
-      /* store the */
-      for (k = 0; k < data.nlons; k++) {
-        /* read the data ... : */
-        fread_size = fread(&fread_data, data.datasize, 1, input_file);
-        /* if read size does not equal count size ... : */
-        if (fread_size != 1) {
-          /* close the input file: */
-          fclose(input_file);
-          /* free some memory: */
-          free(output->filename);
-          free(data.lats);
-          free(data.lons);
-          free(data.days);
-          free(data.data);
-          /* exit: */
-          exit(1);
-        } else {
-          /* store the value: */
-          data.data[data_index] = fread_data;
-          data_index++;
-        }
-      }
-    }
+    fprintf(stderr, "%s\n", imdgrd_strerror(status));
   }
-  /* close the input file: */
-  fclose(input_file);
-  /* return the data: */
-  return data;
 }
 
-/* write data to netcdf file: */
-int write_data(struct _data *data, struct _output *output) {
-  /* netcdf function return values: */
-  int ncerr;
-  /* netcdf id: */
-  int ncid;
-  /* dimension ids: */
-  int time_dim, lat_dim, lon_dim;
-  /* variable ids: */
-  int time_var, lat_var, lon_var, data_var;
-  /* char representation of year: */
-  char *yr_str;
-  /* time units: */
-  char *time_units;
-  /* netcdf dimension ids: */
-  int dim_ids[3];
-  /* netcdf start and count arrays: */
-  size_t nc_tcount[1];
-  size_t nc_tstart[1];
-  /* for loop integers: */
-  int i;
+/*
+ * add the bytes read from an input file, and the number of values written,
+ * to the performance statistics. only the rows containing a subset are
+ * read:
+ */
+void count_input(struct imdgrd_input *input, struct imdgrd_data *data) {
+  perf.bytes_read += (size_t) input->days * data->nlats * data->grid_nlons *
+                     data->datasize;
+  perf.values += (size_t) input->days * data->nlats * data->nlons;
+}
+
+/* add the time spent writing an output file to the performance statistics: */
+void count_write_times(struct imdgrd_ncfile *ncfile) {
+  perf.define += ncfile->define_time;
+  perf.convert += ncfile->convert_time;
+  perf.put += ncfile->put_time;
+  perf.close += ncfile->close_time;
+  perf.put_calls += ncfile->put_calls;
+}
+
+/*
+ * return the total size of the files in a directory, and the directories
+ * within it, e.g. a zarr store:
+ */
+size_t directory_size(const char *path) {
+  /* directory, and an entry in it: */
+  DIR *dir;
+  struct dirent *entry;
+  /* path and information of an entry: */
+  char *entry_path;
+  struct stat file_stat;
+  /* total size: */
+  size_t size = 0;
+  if ((dir = opendir(path)) == NULL) {
+    return 0;
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    if ((strcmp(entry->d_name, ".") == 0) ||
+        (strcmp(entry->d_name, "..") == 0)) {
+      continue;
+    }
+    entry_path = malloc(strlen(path) + strlen(entry->d_name) + 2);
+    sprintf(entry_path, "%s/%s", path, entry->d_name);
+    if (lstat(entry_path, &file_stat) == 0) {
+      size += S_ISDIR(file_stat.st_mode) ? directory_size(entry_path) :
+              (size_t) file_stat.st_size;
+    }
+    free(entry_path);
+  }
+  closedir(dir);
+  return size;
+}
+
+/*
+ * store the name and size of the output file, or zarr store, in the
+ * performance statistics:
+ */
+void count_output(const char *filename) {
+  /* file information: */
+  struct stat file_stat;
+  free(perf.output);
+  perf.output = strdup(filename);
+  if (output_format == IMDGRD_FORMAT_ZARR) {
+    perf.bytes_written = directory_size(filename);
+    return;
+  }
+  perf.bytes_written = (stat(filename, &file_stat) == 0) ?
+                       (size_t) file_stat.st_size : 0;
+}
+
+/* get the netcdf output settings from the program options: */
+struct imdgrd_ncoptions get_ncoptions(void) {
+  /* create the struct for storing the settings: */
+  struct imdgrd_ncoptions ncoptions = IMDGRD_DEFAULT_NCOPTIONS;
+  ncoptions.chunk_layout = chunk_layout;
+  ncoptions.chunk_sizes[0] = chunk_sizes[0];
+  ncoptions.chunk_sizes[1] = chunk_sizes[1];
+  ncoptions.chunk_sizes[2] = chunk_sizes[2];
+  ncoptions.precision_type = precision_type;
+  ncoptions.precision_bits = precision_bits;
+  ncoptions.codec = compression_codec;
+  ncoptions.level = compression_level;
+  ncoptions.shuffle = shuffle_flag;
+  /* check the values written, unless disabled: */
+  ncoptions.qc = (qc_flag == 1) ? &qc : NULL;
+  /* accumulate statistics from the values written, if requested: */
+  ncoptions.stats = (aggregate_file != NULL) ? &aggregate_stats : NULL;
+  /* record the input file, when converting incrementally: */
+  ncoptions.source = (incremental_flag == 1) ? &source : NULL;
+  ncoptions.format = output_format;
+  ncoptions.threads = zarr_threads;
+  ncoptions.layout = data_layout;
+  /* regrid the values, if requested: */
+  ncoptions.regrid = (regrid_grid != NULL) ? &regrid : NULL;
+  /* return the settings: */
+  return ncoptions;
+}
+
+/*
+ * set up a data struct for the input file, with grid information and
+ * coordinate values, but without any data values:
+ */
+struct imdgrd_data init_data(struct imdgrd_input *input) {
+  /* create the struct for storing data: */
+  struct imdgrd_data data;
+  /* return status: */
+  int status;
+  /* set up the data struct: */
+  if (imdgrd_init_data(input, &data) != IMDGRD_OK) {
+    fprintf(stderr, "Unable to allocate memory for input file: %s\n",
+            input->filename);
+    exit(1);
+  }
+  /* select a subset of the grid, if requested: */
+  if ((mask_file != NULL) &&
+      ((status = imdgrd_load_mask(&data, mask_file)) != IMDGRD_OK)) {
+    fprintf(stderr, "%s: %s\n", imdgrd_strerror(status), mask_file);
+    exit(1);
+  }
+  if ((bbox_flag == 1) &&
+      (imdgrd_set_bbox(&data, bbox[0], bbox[1], bbox[2],
+                       bbox[3]) != IMDGRD_OK)) {
+    fprintf(stderr, "Bounding box does not contain any grid points\n");
+    exit(1);
+  }
+  /* return the data struct: */
+  return data;
+}
+
+/* read in data from grd file, and return struct of values: */
+struct imdgrd_data read_data(struct imdgrd_input *input,
+                             struct imdgrd_output *output) {
+  /* create the struct for storing data: */
+  struct imdgrd_data data = init_data(input);
+  /* number of values expected and read: */
+  size_t data_count = imdgrd_data_count(&data);
+  size_t read_count;
+  /* return status: */
+  int status;
+  /* start time: */
+  double t0 = get_time();
+  /* map the input file, or read all days in one go: */
+  if (mmap_flag == 1) {
+    status = imdgrd_map_data(input, &data, &read_count);
+  } else {
+    status = imdgrd_read_data(input, &data, NULL, &read_count);
+  }
+  perf.read += get_time() - t0;
+  count_input(input, &data);
+  /* if anything failed ... : */
+  if (status != IMDGRD_OK) {
+    print_error(status, input, NULL);
+    if (status == IMDGRD_EREAD) {
+      fprintf(stderr, "Expected %zu values, read %zu\n", data_count,
+              read_count);
+    }
+    /* free some memory: */
+    free(output->filename);
+    imdgrd_free_data(&data);
+    /* exit: */
+    exit(1);
+  }
+  /* return the data: */
+  return data;
+}
+
+/*
+ * create a netcdf output file, with the settings from the program options.
+ * the netcdf ids are stored in ncfile:
+ */
+int create_output(struct imdgrd_data *data, struct imdgrd_output *output,
+                  struct imdgrd_ncfile *ncfile) {
+  /* netcdf output settings: */
+  struct imdgrd_ncoptions ncoptions = get_ncoptions();
+  /* return status: */
+  int status;
+  /* create the output file: */
+  if ((status = imdgrd_create_output(data, output, &ncoptions,
+                                     ncfile)) != IMDGRD_OK) {
+    print_error(status, NULL, ncfile);
+    return 1;
+  }
+  /* return: */
+  return 0;
+}
+
+/* write data to netcdf file: */
+int write_data(struct imdgrd_data *data, struct imdgrd_output *output) {
+  /* netcdf output settings: */
+  struct imdgrd_ncoptions ncoptions = get_ncoptions();
+  /* netcdf output file ids: */
+  struct imdgrd_ncfile ncfile;
+  /* return status: */
+  int status;
+  /* write the data: */
+  if ((status = imdgrd_write_data(data, output, &ncoptions,
+                                  &ncfile)) != IMDGRD_OK) {
+    print_error(status, NULL, &ncfile);
+    return 1;
+  }
+  count_write_times(&ncfile);
+  /* return: */
+  return 0;
+}
+
+/*
+ * record the input file in an output file, when converting incrementally.
+ * this is done once all values have been written. returns 0 on success:
+ */
+int put_source(struct imdgrd_ncfile *ncfile) {
+  /* return status: */
+  int status;
+  /* record the input file: */
+  if ((status = imdgrd_put_source(ncfile,
+                                  ncfile->ncoptions.source)) != IMDGRD_OK) {
+    print_error(status, NULL, ncfile);
+    return 1;
+  }
+  /* return: */
+  return 0;
+}
+
+/*
+ * close an output file. with the time-major layout, this writes the last
+ * block of days. returns 0 on success:
+ */
+int close_output(struct imdgrd_ncfile *ncfile) {
+  /* return status: */
+  int status;
+  /* close the output file: */
+  if ((status = imdgrd_close_output(ncfile)) != NC_NOERR) {
+    /* a zarr store records the failed operation as it is closed: */
+    if (ncfile->ncoptions.format == IMDGRD_FORMAT_ZARR) {
+      status = (status < 0) ? IMDGRD_ECOMPRESS : IMDGRD_EZARR;
+    } else {
+      ncfile->ncerr = status;
+      ncfile->error = "closing file";
+      status = IMDGRD_ENETCDF;
+    }
+    print_error(status, NULL, ncfile);
+    return 1;
+  }
+  /* return: */
+  return 0;
+}
+
+/*
+ * convert the days from a grd file to netcdf one day at a time, so that only
+ * a single day of data is held in memory. the days are written to an open
+ * netcdf file, starting at time index offset:
+ */
+int stream_days(struct imdgrd_input *input, struct imdgrd_data *data,
+                struct imdgrd_ncfile *ncfile, int offset) {
+  /* number of days converted: */
+  int ndone;
+  /* return status: */
+  int status;
+  /* start time, and time already spent writing: */
+  double t0 = get_time();
+  double write_time = ncfile->convert_time + ncfile->put_time;
+  /* convert the days: */
+  status = imdgrd_stream_days(input, data, ncfile, offset, mmap_flag,
+                              &ndone);
+  /* the rest of the time is spent reading: */
+  perf.read += (get_time() - t0) -
+               (ncfile->convert_time + ncfile->put_time - write_time);
+  count_input(input, data);
+  if (status != IMDGRD_OK) {
+    print_error(status, input, ncfile);
+    if (status == IMDGRD_EREAD) {
+      fprintf(stderr, "Unable to read values for day %d\n", ndone + 1);
+    }
+    return 1;
+  }
+  /* return: */
+  return 0;
+}
+
+/*
+ * convert data from the grd file to netcdf one day at a time, so that only a
+ * single day of data is held in memory:
+ */
+int stream_data(struct imdgrd_input *input, struct imdgrd_output *output) {
+  /* data struct, for grid information and coordinate values: */
+  struct imdgrd_data data = init_data(input);
+  /* netcdf output file ids: */
+  struct imdgrd_ncfile ncfile;
+  /* return status: */
+  int status = 0;
   /* create the output file: */
-  ncerr = nc_create(output->filename, NC_CREATE_FLAGS, &ncid);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating file: %s\n", nc_strerror(ncerr));
-    return 1;
-  }
-  /* create the netcdf dimensions ... time: */
-  ncerr = nc_def_dim(ncid, NC_TIME_VAR, NC_UNLIMITED, &time_dim);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating dimension: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* ... latitude ... : */
-  ncerr = nc_def_dim(ncid, NC_LAT_VAR, data->nlats, &lat_dim);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating dimension: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* ... longitude: */
-  ncerr = nc_def_dim(ncid, NC_LON_VAR, data->nlons, &lon_dim);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating dimension: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* create the netcdf dimension variables ... time: */
-  ncerr = nc_def_var(ncid, NC_TIME_VAR, NC_FLOAT, 1, &time_dim, &time_var);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating variable: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* ... latitude ... : */
-  ncerr = nc_def_var(ncid, NC_LAT_VAR, NC_FLOAT, 1, &lat_dim, &lat_var);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating variable: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* ... longitude: */
-  ncerr = nc_def_var(ncid, NC_LON_VAR, NC_FLOAT, 1, &lon_dim, &lon_var);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating variable: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* allocate year string: */
-  yr_str = calloc(4 + 1, sizeof(char));
-  sprintf(yr_str, "%d", data->year);
-  /* allocate the time units: */
-  time_units = calloc(strlen(NC_TIME_UNITS) + 1, sizeof(char));
-  /* replace the year: */
-  time_units[0] = '\0';
-  strncat(time_units, NC_TIME_UNITS, 11 * sizeof(char));
-  strncat(time_units, yr_str, 4 * sizeof(char));
-  strncat(time_units, NC_TIME_UNITS + 15, 10 * sizeof(char));
-  /* add dimension variable attributes ... time units: */
-  ncerr = nc_put_att_text(ncid, time_var, NC_UNITS, strlen(time_units),
-                          time_units);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting variable attributes: %s\n",
-            nc_strerror(ncerr));
-    free(yr_str);
-    free(time_units);
-    return 1;
-  }
-  /* free these: */
-  free(yr_str);
-  free(time_units);
-  /* ... time calendar ... : */
-  ncerr = nc_put_att_text(ncid, time_var, NC_CAL, strlen(NC_CAL_TYPE),
-                          NC_CAL_TYPE);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting variable attributes: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* ... latitude ... : */
-  ncerr = nc_put_att_text(ncid, lat_var, NC_UNITS, strlen(NC_LAT_UNITS),
-                          NC_LAT_UNITS);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting variable attributes: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* ... longitude: */
-  ncerr = nc_put_att_text(ncid, lon_var, NC_UNITS, strlen(NC_LON_UNITS),
-                          NC_LON_UNITS);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting variable attributes: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* set the dimension ids: */
-  dim_ids[0] = time_dim;
-  dim_ids[1] = lat_dim;
-  dim_ids[2] = lon_dim;
-  /* create the data variable: */
-  ncerr = nc_def_var(ncid, output->ncvar, NC_FLOAT, 3, dim_ids, &data_var);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error creating variable: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* enable compression: */
-  ncerr = nc_def_var_deflate(ncid, data_var, 0, 1, NC_COMP);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting variable compression: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* set the data units: */
-  ncerr = nc_put_att_text(ncid, data_var, NC_UNITS, strlen(output->ncunits),
-                          output->ncunits);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting variable attributes: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* set the data fill value: */
-  ncerr = nc_put_att_float(ncid, data_var, NC_FILLV, NC_FLOAT, 1,
-                           &data->fill);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting variable attributes: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* exit define mode: */
-  ncerr = nc_enddef(ncid);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error: %s\n", nc_strerror(ncerr));
-    return 1;
-  }
-  /* add lat values: */
-  ncerr = nc_put_var_float(ncid, lat_var, &data->lats[0]);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting latitude values: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* add lon values: */
-  ncerr = nc_put_var_float(ncid, lon_var, &data->lons[0]);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting longitude values: %s\n",
-            nc_strerror(ncerr));
-    return 1;
-  }
-  /* set up count and start values: */
-  nc_tcount[0] = data->ndays;
-  nc_tstart[0] = 0;
+  if (create_output(&data, output, &ncfile) != 0) {
+    imdgrd_free_data(&data);
+    return 1;
+  }
+  /* convert the days: */
+  status = stream_days(input, &data, &ncfile, 0);
+  if (status == 0) {
+    status = put_source(&ncfile);
+  }
+  /* close the output file: */
+  if (status == 0) {
+    status = close_output(&ncfile);
+    count_write_times(&ncfile);
+  }
+  /* tidy up: */
+  imdgrd_free_data(&data);
+  /* return: */
+  return status;
+}
+
+/*
+ * reader thread for the pipeline. days are read in to the next free buffer
+ * in the ring, until all days have been read or the writer cancels:
+ */
+void *pipeline_reader(void *arg) {
+  /* the pipeline: */
+  struct _pipeline *pipeline = arg;
+  /* buffer index, and whether the writer has cancelled: */
+  int index, cancel;
+  /* timing: */
+  double t0;
+  /* for loop integers: */
+  int i;
   /* loop through days: */
-  for (i = 0; i < data->ndays; i++) {
-    /* add time value: */
-    ncerr = nc_put_vara_float(ncid, time_var, nc_tstart, nc_tcount,
-                              &data->days[0]);
-    if (ncerr != NC_NOERR) {
-      nc_close(ncid);
-      fprintf(stderr, "NetCDF error setting time value: %s\n",
-              nc_strerror(ncerr));
+  for (i = 0; i < pipeline->ndays; i++) {
+    /* wait for a free buffer: */
+    pthread_mutex_lock(&pipeline->lock);
+    while ((pipeline->count == pipeline->depth) &&
+           (pipeline->cancel == 0)) {
+      pthread_cond_wait(&pipeline->emptied, &pipeline->lock);
+    }
+    index = pipeline->head;
+    cancel = pipeline->cancel;
+    pthread_mutex_unlock(&pipeline->lock);
+    /* give up if the writer has failed: */
+    if (cancel == 1) {
+      break;
+    }
+    /* read the day, outside of the lock: */
+    t0 = get_time();
+    if (imdgrd_read_day_into(pipeline->reader, i,
+                             pipeline->buffers[index]) != IMDGRD_OK) {
+      pthread_mutex_lock(&pipeline->lock);
+      pipeline->read_error = i;
+      pthread_cond_signal(&pipeline->filled);
+      pthread_mutex_unlock(&pipeline->lock);
+      break;
+    }
+    pipeline->read_time += get_time() - t0;
+    /* pass the buffer to the writer: */
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->head = (pipeline->head + 1) % pipeline->depth;
+    pipeline->count++;
+    pthread_cond_signal(&pipeline->filled);
+    pthread_mutex_unlock(&pipeline->lock);
+  }
+  /* return: */
+  return NULL;
+}
+
+/* free the day buffers of a pipeline: */
+void free_pipeline_buffers(struct _pipeline *pipeline) {
+  /* for loop integers: */
+  int i;
+  for (i = 0; (pipeline->buffers != NULL) && (i < pipeline->depth); i++) {
+    free(pipeline->buffers[i]);
+  }
+  free(pipeline->buffers);
+}
+
+/*
+ * convert the days from a grd file to netcdf one day at a time, with the
+ * input read in a separate thread, so that reading overlaps with compression
+ * and writing of the output. the days are written to an open netcdf file,
+ * starting at time index offset. time spent reading and writing is added to
+ * read_time and write_time:
+ */
+int pipeline_days(struct imdgrd_input *input, struct imdgrd_data *data,
+                  struct imdgrd_ncfile *ncfile, int offset, double *read_time,
+                  double *write_time) {
+  /* grd file reader: */
+  struct imdgrd_reader reader;
+  /* the pipeline: */
+  struct _pipeline pipeline;
+  /* reader thread: */
+  pthread_t reader_thread;
+  /* buffer index and whether a day is available: */
+  int index, available;
+  /* timing, and time already spent converting and putting values: */
+  double t0, put_time;
+  /* return status: */
+  int status = 0;
+  /* for loop integers: */
+  int i;
+  /* open the input file: */
+  if ((status = imdgrd_open_reader(input, data, &reader,
+                                   mmap_flag)) != IMDGRD_OK) {
+    print_error(status, input, NULL);
+    imdgrd_close_output(ncfile);
+    return 1;
+  }
+  /* set up the pipeline, no more buffers than days are needed: */
+  pipeline.reader = &reader;
+  pipeline.ndays = input->days;
+  pipeline.depth = (pipeline_depth < input->days) ? pipeline_depth :
+                   input->days;
+  pipeline.buffers = calloc(pipeline.depth, sizeof(float *));
+  for (i = 0; (pipeline.buffers != NULL) && (i < pipeline.depth); i++) {
+    if ((pipeline.buffers[i] = calloc(reader.day_count,
+                                      sizeof(float))) == NULL) {
+      break;
+    }
+  }
+  if ((pipeline.buffers == NULL) || (i < pipeline.depth)) {
+    fprintf(stderr, "Unable to allocate memory for input file: %s\n",
+            input->filename);
+    free_pipeline_buffers(&pipeline);
+    imdgrd_close_reader(&reader);
+    imdgrd_close_output(ncfile);
+    return 1;
+  }
+  pipeline.head = 0;
+  pipeline.tail = 0;
+  pipeline.count = 0;
+  pipeline.read_error = -1;
+  pipeline.cancel = 0;
+  pipeline.read_time = 0;
+  pthread_mutex_init(&pipeline.lock, NULL);
+  pthread_cond_init(&pipeline.filled, NULL);
+  pthread_cond_init(&pipeline.emptied, NULL);
+  /*
+   * start the reader thread. if a thread can not be created, the days are
+   * converted without a pipeline:
+   */
+  if (pthread_create(&reader_thread, NULL, pipeline_reader,
+                     &pipeline) != 0) {
+    pthread_mutex_destroy(&pipeline.lock);
+    pthread_cond_destroy(&pipeline.filled);
+    pthread_cond_destroy(&pipeline.emptied);
+    free_pipeline_buffers(&pipeline);
+    imdgrd_close_reader(&reader);
+    t0 = get_time();
+    put_time = ncfile->convert_time + ncfile->put_time;
+    status = stream_days(input, data, ncfile, offset);
+    put_time = ncfile->convert_time + ncfile->put_time - put_time;
+    *write_time += put_time;
+    *read_time += get_time() - t0 - put_time;
+    return status;
+  }
+  /* loop through days: */
+  for (i = 0; i < input->days; i++) {
+    /* wait for the day to be read: */
+    pthread_mutex_lock(&pipeline.lock);
+    while ((pipeline.count == 0) && (pipeline.read_error == -1)) {
+      pthread_cond_wait(&pipeline.filled, &pipeline.lock);
+    }
+    available = pipeline.count;
+    index = pipeline.tail;
+    pthread_mutex_unlock(&pipeline.lock);
+    /* if the reader failed before reaching this day: */
+    if (available == 0) {
+      fprintf(stderr, "Error reading data from input file: %s\n",
+              input->filename);
+      fprintf(stderr, "Unable to read values for day %d\n",
+              pipeline.read_error + 1);
+      imdgrd_close_output(ncfile);
+      status = 1;
+      break;
+    }
+    /* write the day: */
+    t0 = get_time();
+    if ((status = imdgrd_write_day(ncfile, data, offset + i,
+                                   pipeline.buffers[index])) != IMDGRD_OK) {
+      print_error(status, input, ncfile);
+      status = 1;
+      break;
+    }
+    *write_time += get_time() - t0;
+    /* return the buffer to the reader: */
+    pthread_mutex_lock(&pipeline.lock);
+    pipeline.tail = (pipeline.tail + 1) % pipeline.depth;
+    pipeline.count--;
+    pthread_cond_signal(&pipeline.emptied);
+    pthread_mutex_unlock(&pipeline.lock);
+  }
+  /* if anything failed, stop the reader: */
+  if (status != 0) {
+    pthread_mutex_lock(&pipeline.lock);
+    pipeline.cancel = 1;
+    pthread_cond_signal(&pipeline.emptied);
+    pthread_mutex_unlock(&pipeline.lock);
+  }
+  pthread_join(reader_thread, NULL);
+  *read_time += pipeline.read_time;
+  perf.read += pipeline.read_time;
+  count_input(input, data);
+  /* tidy up: */
+  pthread_mutex_destroy(&pipeline.lock);
+  pthread_cond_destroy(&pipeline.filled);
+  pthread_cond_destroy(&pipeline.emptied);
+  free_pipeline_buffers(&pipeline);
+  imdgrd_close_reader(&reader);
+  /* return: */
+  return status;
+}
+
+/* display the timings from a pipelined conversion: */
+void print_pipeline_times(double read_time, double write_time,
+                          double elapsed) {
+  printf("Pipeline depth: %d, read: %.3fs, write: %.3fs, elapsed: %.3fs, "
+         "overlap: %.3fs\n", pipeline_depth, read_time, write_time, elapsed,
+         (read_time + write_time > elapsed) ?
+         read_time + write_time - elapsed : 0);
+}
+
+/*
+ * convert data from the grd file to netcdf one day at a time, with the input
+ * read in a separate thread, so that reading overlaps with compression and
+ * writing of the output:
+ */
+int pipeline_data(struct imdgrd_input *input, struct imdgrd_output *output) {
+  /* data struct, for grid information and coordinate values: */
+  struct imdgrd_data data = init_data(input);
+  /* netcdf output file ids: */
+  struct imdgrd_ncfile ncfile;
+  /* timing: */
+  double t0, t1, read_time = 0, write_time = 0;
+  /* return status: */
+  int status = 0;
+  /* create the output file: */
+  if (create_output(&data, output, &ncfile) != 0) {
+    imdgrd_free_data(&data);
+    return 1;
+  }
+  /* convert the days: */
+  t0 = get_time();
+  status = pipeline_days(input, &data, &ncfile, 0, &read_time, &write_time);
+  if (status == 0) {
+    status = put_source(&ncfile);
+  }
+  /* close the output file, which flushes any remaining data: */
+  if (status == 0) {
+    t1 = get_time();
+    status = close_output(&ncfile);
+    write_time += get_time() - t1;
+    count_write_times(&ncfile);
+  }
+  /* report timings: */
+  if (status == 0) {
+    print_pipeline_times(read_time, write_time, get_time() - t0);
+  }
+  /* tidy up: */
+  imdgrd_free_data(&data);
+  /* return: */
+  return status;
+}
+
+/*
+ * write the daily quality control results to the report file, if requested,
+ * and display a warning if any values were out of range. returns 0 on
+ * success:
+ */
+int report_qc(const char *filename) {
+  /* report file: */
+  FILE *report_file;
+  /* results for a day: */
+  struct imdgrd_qc_day *day;
+  /* total number of out of range values: */
+  size_t invalid = 0;
+  /* return status: */
+  int status = 0;
+  /* for loop integers: */
+  int i;
+  /* check quality control is enabled: */
+  if (qc_flag == 0) {
+    return 0;
+  }
+  /* open the report file, if requested: */
+  report_file = NULL;
+  if ((qc_report_file != NULL) &&
+      ((report_file = fopen(qc_report_file, "w")) == NULL)) {
+    fprintf(stderr, "Unable to open quality control report file: %s\n",
+            qc_report_file);
+    status = 1;
+  }
+  if (report_file != NULL) {
+    fprintf(report_file, "day,valid,fill,missing,invalid,min,max\n");
+  }
+  /* loop through checked days: */
+  for (i = 0; i < qc.ndays; i++) {
+    day = &qc.days[i];
+    if (day->checked == 0) {
+      continue;
+    }
+    invalid += day->invalid;
+    if (report_file != NULL) {
+      fprintf(report_file, "%d,%zu,%zu,%zu,%zu,%g,%g\n", i, day->valid,
+              day->fill, day->missing, day->invalid, day->min, day->max);
+    }
+  }
+  /* close the report file: */
+  if ((report_file != NULL) && (fclose(report_file) != 0)) {
+    fprintf(stderr, "Error writing quality control report file: %s\n",
+            qc_report_file);
+    status = 1;
+  }
+  /* warn about out of range values: */
+  if (invalid > 0) {
+    fprintf(stderr, "Warning: %zu values are outside of the possible range "
+                    "for the data type: %s\n", invalid, filename);
+  }
+  /* tidy up: */
+  imdgrd_free_qc(&qc);
+  /* return: */
+  return status;
+}
+
+/* compare two input structs by year, for sorting: */
+int compare_input_years(const void *a, const void *b) {
+  return ((const struct imdgrd_input *) a)->year -
+         ((const struct imdgrd_input *) b)->year;
+}
+
+#ifdef USE_MPI
+/*
+ * write a merged output file in parallel, with each process converting
+ * whole years, taking every mpi_size'th input file. years are written with
+ * collective writes, one year from each process at a time, so compression
+ * of the chunks is spread across the processes. any failure aborts all of
+ * the processes, as the others would wait in the next collective write:
+ */
+int merge_par(struct imdgrd_input *inputs, int ninputs,
+              struct imdgrd_data *data, struct imdgrd_output *output) {
+  /* netcdf output settings: */
+  struct imdgrd_ncoptions ncoptions = get_ncoptions();
+  /* netcdf output file ids: */
+  struct imdgrd_ncfile ncfile;
+  /* data for a year: */
+  struct imdgrd_data year_data;
+  /* netcdf start and count arrays: */
+  size_t nc_count[3];
+  size_t nc_start[3];
+  /* time index of the first year in a collective write, and of the year
+     converted by this process: */
+  int offset = 0, year_offset;
+  /* performance statistics combined from all processes: */
+  double times[3];
+  unsigned long long counts[3];
+  /* return status: */
+  int status;
+  /* for loop integers: */
+  int i, j, k;
+  /* create the output file: */
+  if ((status = imdgrd_create_output_par(data, output, &ncoptions,
+                                         MPI_COMM_WORLD,
+                                         &ncfile)) != IMDGRD_OK) {
+    print_error(status, NULL, &ncfile);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  /* every process writes a year, or nothing, in each collective write: */
+  for (i = 0; i < ninputs; i += mpi_size) {
+    /* the year converted by this process follows those of lower ranks: */
+    j = i + mpi_rank;
+    year_offset = offset;
+    for (k = i; (k < j) && (k < ninputs); k++) {
+      year_offset += inputs[k].days;
+    }
+    if (j < ninputs) {
+      year_data = read_data(&inputs[j], output);
+      nc_count[0] = inputs[j].days;
+      nc_count[1] = data->nlats;
+      nc_count[2] = data->nlons;
+      nc_start[0] = year_offset;
+      nc_start[1] = 0;
+      nc_start[2] = 0;
+      status = imdgrd_put_data(&ncfile, data, nc_start, nc_count,
+                               &year_data.data[0]);
+      imdgrd_free_data(&year_data);
+      if (status != IMDGRD_OK) {
+        print_error(status, &inputs[j], &ncfile);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    } else if ((status = imdgrd_put_none(&ncfile)) != IMDGRD_OK) {
+      print_error(status, NULL, &ncfile);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    /* move past the years of this collective write: */
+    for (k = i; (k < i + mpi_size) && (k < ninputs); k++) {
+      offset += inputs[k].days;
+    }
+  }
+  /* close the output file: */
+  if ((status = imdgrd_close_output(&ncfile)) != NC_NOERR) {
+    fprintf(stderr, "NetCDF error closing file: %s\n", nc_strerror(status));
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  count_write_times(&ncfile);
+  /*
+   * combine the performance statistics, as the longest times spent by any
+   * process, and the total sizes:
+   */
+  times[0] = perf.read;
+  times[1] = perf.convert;
+  times[2] = perf.put;
+  counts[0] = perf.bytes_read;
+  counts[1] = perf.values;
+  counts[2] = perf.put_calls;
+  MPI_Reduce((mpi_rank == 0) ? MPI_IN_PLACE : times, times, 3, MPI_DOUBLE,
+             MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce((mpi_rank == 0) ? MPI_IN_PLACE : counts, counts, 3,
+             MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (mpi_rank == 0) {
+    perf.read = times[0];
+    perf.convert = times[1];
+    perf.put = times[2];
+    perf.bytes_read = counts[0];
+    perf.values = counts[1];
+    perf.put_calls = counts[2];
+    count_output(output->filename);
+  }
+  /*
+   * each process reports out of range values in the years it converted. a
+   * quality control report file can not be written in parallel:
+   */
+  return report_qc(output->filename);
+}
+#endif
+
+/*
+ * merge all of the input files, which should be consecutive years of the
+ * same data type, in to a single netcdf output file with a continuous time
+ * axis. time values are days since the start of the first year:
+ */
+int merge_data(struct _options *options) {
+  /* input information for each file: */
+  struct imdgrd_input *inputs;
+  /* options for a single file: */
+  struct _options file_options;
+  /* output information: */
+  struct imdgrd_output output;
+  /* data struct, for grid information and coordinate values: */
+  struct imdgrd_data data;
+  /* netcdf output file ids: */
+  struct imdgrd_ncfile ncfile;
+  /* total number of days, and time index of the current file: */
+  int ndays = 0, offset = 0;
+  /* timing: */
+  double t0, t1, read_time = 0, write_time = 0;
+  /* return status: */
+  int status = 0;
+  /* for loop integers: */
+  int i;
+  /* output file name has to be specified, and year can not be: */
+  if (strcmp(options->outfile, "") == 0) {
+    fprintf(stderr, "Output file (-o) has to be specified when merging "
+                    "input files\n");
+    return 1;
+  }
+  if (options->year != -1) {
+    fprintf(stderr, "Year (-y) can not be used with multiple input files\n");
+    return 1;
+  }
+  /* there has to be at least one file to merge, e.g. from a list file: */
+  if (options->ninfiles < 1) {
+    fprintf(stderr, "No input files specified to merge\n");
+    return 1;
+  }
+  /* get and check information for each input file: */
+  inputs = calloc(options->ninfiles, sizeof(struct imdgrd_input));
+  if (inputs == NULL) {
+    fprintf(stderr, "Unable to allocate memory\n");
+    return 1;
+  }
+  for (i = 0; i < options->ninfiles; i++) {
+    file_options = *options;
+    file_options.infile = options->infiles[i];
+    inputs[i] = get_input(&file_options);
+    inputs[i] = check_input(&file_options, &inputs[i]);
+  }
+  /* sort by year, and check the years are consecutive and types match: */
+  qsort(inputs, options->ninfiles, sizeof(struct imdgrd_input),
+        compare_input_years);
+  for (i = 0; i < options->ninfiles; i++) {
+    if ((i > 0) && (inputs[i].type != inputs[0].type)) {
+      fprintf(stderr, "Data type of input file %s (%s) does not match data "
+                      "type of input file %s (%s)\n", inputs[i].filename,
+                      imdgrd_data_types[inputs[i].type], inputs[0].filename,
+                      imdgrd_data_types[inputs[0].type]);
+      free(inputs);
+      return 1;
+    }
+    if ((i > 0) && (inputs[i].grid != inputs[0].grid)) {
+      fprintf(stderr, "Grid of input file %s (%s) does not match grid of "
+                      "input file %s (%s)\n", inputs[i].filename,
+                      inputs[i].grid->name, inputs[0].filename,
+                      inputs[0].grid->name);
+      free(inputs);
+      return 1;
+    }
+    if ((i > 0) && (inputs[i].year != inputs[i - 1].year + 1)) {
+      fprintf(stderr, "Input files are not consecutive years. %s is for "
+                      "%d, %s is for %d\n", inputs[i - 1].filename,
+                      inputs[i - 1].year, inputs[i].filename,
+                      inputs[i].year);
+      free(inputs);
       return 1;
     }
+    ndays += inputs[i].days;
+  }
+  /* check output information and options: */
+  output = check_output(options, &inputs[0]);
+  /*
+   * set up the data struct from the first year, with time values covering
+   * all years:
+   */
+  data = init_data(&inputs[0]);
+  free(data.days);
+  data.ndays = ndays;
+  data.days = calloc(ndays, sizeof(float));
+  for (i = 0; i < ndays; i++) {
+    data.days[i] = i;
+  }
+#ifdef USE_MPI
+  /* with more than one process, convert and write the years in parallel: */
+  if (mpi_size > 1) {
+    status = merge_par(inputs, options->ninfiles, &data, &output);
+    imdgrd_free_data(&data);
+    free(output.filename);
+    free(inputs);
+    return status;
   }
-  /* add data values: */
-  ncerr = nc_put_var_float(ncid, data_var, &data->data[0]);
-  if (ncerr != NC_NOERR) {
-    nc_close(ncid);
-    fprintf(stderr, "NetCDF error setting data values: %s\n",
-            nc_strerror(ncerr));
+#endif
+  /* create the output file: */
+  if (create_output(&data, &output, &ncfile) != 0) {
+    imdgrd_free_data(&data);
+    free(output.filename);
+    free(inputs);
     return 1;
   }
+  /* append each year along the time dimension: */
+  t0 = get_time();
+  for (i = 0; i < options->ninfiles; i++) {
+    if (pipeline_depth > 0) {
+      status = pipeline_days(&inputs[i], &data, &ncfile, offset, &read_time,
+                             &write_time);
+    } else {
+      status = stream_days(&inputs[i], &data, &ncfile, offset);
+    }
+    if (status != 0) {
+      break;
+    }
+    offset += inputs[i].days;
+  }
   /* close the output file: */
-  ncerr = nc_close(ncid);
+  if (status == 0) {
+    t1 = get_time();
+    status = close_output(&ncfile);
+    write_time += get_time() - t1;
+    count_write_times(&ncfile);
+  }
+  if (status == 0) {
+    count_output(output.filename);
+    /* report timings: */
+    if (pipeline_depth > 0) {
+      print_pipeline_times(read_time, write_time, get_time() - t0);
+    }
+    /* report the quality control results: */
+    status = report_qc(output.filename);
+  }
+  /* tidy up: */
+  imdgrd_free_data(&data);
+  free(output.filename);
+  free(inputs);
+  /* return: */
+  return status;
+}
+
+/*
+ * check if a value read for a query is missing, i.e. the fill value, or one
+ * of the alternative missing value markers:
+ */
+int query_missing(float value, float fill) {
+  /* for loop integers: */
+  int i;
+  if ((value == fill) || isnan(value)) {
+    return 1;
+  }
+  for (i = 0; i < qc.nmissing; i++) {
+    if (value == qc.missing[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * write the time series for the grid point nearest to the query point, from
+ * one or more input files, as csv to standard output. only the values for
+ * the point are read from each file:
+ */
+int query_data(struct _options *options) {
+  /* input information for each file, and number of files: */
+  struct imdgrd_input *inputs;
+  int ninputs = (options->ninfiles > 0) ? options->ninfiles : 1;
+  /* options for a single file: */
+  struct _options file_options;
+  /* output variable name: */
+  const char *ncvar;
+  /* grid point indexes, and first and last day to read from a file: */
+  int lat_index, lon_index, first, last;
+  /*
+   * values for a file, and the date of a value, with room for any int year,
+   * month and day so that the date is never truncated:
+   */
+  float *values;
+  char date[3 * sizeof("-2147483648")];
+  /* return status: */
+  int status;
+  /* start time: */
+  double t0;
+  /* for loop integers: */
+  int i, j;
+  /* get and check information for each input file, in order of year: */
+  inputs = calloc(ninputs, sizeof(struct imdgrd_input));
+  if (inputs == NULL) {
+    fprintf(stderr, "Unable to allocate memory\n");
+    return 1;
+  }
+  for (i = 0; i < ninputs; i++) {
+    file_options = *options;
+    if (options->ninfiles > 0) {
+      file_options.infile = options->infiles[i];
+    }
+    inputs[i] = get_input(&file_options);
+    inputs[i] = check_input(&file_options, &inputs[i]);
+    if (imdgrd_find_point(&inputs[i], query_point[0], query_point[1],
+                          &lat_index, &lon_index) != IMDGRD_OK) {
+      fprintf(stderr, "Point %g,%g is outside of the grid of input file: "
+                      "%s\n", query_point[0], query_point[1],
+              inputs[i].filename);
+      free(inputs);
+      return 1;
+    }
+  }
+  qsort(inputs, ninputs, sizeof(struct imdgrd_input), compare_input_years);
+  /* variable name, as for the netcdf output: */
+  if (strcmp(options->ncvar, "") != 0) {
+    ncvar = options->ncvar;
+  } else if (inputs[0].grid->ncvar != NULL) {
+    ncvar = inputs[0].grid->ncvar;
+  } else {
+    ncvar = imdgrd_nc_vars[inputs[0].type];
+  }
+  printf("date,%s\n", ncvar);
+  /* read the days within the dates from each file: */
+  for (i = 0; i < ninputs; i++) {
+    if ((query_start[0] != -1) &&
+        ((inputs[i].year < query_start[0]) ||
+         (inputs[i].year > query_end[0]))) {
+      continue;
+    }
+    first = ((query_start[0] != -1) && (inputs[i].year == query_start[0])) ?
+            query_start[1] : 0;
+    last = ((query_end[0] != -1) && (inputs[i].year == query_end[0]) &&
+            (query_end[1] < inputs[i].days)) ? query_end[1] :
+           inputs[i].days - 1;
+    if (first > last) {
+      continue;
+    }
+    imdgrd_find_point(&inputs[i], query_point[0], query_point[1],
+                      &lat_index, &lon_index);
+    if ((values = malloc((last - first + 1) * sizeof(float))) == NULL) {
+      fprintf(stderr, "Unable to allocate memory\n");
+      free(inputs);
+      return 1;
+    }
+    t0 = get_time();
+    status = imdgrd_read_point(&inputs[i], lat_index, lon_index, first,
+                               last - first + 1, values);
+    perf.read += get_time() - t0;
+    if (status != IMDGRD_OK) {
+      print_error(status, &inputs[i], NULL);
+      free(values);
+      free(inputs);
+      return 1;
+    }
+    perf.bytes_read += (last - first + 1) * sizeof(float);
+    perf.values += last - first + 1;
+    /* missing values are left empty: */
+    for (j = first; j <= last; j++) {
+      format_date(inputs[i].year, j, date, sizeof(date));
+      if (query_missing(values[j - first], inputs[i].grid->fill) == 1) {
+        printf("%s,\n", date);
+      } else {
+        printf("%s,%g\n", date, values[j - first]);
+      }
+    }
+    free(values);
+  }
+  /* tidy up: */
+  free(inputs);
+  /* return: */
+  return 0;
+}
+
+/*
+ * read back all data values from a netcdf file, returning the time taken in
+ * seconds, or -1 on failure:
+ */
+double read_back(const char *filename, struct imdgrd_output *output,
+                 size_t count) {
+  /* netcdf id and variable id: */
+  int ncid, varid;
+  /* values: */
+  float *values;
+  /* timing: */
+  double t0 = get_time();
+  /* return status: */
+  int ncerr;
+  /* open the file and read the data variable: */
+  if (nc_open(filename, NC_NOWRITE, &ncid) != NC_NOERR) {
+    return -1;
+  }
+  ncerr = nc_inq_varid(ncid, output->ncvar, &varid);
+  if (ncerr == NC_NOERR) {
+    if ((values = malloc(count * sizeof(float))) == NULL) {
+      nc_close(ncid);
+      return -1;
+    }
+    ncerr = nc_get_var_float(ncid, varid, values);
+    free(values);
+  }
+  nc_close(ncid);
+  /* return the time taken: */
+  return (ncerr == NC_NOERR) ? get_time() - t0 : -1;
+}
+
+/*
+ * convert a single input file with each of the benchmark compression
+ * settings, displaying the size, write time and read time for each. output
+ * is written to a temporary file, which is removed after each conversion:
+ */
+int benchmark_codecs(struct _options *options) {
+  /* structs for input and output information, and data: */
+  struct imdgrd_input input;
+  struct imdgrd_output output;
+  struct imdgrd_output bench_output;
+  struct imdgrd_data data;
+  /* temporary file name and descriptor: */
+  char *bench_file;
+  int fd;
+  /* file information: */
+  struct stat file_stat;
+  /* number of values, and uncompressed size in bytes: */
+  size_t count;
+  double raw_size;
+  /* timing: */
+  double t0, write_time, read_time;
+  /* number of settings: */
+  int nsettings = sizeof(benchmark_settings) / sizeof(benchmark_settings[0]);
+  /* for loop integers: */
+  int i;
+  /* get and check input information: */
+  input = get_input(options);
+  input = check_input(options, &input);
+  /*
+   * check output information. the output file is only used to name the
+   * temporary files, so it does not matter if it exists:
+   */
+  clobber_flag = 1;
+  output = check_output(options, &input);
+  /* read the data once: */
+  data = read_data(&input, &output);
+  count = (size_t) data.ndays * data.nlats * data.nlons;
+  raw_size = count * ((precision_type == IMDGRD_PRECISION_SHORT) ?
+                      sizeof(short) : sizeof(float));
+  /* temporary output file name, next to the output file: */
+  bench_file = calloc(strlen(output.filename) + 8, sizeof(char));
+  if (bench_file == NULL) {
+    fprintf(stderr, "Unable to allocate memory\n");
+    imdgrd_free_data(&data);
+    free(output.filename);
+    return 1;
+  }
+  bench_output = output;
+  bench_output.filename = bench_file;
+  /* display the header: */
+  printf("%-8s %5s %7s %10s %7s %9s %9s\n", "Codec", "Level", "Shuffle",
+         "Size (MB)", "Ratio", "Write (s)", "Read (s)");
+  /* loop through settings: */
+  for (i = 0; i < nsettings; i++) {
+    /* skip codecs which are not available: */
+    if (imdgrd_codec_available(benchmark_settings[i].codec) == 0) {
+      printf("%-8s %5d %7s %10s\n",
+             imdgrd_codec_names[benchmark_settings[i].codec],
+             benchmark_settings[i].level,
+             benchmark_settings[i].shuffle ? "yes" : "no", "unavailable");
+      continue;
+    }
+    compression_codec = benchmark_settings[i].codec;
+    compression_level = benchmark_settings[i].level;
+    shuffle_flag = benchmark_settings[i].shuffle;
+    /* create the temporary file: */
+    sprintf(bench_file, "%s.XXXXXX", output.filename);
+    if ((fd = mkstemp(bench_file)) == -1) {
+      fprintf(stderr, "Unable to create temporary file: %s\n", bench_file);
+      break;
+    }
+    close(fd);
+    /* write the data, and read it back: */
+    t0 = get_time();
+    if (write_data(&data, &bench_output) != 0) {
+      printf("%-8s %5d %7s %10s\n", imdgrd_codec_names[compression_codec],
+             compression_level, shuffle_flag ? "yes" : "no", "failed");
+      unlink(bench_file);
+      continue;
+    }
+    write_time = get_time() - t0;
+    read_time = read_back(bench_file, &output, count);
+    if ((read_time < 0) || (stat(bench_file, &file_stat) != 0)) {
+      printf("%-8s %5d %7s %10s\n", imdgrd_codec_names[compression_codec],
+             compression_level, shuffle_flag ? "yes" : "no", "failed");
+      unlink(bench_file);
+      continue;
+    }
+    unlink(bench_file);
+    /* display the results: */
+    printf("%-8s %5d %7s %10.2f %7.2f %9.3f %9.3f\n",
+           imdgrd_codec_names[compression_codec], compression_level,
+           shuffle_flag ? "yes" : "no", file_stat.st_size / 1048576.0,
+           raw_size / file_stat.st_size, write_time, read_time);
+  }
+  /* tidy up: */
+  free(bench_file);
+  imdgrd_free_data(&data);
+  free(output.filename);
   /* return: */
   return 0;
 }
 
+/*
+ * write the statistics accumulated while converting to the statistics file,
+ * using the variable name and units of the output:
+ */
+int write_stats(struct imdgrd_output *output) {
+  /* statistics output information: */
+  struct imdgrd_output stats_output = *output;
+  /* netcdf output settings: */
+  struct imdgrd_ncoptions ncoptions = get_ncoptions();
+  /* netcdf output file ids: */
+  struct imdgrd_ncfile ncfile;
+  /* return status: */
+  int status;
+  /* write the statistics: */
+  stats_output.filename = aggregate_file;
+  status = imdgrd_write_stats(&aggregate_stats, &stats_output, &ncoptions,
+                              &ncfile);
+  imdgrd_free_stats(&aggregate_stats);
+  if (status != IMDGRD_OK) {
+    print_error(status, NULL, &ncfile);
+    return 1;
+  }
+  /* return: */
+  return 0;
+}
+
+/*
+ * when converting incrementally, compare the input file with the
+ * information recorded in an existing output file, to work out whether the
+ * output file is up to date (UPDATE_NONE), can have new days appended
+ * (UPDATE_APPEND), or has to be converted (UPDATE_CONVERT). the information
+ * for the input file is stored in source, and the number of days which were
+ * converted from the same values in ndays. exits if the input file can not
+ * be read:
+ */
+int check_source(struct imdgrd_input *input, struct imdgrd_output *output,
+                 int *ndays) {
+  /* information recorded in the output file: */
+  struct imdgrd_source recorded;
+  /* hash of the values for the days already converted: */
+  uint64_t prefix_hash = 0;
+  /* number of days already converted: */
+  int prefix_days;
+  /* return status: */
+  int status;
+  /* start time: */
+  double t0 = get_time();
+  /* get the size and modification time of the input file: */
+  if ((status = imdgrd_stat_source(input, &source)) != IMDGRD_OK) {
+    print_error(status, input, NULL);
+    exit(1);
+  }
+  /*
+   * an unchanged size and modification time are taken to mean that the
+   * input file has not changed, so the values are not hashed:
+   */
+  if (imdgrd_read_source(output->filename, &recorded) != IMDGRD_OK) {
+    recorded.days = -1;
+  } else if ((recorded.size == source.size) &&
+             (recorded.mtime == source.mtime) &&
+             (recorded.days == source.days)) {
+    perf.check_input += get_time() - t0;
+    return UPDATE_NONE;
+  }
+  /*
+   * hash the values, and the values for the days which have already been
+   * converted, in one pass:
+   */
+  prefix_days = ((recorded.days > 0) && (recorded.days <= source.days)) ?
+                recorded.days : 0;
+  if ((status = imdgrd_hash_source(input, &source, prefix_days,
+                                   &prefix_hash)) != IMDGRD_OK) {
+    print_error(status, input, NULL);
+    exit(1);
+  }
+  perf.check_input += get_time() - t0;
+  /*
+   * the days which have been converted have to be unchanged, and the
+   * statistics can only be calculated from all days. a file which has
+   * only been touched is updated with no new days, to record the new
+   * modification time:
+   */
+  if ((prefix_days > 0) && (prefix_hash == recorded.hash) &&
+      ((aggregate_file == NULL) || (prefix_days == source.days))) {
+    *ndays = prefix_days;
+    return UPDATE_APPEND;
+  }
+  return UPDATE_CONVERT;
+}
+
+/*
+ * convert the days of the input file from day ndays onwards, one day at a
+ * time, and append them to an existing output file. days after ndays which
+ * are already in the output file are converted again:
+ */
+int append_data(struct imdgrd_input *input, struct imdgrd_output *output,
+                int ndays) {
+  /* data struct, for grid information and coordinate values: */
+  struct imdgrd_data data = init_data(input);
+  /* netcdf output settings: */
+  struct imdgrd_ncoptions ncoptions = get_ncoptions();
+  /* netcdf output file ids: */
+  struct imdgrd_ncfile ncfile;
+  /* grd file reader: */
+  struct imdgrd_reader reader;
+  /* values for a single day: */
+  float *values;
+  /* first day to convert, and return status: */
+  int day, status;
+  /* timing: */
+  double t0;
+  /* open the output file: */
+  if ((status = imdgrd_open_output(&data, output, &ncoptions, &ncfile,
+                                   &day)) != IMDGRD_OK) {
+    print_error(status, input, &ncfile);
+    imdgrd_free_data(&data);
+    return 1;
+  }
+  day = (day < ndays) ? day : ndays;
+  if (day < data.ndays) {
+    printf("Appending days %d to %d to output file: %s\n", day + 1,
+           data.ndays, output->filename);
+  }
+  /* open the input file, at the first new day: */
+  t0 = get_time();
+  if (((status = imdgrd_open_reader(input, &data, &reader,
+                                    mmap_flag)) == IMDGRD_OK) &&
+      ((status = imdgrd_seek_reader(&reader, day)) == IMDGRD_OK)) {
+    perf.read += get_time() - t0;
+    /* convert the new days: */
+    for (; day < data.ndays; day++) {
+      t0 = get_time();
+      values = imdgrd_read_day(&reader, day);
+      perf.read += get_time() - t0;
+      if (values == NULL) {
+        status = IMDGRD_EREAD;
+        break;
+      }
+      if ((status = imdgrd_write_day(&ncfile, &data, day,
+                                     values)) != IMDGRD_OK) {
+        break;
+      }
+    }
+  }
+  imdgrd_close_reader(&reader);
+  count_input(input, &data);
+  /* record the input file, and close the output file: */
+  if (status == IMDGRD_OK) {
+    status = put_source(&ncfile);
+    if (status == 0) {
+      status = close_output(&ncfile);
+      count_write_times(&ncfile);
+    }
+  } else {
+    print_error(status, input, &ncfile);
+    if (status == IMDGRD_EREAD) {
+      fprintf(stderr, "Unable to read values for day %d\n", day + 1);
+    }
+    if (ncfile.ncid != -1) {
+      imdgrd_close_output(&ncfile);
+    }
+    status = 1;
+  }
+  /* tidy up: */
+  imdgrd_free_data(&data);
+  /* return: */
+  return status;
+}
+
+/*
+ * convert a single input file, using the infile option. exits on invalid
+ * input, otherwise returns the exit status of the conversion:
+ */
+int convert_file(struct _options *options) {
+  /* structs for input and output information, and data: */
+  struct imdgrd_input input;
+  struct imdgrd_output output;
+  struct imdgrd_data data;
+  /* exit status: */
+  int status = 0;
+  /* how the output file is brought up to date, and number of days already
+     converted: */
+  int update, ndays;
+  /* start time of writing statistics: */
+  double t0;
+  /* get input information: */
+  input = get_input(options);
+  /* check input information and options: */
+  input = check_input(options, &input);
+  /* check output information and options: */
+  output = check_output(options, &input);
+  /*
+   * when converting incrementally, leave an output file which is up to date
+   * alone, or only convert the new days:
+   */
+  update = (incremental_flag == 1) ? check_source(&input, &output, &ndays) :
+           UPDATE_CONVERT;
+  if (update == UPDATE_NONE) {
+    printf("Output file is up to date: %s\n", output.filename);
+    free(output.filename);
+    return 0;
+  }
+  /* convert one day at a time, if requested: */
+  if (update == UPDATE_APPEND) {
+    status = append_data(&input, &output, ndays);
+  } else if (pipeline_depth > 0) {
+    status = pipeline_data(&input, &output);
+  } else if (stream_flag == 1) {
+    status = stream_data(&input, &output);
+  } else {
+    /* read data: */
+    data = read_data(&input, &output);
+    /* write the data to netcdf: */
+    status = write_data(&data, &output);
+    /* memory which needs to be free: */
+    imdgrd_free_data(&data);
+  }
+  /* report the quality control results: */
+  if (status == 0) {
+    count_output(output.filename);
+    status = report_qc(output.filename);
+  }
+  /* write the statistics, if requested, unless only new days were added: */
+  if ((status == 0) && (aggregate_file != NULL) &&
+      (update != UPDATE_APPEND)) {
+    t0 = get_time();
+    status = write_stats(&output);
+    perf.aggregate = get_time() - t0;
+  }
+  /* memory which needs to be free: */
+  free(output.filename);
+  /* return: */
+  return status;
+}
+
+/*
+ * batch worker process. reads the index of each file to convert from the
+ * command pipe, converts it, and writes the exit status of the conversion
+ * to the result pipe, until the command pipe is closed. a conversion which
+ * exits, such as for an invalid input file, ends the worker:
+ */
+void batch_worker(struct _options *options, struct _job *jobs, int command,
+                  int result) {
+  /* options for a single file: */
+  struct _options file_options;
+  /* index of the file to convert, and exit status of the conversion: */
+  int index, status;
+  while (read(command, &index, sizeof(int)) == sizeof(int)) {
+    file_options = *options;
+    file_options.infile = jobs[index].filename;
+    status = convert_file(&file_options);
+    fflush(stdout);
+    fflush(stderr);
+    if (write(result, &status, sizeof(int)) != sizeof(int)) {
+      break;
+    }
+  }
+  exit(0);
+}
+
+/*
+ * start a batch worker process, which inherits the options and jobs. the
+ * worker only keeps its own ends of its own pipes. returns 0 if the worker
+ * has been started:
+ */
+int start_worker(struct _options *options, struct _job *jobs,
+                 struct _worker *workers, int nworkers, int index) {
+  /* the worker being started: */
+  struct _worker *worker = &workers[index];
+  /* command and result pipes: */
+  int command[2], result[2];
+  /* for loop integers: */
+  int i;
+  if (pipe(command) != 0) {
+    return 1;
+  }
+  if (pipe(result) != 0) {
+    close(command[0]);
+    close(command[1]);
+    return 1;
+  }
+  /* output from the parent should not be duplicated by the worker: */
+  fflush(stdout);
+  fflush(stderr);
+  if ((worker->pid = fork()) == 0) {
+    /* worker process, close the pipes of the other workers: */
+    for (i = 0; i < nworkers; i++) {
+      if ((i != index) && (workers[i].pid != -1)) {
+        close(workers[i].command);
+        close(workers[i].result);
+      }
+    }
+    close(command[1]);
+    close(result[0]);
+    batch_worker(options, jobs, command[0], result[1]);
+  }
+  close(command[0]);
+  close(result[1]);
+  if (worker->pid < 0) {
+    worker->pid = -1;
+    close(command[1]);
+    close(result[0]);
+    return 1;
+  }
+  worker->command = command[1];
+  worker->result = result[0];
+  worker->job = -1;
+  return 0;
+}
+
+/*
+ * pass the next file to a batch worker, or if there are no more files,
+ * close its command pipe so that it exits:
+ */
+void next_job(struct _worker *worker, struct _job *jobs, int njobs,
+              int *next) {
+  if (*next == njobs) {
+    close(worker->command);
+    worker->command = -1;
+    return;
+  }
+  worker->job = *next;
+  jobs[worker->job].start = get_time();
+  (*next)++;
+  /* if the worker has gone, the job fails when its result pipe closes: */
+  if (write(worker->command, &worker->job, sizeof(int)) != sizeof(int)) {
+    close(worker->command);
+    worker->command = -1;
+  }
+}
+
+/*
+ * convert all of the input files, using a pool of worker processes. each
+ * worker is started once, and converts files one after another, taken from
+ * the list of files in order, so that starting a process, and initialising
+ * the netcdf library, are not repeated for every file. a worker which exits,
+ * such as for an invalid input file, only ends the conversion of that file,
+ * and is replaced. a summary of the conversions is displayed, and the return
+ * value is non zero if any conversion failed:
+ */
+int convert_batch(struct _options *options) {
+  /* information for each file: */
+  struct _job *jobs;
+  /* worker processes, the number of workers, and a worker which has
+     finished a file: */
+  struct _worker *workers, *worker;
+  int nworkers;
+  /* result pipes being waited on, and the worker for each: */
+  struct pollfd *fds;
+  int *fd_workers, nfds;
+  /* exit status returned by a worker, and by waitpid: */
+  int status, wstatus;
+  /* next file to convert, and count of failed conversions: */
+  int next = 0, failed = 0;
+  /* timing and total input size: */
+  double t0, elapsed;
+  double total_size = 0;
+  /* for loop integers: */
+  int i;
+  /* an output file name or year can not apply to more than one file: */
+  if (strcmp(options->outfile, "") != 0) {
+    fprintf(stderr, "Output file (-o) can not be used with multiple input "
+                    "files\n");
+    return 1;
+  }
+  if (options->year != -1) {
+    fprintf(stderr, "Year (-y) can not be used with multiple input files\n");
+    return 1;
+  }
+  /* set up the jobs and workers: */
+  nworkers = (options->jobs < options->ninfiles) ? options->jobs :
+             options->ninfiles;
+  jobs = calloc(options->ninfiles, sizeof(struct _job));
+  workers = calloc(nworkers, sizeof(struct _worker));
+  fds = calloc(nworkers, sizeof(struct pollfd));
+  fd_workers = calloc(nworkers, sizeof(int));
+  if ((jobs == NULL) || (workers == NULL) || (fds == NULL) ||
+      (fd_workers == NULL)) {
+    fprintf(stderr, "Unable to allocate memory\n");
+    free(jobs);
+    free(workers);
+    free(fds);
+    free(fd_workers);
+    return 1;
+  }
+  for (i = 0; i < options->ninfiles; i++) {
+    jobs[i].filename = options->infiles[i];
+    jobs[i].size = imdgrd_file_exists(jobs[i].filename);
+    jobs[i].status = -1;
+  }
+  for (i = 0; i < nworkers; i++) {
+    workers[i].pid = -1;
+  }
+  /* a worker which has gone should not end the program: */
+  signal(SIGPIPE, SIG_IGN);
+  t0 = get_time();
+  /* start the workers, and give each a file: */
+  for (i = 0; i < nworkers; i++) {
+    if (start_worker(options, jobs, workers, nworkers, i) == 0) {
+      next_job(&workers[i], jobs, options->ninfiles, &next);
+    }
+  }
+  /* wait for results until all of the workers have finished: */
+  while (1) {
+    nfds = 0;
+    for (i = 0; i < nworkers; i++) {
+      if (workers[i].pid != -1) {
+        fds[nfds].fd = workers[i].result;
+        fds[nfds].events = POLLIN;
+        fd_workers[nfds] = i;
+        nfds++;
+      }
+    }
+    if (nfds == 0) {
+      break;
+    }
+    if (poll(fds, nfds, -1) < 0) {
+      continue;
+    }
+    for (i = 0; i < nfds; i++) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      worker = &workers[fd_workers[i]];
+      if (read(worker->result, &status, sizeof(int)) == sizeof(int)) {
+        /* the worker has converted a file, give it the next one: */
+        jobs[worker->job].elapsed = get_time() - jobs[worker->job].start;
+        jobs[worker->job].status = status;
+        failed += (status != 0) ? 1 : 0;
+        worker->job = -1;
+        next_job(worker, jobs, options->ninfiles, &next);
+        continue;
+      }
+      /* the worker has exited: */
+      close(worker->result);
+      if (worker->command != -1) {
+        close(worker->command);
+      }
+      waitpid(worker->pid, &wstatus, 0);
+      worker->pid = -1;
+      if (worker->job != -1) {
+        jobs[worker->job].elapsed = get_time() - jobs[worker->job].start;
+        jobs[worker->job].status = (WIFEXITED(wstatus) &&
+                                    (WEXITSTATUS(wstatus) != 0)) ?
+                                   WEXITSTATUS(wstatus) : 1;
+        failed++;
+        /* replace the worker, if there are more files to convert: */
+        if ((next < options->ninfiles) &&
+            (start_worker(options, jobs, workers, nworkers,
+                          fd_workers[i]) == 0)) {
+          next_job(worker, jobs, options->ninfiles, &next);
+        }
+      }
+    }
+  }
+  /* files which no worker could be started for: */
+  for (i = 0; i < options->ninfiles; i++) {
+    if (jobs[i].status == -1) {
+      fprintf(stderr, "Unable to start conversion of file: %s\n",
+              jobs[i].filename);
+      jobs[i].status = 1;
+      failed++;
+    }
+  }
+  elapsed = get_time() - t0;
+  /* display the summary: */
+  printf("\n%-6s %10s %10s  %s\n", "Status", "Time (s)", "MB/s", "File");
+  for (i = 0; i < options->ninfiles; i++) {
+    if (jobs[i].status == 0) {
+      total_size += jobs[i].size;
+      printf("%-6s %10.3f %10.2f  %s\n", "OK", jobs[i].elapsed,
+             (jobs[i].elapsed > 0) ?
+             jobs[i].size / (jobs[i].elapsed * 1048576) : 0,
+             jobs[i].filename);
+    } else {
+      printf("%-6s %10.3f %10s  %s\n", "FAILED", jobs[i].elapsed, "-",
+             jobs[i].filename);
+    }
+  }
+  printf("\nConverted %d of %d files in %.3fs with %d jobs "
+         "(%.2f files/s, %.2f MB/s). %d failed\n",
+         options->ninfiles - failed, options->ninfiles, elapsed,
+         options->jobs, (options->ninfiles - failed) / elapsed,
+         total_size / (elapsed * 1048576), failed);
+  /* tidy up: */
+  free(jobs);
+  free(workers);
+  free(fds);
+  free(fd_workers);
+  /* return: */
+  return (failed > 0) ? 1 : 0;
+}
+
+/* print a string in json format: */
+void print_json_string(FILE *file, const char *str) {
+  fputc('"', file);
+  for (; *str != '\0'; str++) {
+    if ((unsigned char) *str < 0x20) {
+      fprintf(file, "\\u%04x", *str);
+      continue;
+    }
+    if ((*str == '"') || (*str == '\\')) {
+      fputc('\\', file);
+    }
+    fputc(*str, file);
+  }
+  fputc('"', file);
+}
+
+/*
+ * output the performance statistics as json, to the statistics file or
+ * standard output. returns 0 on success:
+ */
+int print_perf(struct _options *options) {
+  /* output file: */
+  FILE *perf_out = stdout;
+  /* resource usage, for peak memory use: */
+  struct rusage rusage;
+  /* conversion mode: */
+  const char *mode;
+  /* for loop integers: */
+  int i;
+  /* open the statistics file: */
+  if ((perf_file != NULL) && ((perf_out = fopen(perf_file, "w")) == NULL)) {
+    fprintf(stderr, "Unable to open statistics file: %s\n", perf_file);
+    return 1;
+  }
+  getrusage(RUSAGE_SELF, &rusage);
+  if (query_flag == 1) {
+    mode = "query";
+  } else if (mpi_size > 1) {
+    mode = "parallel";
+  } else if (pipeline_depth > 0) {
+    mode = "pipeline";
+  } else if ((stream_flag == 1) || (merge_flag == 1)) {
+    mode = "stream";
+  } else {
+    mode = "read";
+  }
+  /* input and output files: */
+  fprintf(perf_out, "{\n  \"inputs\": [");
+  if (options->ninfiles > 0) {
+    for (i = 0; i < options->ninfiles; i++) {
+      if (i > 0) {
+        fprintf(perf_out, ", ");
+      }
+      print_json_string(perf_out, options->infiles[i]);
+    }
+  } else {
+    print_json_string(perf_out, options->infile);
+  }
+  fprintf(perf_out, "],\n  \"output\": ");
+  if (perf.output != NULL) {
+    print_json_string(perf_out, perf.output);
+  } else {
+    fprintf(perf_out, "null");
+  }
+  /* settings and times: */
+  fprintf(perf_out, ",\n"
+          "  \"mode\": \"%s\",\n"
+          "  \"format\": \"%s\",\n"
+          "  \"layout\": \"%s\",\n"
+          "  \"regrid\": ",
+          mode, imdgrd_format_names[output_format],
+          imdgrd_layout_names[data_layout]);
+  if (regrid_grid != NULL) {
+    print_json_string(perf_out, regrid.target->name);
+  } else {
+    fprintf(perf_out, "null");
+  }
+  fprintf(perf_out, ",\n"
+          "  \"mmap\": %s,\n"
+          "  \"processes\": %d,\n"
+          "  \"times\": {\n"
+          "    \"get_input\": %.6f,\n"
+          "    \"check_input\": %.6f,\n"
+          "    \"read\": %.6f,\n"
+          "    \"define\": %.6f,\n"
+          "    \"weights\": %.6f,\n"
+          "    \"convert\": %.6f,\n"
+          "    \"put\": %.6f,\n"
+          "    \"close\": %.6f,\n"
+          "    \"aggregate\": %.6f,\n"
+          "    \"total\": %.6f\n"
+          "  },\n",
+          (mmap_flag == 1) ? "true" : "false", mpi_size,
+          perf.get_input, perf.check_input, perf.read, perf.define,
+          regrid.weights_time, perf.convert, perf.put, perf.close,
+          perf.aggregate, perf.total);
+  /* sizes and memory use. ru_maxrss is in kilobytes on linux: */
+  fprintf(perf_out,
+          "  \"bytes_read\": %zu,\n"
+          "  \"bytes_written\": %zu,\n"
+          "  \"values\": %zu,\n"
+          "  \"put_calls\": %zu,\n"
+          "  \"compression_ratio\": %.3f,\n"
+          "  \"peak_rss_kb\": %ld\n"
+          "}\n",
+          perf.bytes_read, perf.bytes_written, perf.values, perf.put_calls,
+          (perf.bytes_written > 0) ?
+          (double) perf.values * sizeof(float) / perf.bytes_written : 0.0,
+          rusage.ru_maxrss);
+  /* close the statistics file: */
+  if ((perf_out != stdout) && (fclose(perf_out) != 0)) {
+    fprintf(stderr, "Error writing statistics file: %s\n", perf_file);
+    return 1;
+  }
+  return 0;
+}
+
 /* main program: */
 int main(int argc, char **argv) {
-  /* structs for options, input and output information, and data: */
+  /* struct for options: */
   struct _options options;
-  struct _input input;
-  struct _output output;
-  struct _data data;
   /* exit status: */
   int status = 0;
+  /* start time: */
+  double t0 = get_time();
+  /* for loop integers: */
+  int i;
+#ifdef USE_MPI
+  /* start mpi, when run with mpirun: */
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+#endif
   /* use basename() function to get the name of the program: */
   program_name = basename(argv[0]);
   /* get program options: */
@@ -833,22 +2868,117 @@ int main(int argc, char **argv) {
     /* print usage information: */
     usage(1);
   }
-  /* get input information: */
-  input = get_input(&options);
-  /* check input information and options: */
-  input = check_input(&options, &input);
-  /* check output information and options: */
-  output = check_output(&options, &input);
-  /* read data: */
-  data = read_data(&input, &output);
-  /* write the data to netcdf: */
-  status = write_data(&data, &output);
+  /* statistics are for a single year, from a single conversion: */
+  if ((aggregate_file != NULL) &&
+      ((benchmark_codecs_flag == 1) || (merge_flag == 1) ||
+       (options.ninfiles > 1))) {
+    fprintf(stderr, "Statistics can only be written when converting a "
+                    "single input file\n");
+    status = 1;
+  /* a single quality control report is written for each conversion: */
+  } else if ((qc_report_file != NULL) &&
+             ((benchmark_codecs_flag == 1) ||
+              ((merge_flag == 0) && (options.ninfiles > 1)))) {
+    fprintf(stderr, "A quality control report can only be written when "
+                    "converting a single input file, or merging files\n");
+    status = 1;
+  /* same for performance statistics: */
+  } else if ((perf_flag == 1) &&
+             ((benchmark_codecs_flag == 1) ||
+              ((merge_flag == 0) && (options.ninfiles > 1)))) {
+    fprintf(stderr, "Performance statistics can only be output when "
+                    "converting a single input file, or merging files\n");
+    status = 1;
+  /* queries read the input files, without writing any output: */
+  } else if ((query_flag == 1) &&
+             ((benchmark_codecs_flag == 1) || (merge_flag == 1) ||
+              (incremental_flag == 1) || (aggregate_file != NULL) ||
+              (qc_report_file != NULL) || (mpi_size > 1) ||
+              (regrid_grid != NULL) || (strcmp(options.outfile, "") != 0))) {
+    fprintf(stderr, "A query can not be used with an output file, merging, "
+                    "statistics, quality control reports, incremental "
+                    "conversion, regridding, MPI or benchmarking codecs\n");
+    status = 1;
+  /* the time series is written to standard output, so statistics can't be: */
+  } else if ((query_flag == 1) && (perf_flag == 1) && (perf_file == NULL)) {
+    fprintf(stderr, "Performance statistics for a query have to be written "
+                    "to a file, with --stats=json-file\n");
+    status = 1;
+  /* incremental conversions are for single or batch conversions: */
+  } else if ((incremental_flag == 1) &&
+             ((benchmark_codecs_flag == 1) || (merge_flag == 1))) {
+    fprintf(stderr, "Incremental conversion can not be used when merging "
+                    "files or benchmarking codecs\n");
+    status = 1;
+  /* zarr stores are written by a single process, from scratch: */
+  } else if ((output_format == IMDGRD_FORMAT_ZARR) &&
+             ((benchmark_codecs_flag == 1) || (incremental_flag == 1) ||
+              (mpi_size > 1))) {
+    fprintf(stderr, "Zarr output can not be used when benchmarking codecs, "
+                    "converting incrementally or merging with more than "
+                    "one process\n");
+    status = 1;
+  /* time-major files are written by a single process, as netcdf: */
+  } else if ((data_layout == IMDGRD_LAYOUT_TIME_MAJOR) &&
+             ((output_format == IMDGRD_FORMAT_ZARR) || (mpi_size > 1))) {
+    fprintf(stderr, "The time-major layout can not be used with Zarr output, "
+                    "or when merging with more than one process\n");
+    status = 1;
+  /* regridded files are written by a single process, and not read back: */
+  } else if ((regrid_grid != NULL) &&
+             ((benchmark_codecs_flag == 1) || (mpi_size > 1))) {
+    fprintf(stderr, "Regridding can not be used when benchmarking codecs, or "
+                    "merging with more than one process\n");
+    status = 1;
+  } else if ((output_format == IMDGRD_FORMAT_ZARR) &&
+             (imdgrd_zarr_available(compression_codec) == 0)) {
+    fprintf(stderr, "Compression codec not available for Zarr output: %s\n",
+            imdgrd_codec_names[compression_codec]);
+    status = 1;
+  /* only merging is done in parallel: */
+  } else if ((mpi_size > 1) &&
+             ((merge_flag == 0) || (benchmark_codecs_flag == 1))) {
+    fprintf(stderr, "Only merging input files (-M) can be run with more than "
+                    "one process\n");
+    status = 1;
+  } else if ((mpi_size > 1) && (qc_report_file != NULL)) {
+    fprintf(stderr, "A quality control report can not be written when "
+                    "merging with more than one process\n");
+    status = 1;
+  /* benchmark codecs, merge files, convert more than one file, or a single
+     file: */
+  } else if (benchmark_codecs_flag == 1) {
+    if (options.ninfiles > 1) {
+      fprintf(stderr, "Codecs can only be benchmarked with a single input "
+                      "file\n");
+      status = 1;
+    } else {
+      status = benchmark_codecs(&options);
+    }
+  } else if (query_flag == 1) {
+    status = query_data(&options);
+  } else if (merge_flag == 1) {
+    status = merge_data(&options);
+  } else if (options.ninfiles > 1) {
+    status = convert_batch(&options);
+  } else {
+    status = convert_file(&options);
+  }
+  /* output performance statistics, if requested: */
+  if ((status == 0) && (perf_flag == 1) && (mpi_rank == 0)) {
+    perf.total = get_time() - t0;
+    status = print_perf(&options);
+  }
   /* memory which needs to be free: */
-  free(data.lats);
-  free(data.lons);
-  free(data.data);
-  free(data.days);
-  free(output.filename);
+  free(perf.output);
+  for (i = 0; i < options.ninfiles; i++) {
+    free(options.infiles[i]);
+  }
+  free(options.infiles);
+  imdgrd_free_regrid(&regrid);
+#ifdef USE_MPI
+  MPI_Finalize();
+#endif
   /* exit: */
   exit(status);
 }
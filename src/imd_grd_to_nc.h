@@ -2,57 +2,166 @@
 #define MIN_YEAR 1900
 #define MAX_YEAR 2100
 
-/* data types: */
-#define RAIN 0
-#define TEMP 1
-#define MINTEMP 2
-#define MAXTEMP 3
-const char *data_types[] = {
-  "rain",
-  "temp",
-  "mintemp",
-  "maxtemp"
-};
-
-/* default output variable names: */
-const char *nc_vars[] = {
-  "rainfall",
-  "temp",
-  "min_temp",
-  "max_temp"
-};
-
-/* default output units: */
-const char *nc_units[] = {
-  "mm",
-  "celsius",
-  "celsius",
-  "celsius"
-};
+/* output precision type: */
+int precision_type;
+/* number of mantissa bits to keep, for the bits precision type: */
+int precision_bits;
 
-/* initial lat and lon values: */
-const float rain_lat0 = 6.5;
-const float rain_lon0 = 66.5;
-const float temp_lat0 = 7.5;
-const float temp_lon0 = 67.5;
-
-/* grid sizes: */
-const float rain_grid = 0.25;
-const int rain_lats = 129;
-const int rain_lons = 135;
-const float temp_grid = 1.0;
-const int temp_lats = 31;
-const int temp_lons = 31;
-
-/* fill values for netcdf: */
-const float rain_fill = -999;
-const float temp_fill = 99.9;
-
-/* extension for output files: */
+/* extension for output files, and for zarr output: */
 const char *nc_ext = ".nc";
+const char *zarr_ext = ".zarr";
 
 /* int for storing whether files should be overwritten: */
 int clobber_flag;
+/* int for storing whether input files should be memory mapped: */
+int mmap_flag;
+/* int for storing whether data should be converted one day at a time: */
+int stream_flag;
+/* int for storing whether input files should be merged in to one output: */
+int merge_flag;
+#ifdef USE_MPI
+/* rank of this process, and number of processes, when run with mpirun: */
+int mpi_rank;
+int mpi_size = 1;
+#else
+/* without mpi, there is always a single process: */
+const int mpi_rank = 0;
+const int mpi_size = 1;
+#endif
+/*
+ * number of day buffers used when reading and writing in separate threads.
+ * 0 disables the reader thread:
+ */
+int pipeline_depth;
+/* maximum number of day buffers: */
+#define MAX_PIPELINE_DEPTH 366
+
+/* chunk layout for the netcdf data variable: */
+int chunk_layout;
+/* chunk sizes (time, lat, lon) for the custom chunk layout: */
+size_t chunk_sizes[3];
+/* order of the dimensions of the data variable: */
+int data_layout = IMDGRD_LAYOUT_DAY_MAJOR;
+
+/* int for storing whether a bounding box has been specified: */
+int bbox_flag;
+/* bounding box (lat0, lat1, lon0, lon1) of the grid points to convert: */
+float bbox[4];
+/* netcdf file containing a mask of the grid points to convert, or NULL: */
+const char *mask_file;
+
+/* byte order of input files: */
+int endian = IMDGRD_ENDIAN_AUTO;
+
+/* int for storing whether values should be checked when converting: */
+int qc_flag = 1;
+/* quality control settings and results: */
+struct imdgrd_qc qc;
+/* csv file for daily quality control results, or NULL: */
+const char *qc_report_file;
+
+/* netcdf file for monthly and seasonal statistics, or NULL: */
+char *aggregate_file;
+/* statistics accumulated while converting: */
+struct imdgrd_stats aggregate_stats;
+
+/*
+ * int for storing whether an existing output file should be left alone if
+ * it is up to date with the input file, or only new days added if the input
+ * file has grown:
+ */
+int incremental_flag;
+/* information about the input file, recorded in the output file: */
+struct imdgrd_source source;
+/* ways of bringing an existing output file up to date: */
+#define UPDATE_CONVERT 0
+#define UPDATE_NONE 1
+#define UPDATE_APPEND 2
+
+/* output format: */
+int output_format = IMDGRD_FORMAT_NETCDF;
+/* number of threads compressing zarr chunks, or 0 for one per processor: */
+int zarr_threads;
+
+/* int for storing whether a time series should be written for a point: */
+int query_flag;
+/* lat and lon of the point: */
+float query_point[2];
+/*
+ * year and day of the year (from 0) of the first and last day of the time
+ * series, or -1 for all days:
+ */
+int query_start[2] = {-1, -1};
+int query_end[2] = {-1, -1};
+
+/* name of the grid to regrid the values to, or NULL: */
+const char *regrid_grid;
+/* directory for cached regridding weights, or NULL for the default: */
+const char *regrid_cache;
+/* number of threads regridding days, or 0 for one per processor: */
+int regrid_threads;
+/* regridding settings and weights: */
+struct imdgrd_regrid regrid;
+/* default directory for cached regridding weights, in the home directory: */
+#define REGRID_CACHE_DIR ".cache/imdgrd"
+
+/* int for storing whether performance statistics should be output: */
+int perf_flag;
+/* json file for performance statistics, or NULL for standard output: */
+const char *perf_file;
+
+/* define struct for storing performance statistics: */
+struct _perf {
+  /*
+   * time spent in each phase, in seconds. with a pipeline, reading overlaps
+   * converting and putting values:
+   */
+  double get_input;
+  double check_input;
+  double read;
+  double define;
+  double convert;
+  double put;
+  double close;
+  double aggregate;
+  double total;
+  /* bytes read from the input files, and written to the output file: */
+  size_t bytes_read;
+  size_t bytes_written;
+  /* number of values written: */
+  size_t values;
+  /* number of netcdf calls putting values in to the output file: */
+  size_t put_calls;
+  /* output file name: */
+  char *output;
+};
+/* performance statistics for the conversion: */
+struct _perf perf;
+
+/* values for options which only have a long form: */
+#define OPT_PIPELINE_DEPTH 256
+#define OPT_CHUNKING 257
+#define OPT_PRECISION 258
+#define OPT_COMPRESSION 259
+#define OPT_SHUFFLE 260
+#define OPT_BENCHMARK_CODECS 261
+#define OPT_GRIDS 262
+#define OPT_BBOX 263
+#define OPT_MASK 264
+#define OPT_AGGREGATE 265
+#define OPT_MISSING 266
+#define OPT_QC_REPORT 267
+#define OPT_NO_QC 268
+#define OPT_ENDIAN 269
+#define OPT_STATS 270
+#define OPT_INCREMENTAL 271
+#define OPT_ZARR 272
+#define OPT_ZARR_THREADS 273
+#define OPT_QUERY 274
+#define OPT_LAYOUT 275
+#define OPT_REGRID 276
+#define OPT_REGRID_THREADS 277
+#define OPT_REGRID_CACHE 278
 
 /* define struct for storing program options: */
 struct _options {
@@ -70,85 +179,116 @@ struct _options {
   int year;
   /* whether help has been requested: */
   int help;
+  /* all input files, when converting more than one file: */
+  char **infiles;
+  /* number of input files: */
+  int ninfiles;
+  /* file containing a list of input files: */
+  const char *listfile;
+  /* number of files to convert in parallel: */
+  int jobs;
+  /* file containing additional grids: */
+  const char *gridfile;
 };
 const struct _options DEFAULT_OPTIONS = {
-  "", "", "", "", -1, -1, -1
+  "", "", "", "", -1, -1, -1, NULL, 0, "", 1, ""
 };
 
-/* define struct for storing input file information: */
-struct _input {
+/* maximum number of files to convert in parallel: */
+#define MAX_JOBS 256
+
+/* define struct for storing information about a batch conversion job: */
+struct _job {
   /* input file name: */
   const char *filename;
-  /* file size: */
+  /* input file size: */
   int size;
-  /* data type. rainfall = 0, temperature = 1: */
-  int type;
-  /* number of days in year: */
-  int days;
-  /* input data year: */
-  int year;
-  /* indicates year has been matched from file name: */
-  int year_match;
-};
-const struct _input DEFAULT_INPUT = {
-  "", -1, -1, -1, -1, -1
+  /* start time of the conversion: */
+  double start;
+  /* time taken by the conversion: */
+  double elapsed;
+  /* exit status of the conversion: */
+  int status;
 };
 
-/* define struct for storing output file information: */
-struct _output {
-  /* output file name: */
-  char *filename;
-  /* variable name for netcdf output: */
-  const char *ncvar;
-  /* units for netcdf output: */
-  const char *ncunits;
-};
-const struct _output DEFAULT_OUTPUT = {
-  "", "", ""
+/*
+ * define struct for storing information about a batch worker process, which
+ * converts files one after another, as they are passed to it:
+ */
+struct _worker {
+  /* process id, or -1 if the worker is not running: */
+  pid_t pid;
+  /* pipe for passing the index of the next file to convert, and for
+     returning the exit status of each conversion: */
+  int command;
+  int result;
+  /* index of the file being converted, or -1: */
+  int job;
 };
 
-/* define structs for storing data: */
-struct _data {
-  /* grid size: */
-  float grid;
-  /* number of lats: */
-  int nlats;
-  /* number of lons: */
-  int nlons;
-  /* initial lat value: */
-  float lat0;
-  /* initial lon value: */
-  float lon0;
-  /* year: */
-  int year;
-  /* number of days: */
+/*
+ * define struct for passing days from a reader thread to the writer, through
+ * a ring of day buffers:
+ */
+struct _pipeline {
+  /* grd file reader: */
+  struct imdgrd_reader *reader;
+  /* number of days to read: */
   int ndays;
-  /* day values: */
-  float *days;
-  /* lat values: */
-  float *lats;
-  /* lon values: */
-  float *lons;
-  /* size of a single data value in bytes: */
-  int datasize;
-  /* data: */
-  float *data;
-  /* fill value: */
-  float fill;
+  /* ring of day buffers: */
+  float **buffers;
+  /* number of day buffers: */
+  int depth;
+  /* index of next buffer to be filled by the reader: */
+  int head;
+  /* index of next buffer to be written by the writer: */
+  int tail;
+  /* number of buffers which are filled and waiting to be written: */
+  int count;
+  /* day which could not be read, or -1: */
+  int read_error;
+  /* set by the writer if the reader should stop: */
+  int cancel;
+  /* time spent by the reader thread reading, in seconds: */
+  double read_time;
+  /* lock and conditions for access to the ring: */
+  pthread_mutex_t lock;
+  pthread_cond_t filled;
+  pthread_cond_t emptied;
 };
 
-/* netcdf creation flags: */
-#define NC_CREATE_FLAGS NC_CLOBBER|NC_NETCDF4
-/* netcdf variable names, etc.: */
-#define NC_TIME_VAR "time"
-#define NC_LAT_VAR "latitude"
-#define NC_LON_VAR "longitude"
-#define NC_CAL "calendar"
-#define NC_CAL_TYPE "standard"
-#define NC_UNITS "units"
-#define NC_TIME_UNITS "days since XXXX-1-1 0:0:0"
-#define NC_LAT_UNITS "degrees_north"
-#define NC_LON_UNITS "degrees_east"
-#define NC_FILLV "_FillValue"
-/* compression level: */
-#define NC_COMP 3
+/* compression codec, level and whether shuffle filter is enabled: */
+int compression_codec = IMDGRD_CODEC_DEFLATE;
+int compression_level = IMDGRD_NC_COMP;
+int shuffle_flag;
+/* int for storing whether compression codecs should be benchmarked: */
+int benchmark_codecs_flag;
+
+/* define struct for storing a compression setting to benchmark: */
+struct _codec_setting {
+  /* compression codec: */
+  int codec;
+  /* compression level: */
+  int level;
+  /* whether shuffle filter is enabled: */
+  int shuffle;
+};
+/* compression settings used when benchmarking codecs: */
+const struct _codec_setting benchmark_settings[] = {
+  {IMDGRD_CODEC_NONE, 0, 0},
+  {IMDGRD_CODEC_DEFLATE, 1, 0},
+  {IMDGRD_CODEC_DEFLATE, 1, 1},
+  {IMDGRD_CODEC_DEFLATE, 3, 0},
+  {IMDGRD_CODEC_DEFLATE, 3, 1},
+  {IMDGRD_CODEC_DEFLATE, 6, 1},
+  {IMDGRD_CODEC_DEFLATE, 9, 1},
+  {IMDGRD_CODEC_ZSTD, 1, 1},
+  {IMDGRD_CODEC_ZSTD, 3, 0},
+  {IMDGRD_CODEC_ZSTD, 3, 1},
+  {IMDGRD_CODEC_ZSTD, 9, 1},
+  {IMDGRD_CODEC_ZSTD, 19, 1},
+  {IMDGRD_CODEC_SZIP, 0, 0},
+  {IMDGRD_CODEC_SZIP, 0, 1},
+  {IMDGRD_CODEC_BLOSC, 5, 1},
+  {IMDGRD_CODEC_BLOSC, 9, 1}
+};
@@ -0,0 +1,5696 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <netcdf.h>
+#include <netcdf_meta.h>
+#if NC_HAS_ZSTD || NC_HAS_BLOSC
+#include <netcdf_filter.h>
+#endif
+#ifdef USE_MPI
+#if !NC_HAS_PARALLEL4
+#error "USE_MPI requires a NetCDF library built with parallel NetCDF-4 support"
+#endif
+#include <netcdf_par.h>
+#endif
+#include <imdgrd.h>
+
+/*
+ * with gcc on x86-64 linux, kernels marked with SIMD_CLONES are also built
+ * for avx2, and the version to use is chosen at run time:
+ */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && \
+    defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+/* data types: */
+const char *imdgrd_data_types[] = {
+  "rain",
+  "temp",
+  "mintemp",
+  "maxtemp"
+};
+
+/* default output variable names: */
+const char *imdgrd_nc_vars[] = {
+  "rainfall",
+  "temp",
+  "min_temp",
+  "max_temp"
+};
+
+/* default output units: */
+const char *imdgrd_nc_units[] = {
+  "mm",
+  "celsius",
+  "celsius",
+  "celsius"
+};
+
+/*
+ * built in grids. each grid is recognised from the size of a grd file, for
+ * a 365 or 366 day year:
+ */
+const struct imdgrd_grid imdgrd_builtin_grids[] = {
+  /* 0.25 degree rainfall: */
+  {"rain_0.25", IMDGRD_RAIN, 6.5, 66.5, 0.25, 129, 135, -999, NULL, NULL},
+  /* 1 degree temperature: */
+  {"temp_1.0", IMDGRD_TEMP, 7.5, 67.5, 1.0, 31, 31, 99.9, NULL, NULL}
+};
+
+/* define struct for a slot in the grid lookup table: */
+struct imdgrd_grid_slot {
+  /* grd file size, or 0 if the slot is empty: */
+  int size;
+  /* number of days in a file of this size: */
+  int days;
+  /* grid: */
+  const struct imdgrd_grid *grid;
+};
+/* registered grids, and lookup table of grd file sizes: */
+static const struct imdgrd_grid *grids[IMDGRD_MAX_GRIDS];
+static int ngrids;
+static struct imdgrd_grid_slot grid_table[IMDGRD_GRID_TABLE_SIZE];
+/* the built in grids are registered once, on first use: */
+static pthread_once_t grids_once = PTHREAD_ONCE_INIT;
+
+/* scale factors and offsets for packing data in to shorts: */
+const float imdgrd_pack_scales[] = {
+  0.1,
+  0.01,
+  0.01,
+  0.01
+};
+const float imdgrd_pack_offsets[] = {
+  0,
+  0,
+  0,
+  0
+};
+/* fill value for packed data: */
+const short imdgrd_pack_fill = -32767;
+
+/* byte order names: */
+const char *imdgrd_endian_names[] = {
+  "auto",
+  "native",
+  "little",
+  "big"
+};
+
+/* range of physically possible values for each data type: */
+const float imdgrd_qc_mins[] = {
+  0,
+  -60,
+  -60,
+  -60
+};
+const float imdgrd_qc_maxs[] = {
+  2000,
+  60,
+  60,
+  60
+};
+
+/* chunk layout names: */
+const char *imdgrd_chunk_layouts[] = {
+  "default",
+  "map",
+  "timeseries",
+  "custom"
+};
+
+/* compression codec names: */
+const char *imdgrd_codec_names[] = {
+  "none",
+  "deflate",
+  "zstd",
+  "szip",
+  "blosc"
+};
+/* default compression levels for each codec: */
+const int imdgrd_codec_levels[] = {
+  0,
+  IMDGRD_NC_COMP,
+  3,
+  0,
+  5
+};
+
+/* output format names: */
+const char *imdgrd_format_names[] = {
+  "netcdf",
+  "zarr"
+};
+
+/* data variable layout names: */
+const char *imdgrd_layout_names[] = {
+  "day-major",
+  "time-major"
+};
+
+/* names of the statistics periods, as netcdf flag meanings: */
+const char *imdgrd_stats_periods = "january february march april may june "
+                                   "july august september october november "
+                                   "december jjas annual";
+/* statistic names, used as output variable name suffixes: */
+const char *imdgrd_stats_names[] = {
+  "sum",
+  "mean",
+  "max",
+  "min",
+  "rainy_days"
+};
+
+/* default struct values: */
+const struct imdgrd_input IMDGRD_DEFAULT_INPUT = {
+  "", -1, -1, -1, -1, -1, NULL, 0, 0
+};
+const struct imdgrd_output IMDGRD_DEFAULT_OUTPUT = {
+  "", "", ""
+};
+const struct imdgrd_ncoptions IMDGRD_DEFAULT_NCOPTIONS = {
+  IMDGRD_CHUNK_DEFAULT, {0, 0, 0}, IMDGRD_PRECISION_FLOAT, 0,
+  IMDGRD_CODEC_DEFLATE, IMDGRD_NC_COMP, 0, NULL, NULL, NULL,
+  IMDGRD_FORMAT_NETCDF, 0, IMDGRD_LAYOUT_DAY_MAJOR, NULL
+};
+
+/* error descriptions, indexed by error code: */
+static const char *error_strings[] = {
+  "No error",
+  "No input file specified",
+  "Input file does not exist",
+  "Invalid input file size",
+  "Temperature data detected, but can not detect whether it is min or max "
+  "data",
+  "Specified data type does not match detected data type",
+  "No year specified for the input data",
+  "Data file contains data for 366 days, but year is not a leap year",
+  "Data file contains data for 365 days, but year is a leap year",
+  "Unexpected data value size in input file",
+  "Unable to open input file",
+  "Unable to memory map input file",
+  "Error reading data from input file",
+  "Unable to allocate memory",
+  "NetCDF error",
+  "Unable to open grid file",
+  "Invalid grid definition",
+  "Subset does not contain any grid points",
+  "Invalid mask file",
+  "No values have been added to the statistics",
+  "Output file has no source information",
+  "Output file does not match the input file",
+  "Error writing Zarr output",
+  "Point or days are outside of the input file",
+  "NetCDF file has no data variable on a known grid",
+  "NetCDF file does not have a time axis of consecutive days",
+  "Values are not whole days on the grid being regridded",
+  "Error compressing Zarr output"
+};
+
+/* return the current time in seconds, from a monotonic clock: */
+static double get_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* return a description of an error code: */
+const char *imdgrd_strerror(int err) {
+  if ((err < IMDGRD_OK) ||
+      (err >= (int) (sizeof(error_strings) / sizeof(error_strings[0])))) {
+    return "Unknown error";
+  }
+  return error_strings[err];
+}
+
+/*
+ * get the slot in the grid lookup table for a grd file size. sizes are
+ * hashed in to the table, and collisions are resolved by probing the
+ * following slots. returns the slot containing the size, or the empty slot
+ * where it should be stored:
+ */
+static int grid_slot(int size) {
+  /* multiplicative hash of the size: */
+  uint32_t hash = (uint32_t) size * UINT32_C(2654435761);
+  int slot = (hash >> 16) & (IMDGRD_GRID_TABLE_SIZE - 1);
+  /* probe until the size or an empty slot is found: */
+  while ((grid_table[slot].size != 0) && (grid_table[slot].size != size)) {
+    slot = (slot + 1) & (IMDGRD_GRID_TABLE_SIZE - 1);
+  }
+  return slot;
+}
+
+/*
+ * register a grid, adding the file sizes for 365 and 366 day years to the
+ * lookup table. a grid with the same file sizes as an existing grid replaces
+ * it. a grid whose file size for one length of year is the size for the
+ * other length of year on an existing grid can not be told apart from it,
+ * and is rejected:
+ */
+static int register_grid(const struct imdgrd_grid *grid) {
+  /* file size: */
+  long size;
+  /* lookup table slot: */
+  int slot;
+  /* for loop integers: */
+  int days;
+  /* the lookup table is at most half full, so probing always ends: */
+  if (ngrids == IMDGRD_MAX_GRIDS) {
+    return IMDGRD_EGRID;
+  }
+  /* check both sizes before changing the table: */
+  for (days = 365; days <= 366; days++) {
+    /* values for each day, plus a single trailing byte: */
+    size = (long) grid->nlats * grid->nlons * sizeof(float) * days + 1;
+    slot = grid_slot(size);
+    if ((grid_table[slot].size == size) && (grid_table[slot].days != days)) {
+      return IMDGRD_EGRID;
+    }
+  }
+  for (days = 365; days <= 366; days++) {
+    size = (long) grid->nlats * grid->nlons * sizeof(float) * days + 1;
+    slot = grid_slot(size);
+    grid_table[slot].size = size;
+    grid_table[slot].days = days;
+    grid_table[slot].grid = grid;
+  }
+  grids[ngrids++] = grid;
+  return IMDGRD_OK;
+}
+
+/* register the built in grids: */
+static void register_builtin_grids(void) {
+  /* for loop integers: */
+  size_t i;
+  for (i = 0;
+       i < sizeof(imdgrd_builtin_grids) / sizeof(imdgrd_builtin_grids[0]);
+       i++) {
+    register_grid(&imdgrd_builtin_grids[i]);
+  }
+}
+
+/*
+ * add a grid to the registry. the grid is copied, and will be recognised
+ * from the size of a grd file, taking precedence over any existing grid
+ * with the same file sizes. returns IMDGRD_EGRID for a grid whose files
+ * could not be told apart from those of an existing grid with a different
+ * length of year. grids should be added before any files are converted:
+ */
+int imdgrd_add_grid(const struct imdgrd_grid *grid) {
+  /* copy of the grid: */
+  struct imdgrd_grid *copy;
+  /* return status: */
+  int status;
+  /* make sure the built in grids are registered first: */
+  pthread_once(&grids_once, register_builtin_grids);
+  /* check the grid: */
+  if ((grid->type < IMDGRD_RAIN) || (grid->type > IMDGRD_MAXTEMP) ||
+      (grid->nlats < 1) || (grid->nlons < 1) || (grid->grid <= 0) ||
+      ((long) grid->nlats * grid->nlons * sizeof(float) * 366 + 1 >
+       INT_MAX)) {
+    return IMDGRD_EGRID;
+  }
+  /* copy the grid: */
+  if ((copy = malloc(sizeof(struct imdgrd_grid))) == NULL) {
+    return IMDGRD_ENOMEM;
+  }
+  *copy = *grid;
+  copy->name = strdup((grid->name != NULL) ? grid->name : "");
+  copy->ncvar = (grid->ncvar != NULL) ? strdup(grid->ncvar) : NULL;
+  copy->ncunits = (grid->ncunits != NULL) ? strdup(grid->ncunits) : NULL;
+  /* register the grid: */
+  if ((status = register_grid(copy)) != IMDGRD_OK) {
+    free((char *) copy->name);
+    free((char *) copy->ncvar);
+    free((char *) copy->ncunits);
+    free(copy);
+  }
+  return status;
+}
+
+/*
+ * load grids from a file. each line of the file describes a grid as:
+ *   name type lat0 lon0 grid nlats nlons fill [ncvar [ncunits]]
+ * where type is one of the data types, e.g. 'rain'. anything after a '#' is
+ * ignored. if a line is invalid, the line number is stored in line, if not
+ * NULL:
+ */
+int imdgrd_load_grids(const char *filename, int *line) {
+  /* grid file: */
+  FILE *grid_file;
+  /* line from the grid file: */
+  char *buffer = NULL;
+  size_t buffer_size = 0;
+  /* fields from the line: */
+  char name[64], type[16], ncvar[64], ncunits[64];
+  int nfields;
+  /* grid: */
+  struct imdgrd_grid grid;
+  /* line number: */
+  int nline = 0;
+  /* return status: */
+  int status = IMDGRD_OK;
+  /* open the file: */
+  if ((grid_file = fopen(filename, "r")) == NULL) {
+    return IMDGRD_EGRIDFILE;
+  }
+  /* one grid per line: */
+  while (getline(&buffer, &buffer_size, grid_file) != -1) {
+    nline++;
+    /* remove comments: */
+    buffer[strcspn(buffer, "#")] = '\0';
+    nfields = sscanf(buffer, "%63s %15s %f %f %f %d %d %f %63s %63s", name,
+                     type, &grid.lat0, &grid.lon0, &grid.grid, &grid.nlats,
+                     &grid.nlons, &grid.fill, ncvar, ncunits);
+    /* skip blank lines: */
+    if (nfields <= 0) {
+      continue;
+    }
+    if (nfields < 8) {
+      status = IMDGRD_EGRID;
+      break;
+    }
+    /* get the data type: */
+    for (grid.type = IMDGRD_RAIN; grid.type <= IMDGRD_MAXTEMP; grid.type++) {
+      if (strcmp(type, imdgrd_data_types[grid.type]) == 0) {
+        break;
+      }
+    }
+    grid.name = name;
+    grid.ncvar = (nfields > 8) ? ncvar : NULL;
+    grid.ncunits = (nfields > 9) ? ncunits : NULL;
+    /* add the grid: */
+    if ((status = imdgrd_add_grid(&grid)) != IMDGRD_OK) {
+      break;
+    }
+  }
+  /* tidy up: */
+  free(buffer);
+  fclose(grid_file);
+  if (line != NULL) {
+    *line = nline;
+  }
+  return status;
+}
+
+/*
+ * find the grid for a grd file of the given size. the number of days in the
+ * file is stored in days. returns NULL if the size does not match any grid:
+ */
+const struct imdgrd_grid *imdgrd_find_grid(int size, int *days) {
+  /* lookup table slot: */
+  int slot;
+  /* make sure the built in grids are registered: */
+  pthread_once(&grids_once, register_builtin_grids);
+  /* look up the size: */
+  if (size <= 0) {
+    return NULL;
+  }
+  slot = grid_slot(size);
+  if (grid_table[slot].size == 0) {
+    return NULL;
+  }
+  *days = grid_table[slot].days;
+  return grid_table[slot].grid;
+}
+
+/*
+ * find a registered grid by name. a grid added later takes precedence over
+ * an earlier grid of the same name. returns NULL if there is no such grid:
+ */
+const struct imdgrd_grid *imdgrd_get_grid(const char *name) {
+  /* for loop integers: */
+  int i;
+  /* make sure the built in grids are registered: */
+  pthread_once(&grids_once, register_builtin_grids);
+  for (i = ngrids - 1; i >= 0; i--) {
+    if (strcmp(grids[i]->name, name) == 0) {
+      return grids[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * imdgrd_file_exists does a simple check to see if a file exists.
+ * if successful, returns file size, otherwise, returns -1.
+ */
+int imdgrd_file_exists(const char *filename) {
+  /* file handle: */
+  FILE *file;
+  /* file size: */
+  int size;
+  /* check input file exists: */
+  if ((file = fopen(filename, "r")) == NULL) {
+    return -1;
+  } else {
+    /* file exists ... get file size: */
+    fseek(file, 0L, SEEK_END);
+    size = ftell(file);
+    /* close the file: */
+    fclose(file);
+  }
+  /* return the file size: */
+  return size;
+}
+
+/*
+ * find the grid for a grd file holding only the first days of a year, such
+ * as a file for the current year which is still being added to. the number
+ * of days in the file is stored in days. returns NULL if the size does not
+ * match a whole number of days for exactly one grid:
+ */
+static const struct imdgrd_grid *find_partial_grid(int size, int *days) {
+  /* grid found: */
+  const struct imdgrd_grid *grid = NULL;
+  /* size of the values for a day: */
+  long day_size;
+  /* for loop integers: */
+  int i;
+  /* make sure the built in grids are registered: */
+  pthread_once(&grids_once, register_builtin_grids);
+  /* values for each day, plus a single trailing byte: */
+  for (i = 0; i < ngrids; i++) {
+    day_size = (long) grids[i]->nlats * grids[i]->nlons * sizeof(float);
+    if ((size > 1) && ((size - 1) % day_size == 0) &&
+        ((size - 1) / day_size <= 366)) {
+      if ((grid != NULL) && (grid != grids[i])) {
+        return NULL;
+      }
+      grid = grids[i];
+      *days = (size - 1) / day_size;
+    }
+  }
+  return grid;
+}
+
+/*
+ * get input information from the properties of a grd file. if partial is
+ * 1, files holding only the first days of a year are accepted:
+ */
+static int get_input(const char *filename, struct imdgrd_input *input,
+                     int partial) {
+  /* regular expression bits for matching year: */
+  regex_t regex;
+  const char *pattern;
+  regmatch_t match;
+  /* init year string: */
+  char yr_str[4 + 1];
+  /* reset the input information: */
+  *input = IMDGRD_DEFAULT_INPUT;
+  /* check input is specified: */
+  if ((filename == NULL) || (strcmp(filename, "") == 0)) {
+    return IMDGRD_ENOINPUT;
+  }
+  /* store filename: */
+  input->filename = filename;
+  /* check input file exists and get file size: */
+  if ((input->size = imdgrd_file_exists(filename)) == -1) {
+    return IMDGRD_ENOFILE;
+  }
+  /*
+   * from the file size, we can work out the grid and type of data, and the
+   * number of days in the year.
+   *
+   * e.g., for 0.25 degree rainfall data, for a 365 day year:
+   *   file size = 129 * 135 * 4 * 365 + 1 = 25425901
+   */
+  if (((input->grid = imdgrd_find_grid(input->size,
+                                       &input->days)) == NULL) &&
+      ((partial == 0) ||
+       ((input->grid = find_partial_grid(input->size,
+                                         &input->days)) == NULL))) {
+    /* invalid file size: */
+    return IMDGRD_ESIZE;
+  }
+  /*
+   * a file for the current year of a leap year has the size of a whole
+   * 365 day year on its 365th day, so partial files are always marked:
+   */
+  input->partial = partial;
+  input->type = input->grid->type;
+  /*
+   * if this is temperature data, try to guess whether min or max data
+   * from the file name:
+   */
+  if (input->type == IMDGRD_TEMP) {
+    /* regular expression to match for min: */
+    pattern = "min";
+    /* try to compile the regex: */
+    if (regcomp(&regex, pattern, REG_EXTENDED|REG_ICASE) == 0) {
+      /* see if anything matches: */
+      if (regexec(&regex, input->filename, 1, &match, 0) == 0) {
+        /* set the data type: */
+        input->type = IMDGRD_MINTEMP;
+      }
+      /* free the regex: */
+      regfree(&regex);
+    }
+    /* regular expression to match for max: */
+    pattern = "max";
+    /* try to compile the regex: */
+    if (regcomp(&regex, pattern, REG_EXTENDED|REG_ICASE) == 0) {
+      /* see if anything matches: */
+      if (regexec(&regex, input->filename, 1, &match, 0) == 0) {
+        /* set the data type: */
+        input->type = IMDGRD_MAXTEMP;
+      }
+      /* free the regex: */
+      regfree(&regex);
+    }
+  }
+  /* try to guess the year from the file name: */
+  input->year = -1;
+  /* regular expression to match: */
+  pattern = "[0-9]{4}";
+  /* try to compile the regex: */
+  if (regcomp(&regex, pattern, REG_EXTENDED) == 0) {
+    /* see if anything matches: */
+    if (regexec(&regex, input->filename, 1, &match, 0) == 0) {
+      /* get the match: */
+      memcpy(yr_str, input->filename + match.rm_so, 4);
+      yr_str[4] = '\0';
+      /* convert to int and store: */
+      input->year = atoi(yr_str);
+    }
+    /* free the regex: */
+    regfree(&regex);
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * get input information from the properties of a grd file, i.e. the data
+ * type and number of days from the file size, and if possible, whether
+ * temperature data is min or max, and the year, from the file name:
+ */
+int imdgrd_get_input(const char *filename, struct imdgrd_input *input) {
+  return get_input(filename, input, 0);
+}
+
+/*
+ * get input information, as imdgrd_get_input(), but also accepting a grd
+ * file holding only the first days of a year:
+ */
+int imdgrd_get_partial_input(const char *filename,
+                             struct imdgrd_input *input) {
+  return get_input(filename, input, 1);
+}
+
+/*
+ * return the number of days in a year of the gregorian calendar, in which
+ * years divisible by 4 are leap years, apart from those divisible by 100
+ * but not by 400:
+ */
+int imdgrd_year_days(int year) {
+  return ((year % 4 == 0) && ((year % 100 != 0) || (year % 400 == 0))) ?
+         366 : 365;
+}
+
+/*
+ * check a requested data type and year (-1 if not known) against the input
+ * file information, to make sure everything makes sense. the checked
+ * information is stored in input_out, including the type and year which
+ * were checked if an error is returned:
+ */
+int imdgrd_check_input(struct imdgrd_input *input_in, int type, int year,
+                       struct imdgrd_input *input_out) {
+  /* start from the input file information: */
+  *input_out = *input_in;
+  /*
+   * the requested type and year might disagree with the information
+   * obtained by inspecting the input file, it's worth double checking some
+   * things. If a data type is requested, use that:
+   */
+  if (type != -1) {
+    input_out->type = type;
+  }
+  /*
+   * if type is 1, we know it is temperature data, but not whether it is
+   * min or max temperature:
+   */
+  if (input_out->type == IMDGRD_TEMP) {
+    return IMDGRD_ETEMP;
+  }
+  /* check if the requested type matches the detected data type: */
+  if ((input_out->type == IMDGRD_RAIN && input_in->type != IMDGRD_RAIN) ||
+      (input_out->type == IMDGRD_MINTEMP && input_in->type < IMDGRD_TEMP) ||
+      (input_out->type == IMDGRD_MAXTEMP && input_in->type < IMDGRD_TEMP)) {
+    return IMDGRD_ETYPE;
+  }
+  /* If a year is requested, use that: */
+  if (year != -1) {
+    input_out->year = year;
+    input_out->year_match = 0;
+  } else {
+    /* otherwise, use value from file inspection: */
+    input_out->year_match = 1;
+  }
+  /* if we don't have a valid year, give up: */
+  if (input_out->year == -1) {
+    return IMDGRD_ENOYEAR;
+  }
+  /*
+   * a partial file may hold any number of days up to the whole year, and
+   * 365 days may be all but the last day of a leap year:
+   */
+  if (input_in->partial == 1) {
+    return (input_in->days > imdgrd_year_days(input_out->year)) ?
+           IMDGRD_ELEAP : IMDGRD_OK;
+  }
+  /*
+   * If the data file contains data for 366 days, then the year should be
+   *  a leap year:
+   */
+  if ((input_in->days == 366) && (imdgrd_year_days(input_out->year) != 366)) {
+    return IMDGRD_ELEAP;
+  }
+  /*
+   * If the data file contains data for 365 days, then the year should not be
+   *  a leap year:
+   */
+  if ((input_in->days == 365) && (imdgrd_year_days(input_out->year) == 366)) {
+    return IMDGRD_ENOTLEAP;
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * reverse the byte order of float values. values and swapped may be the
+ * same array. written without branches, so that the compiler can vectorise
+ * the loop:
+ */
+SIMD_CLONES
+void imdgrd_swap_values(const float *values, float *swapped, size_t count) {
+  /* bit representation of value: */
+  uint32_t bits;
+  /* for loop integers: */
+  size_t i;
+  /* loop through values: */
+#pragma omp simd
+  for (i = 0; i < count; i++) {
+    memcpy(&bits, &values[i], sizeof(bits));
+    bits = (bits >> 24) | ((bits >> 8) & UINT32_C(0xff00)) |
+           ((bits << 8) & UINT32_C(0xff0000)) | (bits << 24);
+    memcpy(&swapped[i], &bits, sizeof(bits));
+  }
+}
+
+/* return 1 if the host is big endian: */
+int imdgrd_host_big_endian(void) {
+  /* an int with only the lowest byte set: */
+  const uint32_t one = 1;
+  /* first byte of the int: */
+  unsigned char first;
+  memcpy(&first, &one, 1);
+  return first == 0;
+}
+
+/*
+ * count values which are plausible for the data type, i.e. fill values,
+ * zero, or values in the range of possible values which are not tiny:
+ */
+static size_t count_plausible(const float *values, size_t count,
+                              float fill, float min, float max) {
+  /* number of plausible values: */
+  size_t plausible = 0;
+  /* for loop integers: */
+  size_t i;
+  /* loop through values: */
+#pragma omp simd reduction(+:plausible)
+  for (i = 0; i < count; i++) {
+    plausible += (values[i] == fill) || (values[i] == 0) ||
+                 ((values[i] >= min) && (values[i] <= max) &&
+                  (fabsf(values[i]) >= (float) IMDGRD_ENDIAN_MIN_MAGNITUDE));
+  }
+  return plausible;
+}
+
+/*
+ * set whether the values in an input file need byte swapping, for the
+ * requested byte order. with IMDGRD_ENDIAN_AUTO, the first days of the file
+ * are read, and the values are swapped if more of them are plausible for the
+ * data type when swapped:
+ */
+int imdgrd_set_byte_order(struct imdgrd_input *input, int endian) {
+  /* input file: */
+  FILE *input_file;
+  /* values from the first days: */
+  float *values;
+  /* number of values to check, and numbers of plausible values: */
+  size_t count;
+  size_t native, swapped;
+  /* known byte orders: */
+  switch (endian) {
+    case IMDGRD_ENDIAN_NATIVE:
+      input->swap = 0;
+      return IMDGRD_OK;
+    case IMDGRD_ENDIAN_LITTLE:
+      input->swap = imdgrd_host_big_endian();
+      return IMDGRD_OK;
+    case IMDGRD_ENDIAN_BIG:
+      input->swap = !imdgrd_host_big_endian();
+      return IMDGRD_OK;
+    default:
+      break;
+  }
+  /* read the first days: */
+  count = (size_t) ((input->days < IMDGRD_ENDIAN_CHECK_DAYS) ? input->days :
+                    IMDGRD_ENDIAN_CHECK_DAYS) *
+          input->grid->nlats * input->grid->nlons;
+  if ((values = malloc(count * sizeof(float))) == NULL) {
+    return IMDGRD_ENOMEM;
+  }
+  if ((input_file = fopen(input->filename, "rb")) == NULL) {
+    free(values);
+    return IMDGRD_EOPEN;
+  }
+  if (fread(values, sizeof(float), count, input_file) != count) {
+    fclose(input_file);
+    free(values);
+    return IMDGRD_EREAD;
+  }
+  fclose(input_file);
+  /* count plausible values, as they are and swapped: */
+  native = count_plausible(values, count, input->grid->fill,
+                           imdgrd_qc_mins[input->type],
+                           imdgrd_qc_maxs[input->type]);
+  imdgrd_swap_values(values, values, count);
+  swapped = count_plausible(values, count, input->grid->fill,
+                            imdgrd_qc_mins[input->type],
+                            imdgrd_qc_maxs[input->type]);
+  free(values);
+  input->swap = (swapped > native) ? 1 : 0;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/* xxh64 primes: */
+#define XXH_PRIME1 UINT64_C(11400714785074694791)
+#define XXH_PRIME2 UINT64_C(14029467366897019727)
+#define XXH_PRIME3 UINT64_C(1609587929392839161)
+#define XXH_PRIME4 UINT64_C(9650029242287828579)
+#define XXH_PRIME5 UINT64_C(2870177450012600261)
+
+/*
+ * define struct for the state of an xxh64 hash, which is updated with
+ * blocks of bytes. bytes which do not fill a 32 byte stripe are kept until
+ * the next update:
+ */
+struct imdgrd_hash_state {
+  /* accumulators: */
+  uint64_t acc[4];
+  /* total number of bytes hashed: */
+  uint64_t length;
+  /* bytes waiting for a full stripe, and number of bytes waiting: */
+  unsigned char stripe[32];
+  size_t nstripe;
+};
+
+/* rotate a 64 bit value left: */
+static uint64_t rotl64(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+/* read little endian 64 and 32 bit values from bytes: */
+static uint64_t read_le64(const unsigned char *bytes) {
+  return (uint64_t) bytes[0] | ((uint64_t) bytes[1] << 8) |
+         ((uint64_t) bytes[2] << 16) | ((uint64_t) bytes[3] << 24) |
+         ((uint64_t) bytes[4] << 32) | ((uint64_t) bytes[5] << 40) |
+         ((uint64_t) bytes[6] << 48) | ((uint64_t) bytes[7] << 56);
+}
+static uint64_t read_le32(const unsigned char *bytes) {
+  return (uint64_t) bytes[0] | ((uint64_t) bytes[1] << 8) |
+         ((uint64_t) bytes[2] << 16) | ((uint64_t) bytes[3] << 24);
+}
+
+/* mix 8 bytes of input in to an accumulator: */
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+  acc += input * XXH_PRIME2;
+  return rotl64(acc, 31) * XXH_PRIME1;
+}
+
+/* start an xxh64 hash, with a seed of 0: */
+static void hash_init(struct imdgrd_hash_state *state) {
+  state->acc[0] = XXH_PRIME1 + XXH_PRIME2;
+  state->acc[1] = XXH_PRIME2;
+  state->acc[2] = 0;
+  state->acc[3] = -XXH_PRIME1;
+  state->length = 0;
+  state->nstripe = 0;
+}
+
+/* hash 32 byte stripes: */
+static void hash_stripes(struct imdgrd_hash_state *state,
+                         const unsigned char *bytes, size_t nstripes) {
+  /* accumulators: */
+  uint64_t acc0 = state->acc[0], acc1 = state->acc[1];
+  uint64_t acc2 = state->acc[2], acc3 = state->acc[3];
+  /* for loop integers: */
+  size_t i;
+  for (i = 0; i < nstripes; i++, bytes += 32) {
+    acc0 = hash_round(acc0, read_le64(bytes));
+    acc1 = hash_round(acc1, read_le64(bytes + 8));
+    acc2 = hash_round(acc2, read_le64(bytes + 16));
+    acc3 = hash_round(acc3, read_le64(bytes + 24));
+  }
+  state->acc[0] = acc0;
+  state->acc[1] = acc1;
+  state->acc[2] = acc2;
+  state->acc[3] = acc3;
+}
+
+/* add bytes to an xxh64 hash: */
+static void hash_update(struct imdgrd_hash_state *state,
+                        const unsigned char *bytes, size_t length) {
+  /* number of bytes used: */
+  size_t n;
+  state->length += length;
+  /* complete a waiting stripe: */
+  if (state->nstripe > 0) {
+    n = 32 - state->nstripe;
+    n = (length < n) ? length : n;
+    memcpy(state->stripe + state->nstripe, bytes, n);
+    state->nstripe += n;
+    bytes += n;
+    length -= n;
+    if (state->nstripe < 32) {
+      return;
+    }
+    hash_stripes(state, state->stripe, 1);
+    state->nstripe = 0;
+  }
+  /* hash whole stripes, and keep the rest: */
+  hash_stripes(state, bytes, length / 32);
+  n = length % 32;
+  memcpy(state->stripe, bytes + length - n, n);
+  state->nstripe = n;
+}
+
+/* return the xxh64 hash of the bytes added so far: */
+static uint64_t hash_digest(const struct imdgrd_hash_state *state) {
+  /* hash value: */
+  uint64_t hash;
+  /* remaining bytes: */
+  const unsigned char *bytes = state->stripe;
+  size_t length = state->nstripe;
+  /* for loop integers: */
+  int i;
+  /* merge the accumulators: */
+  if (state->length >= 32) {
+    hash = rotl64(state->acc[0], 1) + rotl64(state->acc[1], 7) +
+           rotl64(state->acc[2], 12) + rotl64(state->acc[3], 18);
+    for (i = 0; i < 4; i++) {
+      hash ^= hash_round(0, state->acc[i]);
+      hash = hash * XXH_PRIME1 + XXH_PRIME4;
+    }
+  } else {
+    hash = XXH_PRIME5;
+  }
+  hash += state->length;
+  /* mix in the remaining bytes: */
+  for (; length >= 8; length -= 8, bytes += 8) {
+    hash ^= hash_round(0, read_le64(bytes));
+    hash = rotl64(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+  }
+  if (length >= 4) {
+    hash ^= read_le32(bytes) * XXH_PRIME1;
+    hash = rotl64(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+    length -= 4;
+    bytes += 4;
+  }
+  for (; length > 0; length--, bytes++) {
+    hash ^= *bytes * XXH_PRIME5;
+    hash = rotl64(hash, 11) * XXH_PRIME1;
+  }
+  /* final mixing: */
+  hash ^= hash >> 33;
+  hash *= XXH_PRIME2;
+  hash ^= hash >> 29;
+  hash *= XXH_PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/*
+ * calculate the xxh64 hash of the first length bytes of a file, reading
+ * IMDGRD_HASH_BLOCK_SIZE bytes at a time. if prefix_hash is not NULL, the hash
+ * of the first prefix bytes is also stored there, from the same pass through
+ * the file:
+ */
+int imdgrd_hash_file(const char *filename, size_t length, size_t prefix,
+                     uint64_t *hash, uint64_t *prefix_hash) {
+  /* file: */
+  FILE *file;
+  /* hash state: */
+  struct imdgrd_hash_state state;
+  /* block of bytes from the file: */
+  unsigned char *block;
+  /* number of bytes hashed, and to read next: */
+  size_t done = 0, n;
+  /* return status: */
+  int status = IMDGRD_OK;
+  if ((block = malloc(IMDGRD_HASH_BLOCK_SIZE)) == NULL) {
+    return IMDGRD_ENOMEM;
+  }
+  if ((file = fopen(filename, "rb")) == NULL) {
+    free(block);
+    return IMDGRD_EOPEN;
+  }
+  hash_init(&state);
+  if ((prefix_hash != NULL) && (prefix == 0)) {
+    *prefix_hash = hash_digest(&state);
+  }
+  while (done < length) {
+    /* blocks stop at the end of the prefix: */
+    n = length - done;
+    n = (n < IMDGRD_HASH_BLOCK_SIZE) ? n : IMDGRD_HASH_BLOCK_SIZE;
+    if ((prefix_hash != NULL) && (done < prefix) && (done + n > prefix)) {
+      n = prefix - done;
+    }
+    if (fread(block, 1, n, file) != n) {
+      status = IMDGRD_EREAD;
+      break;
+    }
+    hash_update(&state, block, n);
+    done += n;
+    if ((prefix_hash != NULL) && (done == prefix)) {
+      *prefix_hash = hash_digest(&state);
+    }
+  }
+  *hash = hash_digest(&state);
+  fclose(file);
+  free(block);
+  /* return: */
+  return status;
+}
+
+/*
+ * get the size and modification time of a grd file, and the number of days
+ * it holds, without hashing the values:
+ */
+int imdgrd_stat_source(struct imdgrd_input *input,
+                       struct imdgrd_source *source) {
+  /* file information: */
+  struct stat file_stat;
+  if (stat(input->filename, &file_stat) != 0) {
+    return IMDGRD_ENOFILE;
+  }
+  source->size = file_stat.st_size;
+  source->mtime = file_stat.st_mtime;
+  source->days = input->days;
+  source->hash = 0;
+  return IMDGRD_OK;
+}
+
+/*
+ * hash the values for all days of a grd file, not including the trailing
+ * byte, so that a file which has grown by whole days starts with the same
+ * bytes. if prefix_hash is not NULL, the hash of the values for the first
+ * prefix_days days is also stored there:
+ */
+int imdgrd_hash_source(struct imdgrd_input *input,
+                       struct imdgrd_source *source, int prefix_days,
+                       uint64_t *prefix_hash) {
+  /* size of the values for a day: */
+  size_t day_size = (size_t) input->grid->nlats * input->grid->nlons *
+                    sizeof(float);
+  return imdgrd_hash_file(input->filename, day_size * input->days,
+                          day_size * prefix_days, &source->hash,
+                          prefix_hash);
+}
+
+/*
+ * read a block of whole days from an open grd file in to a buffer, using a
+ * single fread() call. values are stored in the file as consecutive days of
+ * nlats * nlons values. returns the number of values which were read:
+ */
+static size_t read_days(FILE *input_file, float *buffer, int ndays,
+                        struct imdgrd_data *data) {
+  /* number of values to read: */
+  size_t count = (size_t) ndays * data->nlats * data->nlons;
+  /* read the values: */
+  return fread(buffer, data->datasize, count, input_file);
+}
+
+/*
+ * memory map a grd file, read only. returns a pointer to the start of the
+ * mapping, or NULL on failure. the size of the mapping is stored in
+ * map_size:
+ */
+static void *map_file(const char *filename, size_t *map_size) {
+  /* file descriptor: */
+  int fd;
+  /* file size: */
+  off_t size;
+  /* mapped file: */
+  void *map;
+  /* open the file: */
+  if ((fd = open(filename, O_RDONLY)) == -1) {
+    return NULL;
+  }
+  /* get the file size: */
+  if ((size = lseek(fd, 0, SEEK_END)) <= 0) {
+    close(fd);
+    return NULL;
+  }
+  /* map the file: */
+  map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  /* the mapping stays valid after the file is closed: */
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+  /* data will be read front to back: */
+  madvise(map, size, MADV_SEQUENTIAL);
+  /* store the size and return the mapping: */
+  *map_size = size;
+  return map;
+}
+
+/*
+ * return the index of a coordinate value in a row or column of grid points
+ * starting at start, or -1 if the value is not one of the grid points:
+ */
+static int grid_index(float value, float start, float grid, int count) {
+  /* nearest grid point: */
+  long index = lround((value - start) / grid);
+  if ((index < 0) || (index >= count) ||
+      (fabsf(value - (start + index * grid)) >
+       grid * IMDGRD_SUBSET_TOLERANCE)) {
+    return -1;
+  }
+  return index;
+}
+
+/* free memory held by a data struct: */
+void imdgrd_free_data(struct imdgrd_data *data) {
+  free(data->lats);
+  free(data->lons);
+  free(data->days);
+  free(data->mask);
+  data->lats = NULL;
+  data->lons = NULL;
+  data->days = NULL;
+  data->mask = NULL;
+  /*
+   * data either points in to a mapped file, has been allocated, or has been
+   * supplied by the caller:
+   */
+  if (data->map != NULL) {
+    munmap(data->map, data->map_size);
+  } else if (data->data_alloc == 1) {
+    free(data->data);
+  }
+  data->data = NULL;
+  data->data_alloc = 0;
+  data->map = NULL;
+  data->map_size = 0;
+}
+
+/*
+ * set up a data struct for the input file, with grid information and
+ * coordinate values, but without any data values:
+ */
+int imdgrd_init_data(struct imdgrd_input *input, struct imdgrd_data *data) {
+  /* for loop integers: */
+  int i;
+  /* set up the data struct from the grid: */
+  data->grid = input->grid->grid;
+  data->nlats = input->grid->nlats;
+  data->nlons = input->grid->nlons;
+  data->lat0 = input->grid->lat0;
+  data->lon0 = input->grid->lon0;
+  data->fill = input->grid->fill;
+  data->datasize = input->size / (input->days * data->nlats * data->nlons);
+  data->type = input->type;
+  data->year = input->year;
+  data->ndays = input->days;
+  data->lats = calloc(data->nlats, sizeof(float));
+  data->lons = calloc(data->nlons, sizeof(float));
+  data->days = calloc(data->ndays, sizeof(float));
+  data->data = NULL;
+  data->data_alloc = 0;
+  data->map = NULL;
+  data->map_size = 0;
+  /* the data covers the whole grid, until a subset is selected: */
+  data->grid_nlats = data->nlats;
+  data->grid_nlons = data->nlons;
+  data->lat_start = 0;
+  data->lon_start = 0;
+  data->mask = NULL;
+  if ((data->lats == NULL) || (data->lons == NULL) || (data->days == NULL)) {
+    imdgrd_free_data(data);
+    return IMDGRD_ENOMEM;
+  }
+  /* store the lat and lon values: */
+  for (i = 0; i < data->nlats; i++) {
+    /* store the lat value: */
+    data->lats[i] = data->lat0 + (i * data->grid);
+  }
+  for (i = 0; i < data->nlons; i++) {
+    /* store the lon value: */
+    data->lons[i] = data->lon0 + (i * data->grid);
+  }
+  /* store the day values: */
+  for (i = 0; i < data->ndays; i++) {
+    data->days[i] = i;
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/* return the number of values for all days in a data struct: */
+size_t imdgrd_data_count(struct imdgrd_data *data) {
+  return (size_t) data->ndays * data->nlats * data->nlons;
+}
+
+/*
+ * check if a data struct covers a subset of the grid, or has a mask, so
+ * that values have to be gathered from the input file rather than read
+ * straight in to the data array:
+ */
+static int is_subset(struct imdgrd_data *data) {
+  return (data->nlats != data->grid_nlats) ||
+         (data->nlons != data->grid_nlons) || (data->mask != NULL);
+}
+
+/*
+ * reduce the data to the lats i0 to i1 and lons j0 to j1 (inclusive) of the
+ * current data, updating the coordinate values and mask:
+ */
+static void crop_data(struct imdgrd_data *data, int i0, int i1, int j0,
+                      int j1) {
+  /* new number of lats and lons: */
+  int nlats = i1 - i0 + 1;
+  int nlons = j1 - j0 + 1;
+  /* for loop integers: */
+  int i;
+  /* crop the mask, row by row. rows only move towards the start: */
+  if (data->mask != NULL) {
+    for (i = 0; i < nlats; i++) {
+      memmove(data->mask + (size_t) i * nlons,
+              data->mask + (size_t) (i0 + i) * data->nlons + j0, nlons);
+    }
+  }
+  /* crop the coordinate values: */
+  memmove(data->lats, data->lats + i0, nlats * sizeof(float));
+  memmove(data->lons, data->lons + j0, nlons * sizeof(float));
+  /* update the grid information: */
+  data->lat0 = data->lats[0];
+  data->lon0 = data->lons[0];
+  data->lat_start += i0;
+  data->lon_start += j0;
+  data->nlats = nlats;
+  data->nlons = nlons;
+}
+
+/*
+ * reduce a data struct set up with imdgrd_init_data() to the grid points
+ * within a bounding box. only these points will be read and written. if a
+ * subset has already been selected, the bounding box is applied within it:
+ */
+int imdgrd_set_bbox(struct imdgrd_data *data, float lat0, float lat1,
+                    float lon0, float lon1) {
+  /* tolerance for points on the edge of the box: */
+  float tolerance = data->grid * IMDGRD_SUBSET_TOLERANCE;
+  /* range of lats and lons within the box: */
+  int i0 = -1, i1 = -1, j0 = -1, j1 = -1;
+  /* for swapping values: */
+  float swap;
+  /* for loop integers: */
+  int i;
+  /* allow the box corners in either order: */
+  if (lat0 > lat1) {
+    swap = lat0;
+    lat0 = lat1;
+    lat1 = swap;
+  }
+  if (lon0 > lon1) {
+    swap = lon0;
+    lon0 = lon1;
+    lon1 = swap;
+  }
+  /* find the lats and lons within the box: */
+  for (i = 0; i < data->nlats; i++) {
+    if ((data->lats[i] >= lat0 - tolerance) &&
+        (data->lats[i] <= lat1 + tolerance)) {
+      i0 = (i0 == -1) ? i : i0;
+      i1 = i;
+    }
+  }
+  for (i = 0; i < data->nlons; i++) {
+    if ((data->lons[i] >= lon0 - tolerance) &&
+        (data->lons[i] <= lon1 + tolerance)) {
+      j0 = (j0 == -1) ? i : j0;
+      j1 = i;
+    }
+  }
+  if ((i0 == -1) || (j0 == -1)) {
+    return IMDGRD_ESUBSET;
+  }
+  /* reduce the data: */
+  crop_data(data, i0, i1, j0, j1);
+  return IMDGRD_OK;
+}
+
+/*
+ * read a netcdf mask file, and reduce a data struct set up with
+ * imdgrd_init_data() to the smallest box containing the masked grid points.
+ * values for grid points in the box which are not masked are set to the
+ * fill value. the mask is the variable 'mask', or the first two dimensional
+ * variable, with dimensions of latitude and longitude and coordinate
+ * variables of the same names. any value other than 0 or the fill value
+ * selects a grid point:
+ */
+int imdgrd_load_mask(struct imdgrd_data *data, const char *filename) {
+  /* netcdf ids: */
+  int ncid, varid, nvars, ndims, dim_ids[2], lat_var, lon_var;
+  /* dimension names and lengths: */
+  char lat_name[NC_MAX_NAME + 1], lon_name[NC_MAX_NAME + 1];
+  size_t mask_nlats, mask_nlons;
+  /* mask coordinates and values, and mask fill value: */
+  float *mask_lats = NULL, *mask_lons = NULL, *mask_values = NULL;
+  float mask_fill;
+  int has_fill;
+  /* grid indexes of the mask coordinates: */
+  int *lat_index = NULL, *lon_index = NULL;
+  /* range of masked lats and lons: */
+  int i0 = -1, i1 = -1, j0 = -1, j1 = -1;
+  /* return status: */
+  int status = IMDGRD_OK;
+  /* for loop integers: */
+  size_t i, j;
+  /* open the mask file: */
+  if (nc_open(filename, NC_NOWRITE, &ncid) != NC_NOERR) {
+    return IMDGRD_EMASK;
+  }
+  /* find the mask variable: */
+  if (nc_inq_varid(ncid, IMDGRD_MASK_VAR, &varid) != NC_NOERR) {
+    varid = -1;
+    if (nc_inq_nvars(ncid, &nvars) == NC_NOERR) {
+      for (i = 0; i < (size_t) nvars; i++) {
+        if ((nc_inq_varndims(ncid, i, &ndims) == NC_NOERR) &&
+            (ndims == 2)) {
+          varid = i;
+          break;
+        }
+      }
+    }
+  }
+  /* get the dimensions, and coordinate variables: */
+  if ((varid == -1) ||
+      (nc_inq_varndims(ncid, varid, &ndims) != NC_NOERR) || (ndims != 2) ||
+      (nc_inq_vardimid(ncid, varid, dim_ids) != NC_NOERR) ||
+      (nc_inq_dimname(ncid, dim_ids[0], lat_name) != NC_NOERR) ||
+      (nc_inq_dimname(ncid, dim_ids[1], lon_name) != NC_NOERR) ||
+      (nc_inq_dimlen(ncid, dim_ids[0], &mask_nlats) != NC_NOERR) ||
+      (nc_inq_dimlen(ncid, dim_ids[1], &mask_nlons) != NC_NOERR) ||
+      (nc_inq_varid(ncid, lat_name, &lat_var) != NC_NOERR) ||
+      (nc_inq_varid(ncid, lon_name, &lon_var) != NC_NOERR)) {
+    nc_close(ncid);
+    return IMDGRD_EMASK;
+  }
+  /* read the mask: */
+  mask_lats = malloc(mask_nlats * sizeof(float));
+  mask_lons = malloc(mask_nlons * sizeof(float));
+  mask_values = malloc(mask_nlats * mask_nlons * sizeof(float));
+  lat_index = malloc(mask_nlats * sizeof(int));
+  lon_index = malloc(mask_nlons * sizeof(int));
+  data->mask = calloc((size_t) data->nlats * data->nlons,
+                      sizeof(unsigned char));
+  if ((mask_lats == NULL) || (mask_lons == NULL) || (mask_values == NULL) ||
+      (lat_index == NULL) || (lon_index == NULL) || (data->mask == NULL)) {
+    status = IMDGRD_ENOMEM;
+  } else if ((nc_get_var_float(ncid, lat_var, mask_lats) != NC_NOERR) ||
+             (nc_get_var_float(ncid, lon_var, mask_lons) != NC_NOERR) ||
+             (nc_get_var_float(ncid, varid, mask_values) != NC_NOERR)) {
+    status = IMDGRD_EMASK;
+  }
+  has_fill = (nc_get_att_float(ncid, varid, IMDGRD_NC_FILLV, &mask_fill) ==
+              NC_NOERR);
+  nc_close(ncid);
+  if (status == IMDGRD_OK) {
+    /* match the mask coordinates to grid points, or -1: */
+    for (i = 0; i < mask_nlats; i++) {
+      lat_index[i] = grid_index(mask_lats[i], data->lat0, data->grid,
+                                data->nlats);
+    }
+    for (j = 0; j < mask_nlons; j++) {
+      lon_index[j] = grid_index(mask_lons[j], data->lon0, data->grid,
+                                data->nlons);
+    }
+    /* set the mask, and find the range of masked lats and lons: */
+    for (i = 0; i < mask_nlats; i++) {
+      for (j = 0; j < mask_nlons; j++) {
+        if ((lat_index[i] == -1) || (lon_index[j] == -1) ||
+            (mask_values[i * mask_nlons + j] == 0) ||
+            (mask_values[i * mask_nlons + j] !=
+             mask_values[i * mask_nlons + j]) ||
+            (has_fill && (mask_values[i * mask_nlons + j] == mask_fill))) {
+          continue;
+        }
+        data->mask[(size_t) lat_index[i] * data->nlons + lon_index[j]] = 1;
+        i0 = ((i0 == -1) || (lat_index[i] < i0)) ? lat_index[i] : i0;
+        i1 = (lat_index[i] > i1) ? lat_index[i] : i1;
+        j0 = ((j0 == -1) || (lon_index[j] < j0)) ? lon_index[j] : j0;
+        j1 = (lon_index[j] > j1) ? lon_index[j] : j1;
+      }
+    }
+    if (i0 == -1) {
+      status = IMDGRD_ESUBSET;
+    }
+  }
+  /* reduce the data to the masked grid points: */
+  if (status == IMDGRD_OK) {
+    crop_data(data, i0, i1, j0, j1);
+  } else {
+    free(data->mask);
+    data->mask = NULL;
+  }
+  /* tidy up: */
+  free(mask_lats);
+  free(mask_lons);
+  free(mask_values);
+  free(lat_index);
+  free(lon_index);
+  return status;
+}
+
+/*
+ * copy the values for a data subset from the rows of a single day of the
+ * grid, starting at the first lat of the subset, and set values which are
+ * not masked to the fill value:
+ */
+static void subset_day(struct imdgrd_data *data, const float *rows,
+                       float *values) {
+  /* number of values: */
+  size_t count = (size_t) data->nlats * data->nlons;
+  /* for loop integers: */
+  size_t i;
+  /* copy the lons of the subset from each row: */
+  for (i = 0; i < (size_t) data->nlats; i++) {
+    memcpy(values + i * data->nlons,
+           rows + i * data->grid_nlons + data->lon_start,
+           data->nlons * sizeof(float));
+  }
+  /* apply the mask: */
+  if (data->mask != NULL) {
+#pragma omp simd
+    for (i = 0; i < count; i++) {
+      values[i] = (data->mask[i] != 0) ? values[i] : data->fill;
+    }
+  }
+}
+
+/*
+ * read the values of a data subset for a single day. only the rows of the
+ * grid containing the subset are read, from the mapping or by seeking in the
+ * file:
+ */
+static int read_subset_day(struct imdgrd_reader *reader, int day,
+                           float *values) {
+  /* the data struct: */
+  struct imdgrd_data *data = reader->data;
+  /* number of values in the rows containing the subset: */
+  size_t row_count = (size_t) data->nlats * data->grid_nlons;
+  /* byte offset of the first row in the file: */
+  off_t offset = ((off_t) day * data->grid_nlats + data->lat_start) *
+                 data->grid_nlons * sizeof(float);
+  /* rows containing the subset: */
+  const float *rows;
+  /*
+   * point in to the mapping, or read the rows. rows which need byte
+   * swapping are swapped in to the rows buffer:
+   */
+  if (reader->map != NULL) {
+    if (offset + row_count * sizeof(float) > reader->map_size) {
+      return IMDGRD_EREAD;
+    }
+    rows = (const float *) ((char *) reader->map + offset);
+    if (reader->swap == 1) {
+      imdgrd_swap_values(rows, reader->rows, row_count);
+      rows = reader->rows;
+    }
+  } else {
+    if ((fseeko(reader->file, offset, SEEK_SET) != 0) ||
+        (fread(reader->rows, sizeof(float), row_count, reader->file) !=
+         row_count)) {
+      return IMDGRD_EREAD;
+    }
+    if (reader->swap == 1) {
+      imdgrd_swap_values(reader->rows, reader->rows, row_count);
+    }
+    rows = reader->rows;
+  }
+  /* copy the subset: */
+  subset_day(data, rows, values);
+  return IMDGRD_OK;
+}
+
+/*
+ * read all data values from a grd file in to a data struct set up with
+ * imdgrd_init_data(). values are read in to buffer, which should hold
+ * imdgrd_data_count() values, or if buffer is NULL, in to an array allocated
+ * by the library. the number of values read is stored in nread, if not NULL:
+ */
+int imdgrd_read_data(struct imdgrd_input *input, struct imdgrd_data *data,
+                     float *buffer, size_t *nread) {
+  /* input file: */
+  FILE *input_file;
+  /* reader, for a subset of the grid: */
+  struct imdgrd_reader reader;
+  /* number of values expected and return value of fread: */
+  size_t data_count = imdgrd_data_count(data);
+  size_t fread_size = 0;
+  /* return status: */
+  int status = IMDGRD_OK;
+  /* for loop integers: */
+  int i;
+  if (nread != NULL) {
+    *nread = 0;
+  }
+  /*
+   * values are read straight in to the data array, so the size of a value
+   * in the file has to match the size of a float:
+   */
+  if (data->datasize != sizeof(float)) {
+    return IMDGRD_EVALUE;
+  }
+  /* use the supplied buffer, or allocate the data array: */
+  if (buffer == NULL) {
+    if ((buffer = calloc(data_count, sizeof(float))) == NULL) {
+      return IMDGRD_ENOMEM;
+    }
+    data->data_alloc = 1;
+  }
+  data->data = buffer;
+  /* for a subset, read the subset one day at a time: */
+  if (is_subset(data)) {
+    if ((status = imdgrd_open_reader(input, data, &reader,
+                                     0)) == IMDGRD_OK) {
+      for (i = 0; i < data->ndays; i++) {
+        if ((status = imdgrd_read_day_into(&reader, i, data->data +
+                                           i * reader.day_count)) !=
+            IMDGRD_OK) {
+          break;
+        }
+        fread_size += reader.day_count;
+      }
+    }
+    imdgrd_close_reader(&reader);
+  } else {
+    /* open the input file: */
+    if ((input_file = fopen(input->filename, "rb")) == NULL) {
+      return IMDGRD_EOPEN;
+    }
+    /* read all days in one go: */
+    fread_size = read_days(input_file, data->data, data->ndays, data);
+    /* close the input file: */
+    fclose(input_file);
+    /* swap the byte order, if required: */
+    if (input->swap == 1) {
+      imdgrd_swap_values(data->data, data->data, fread_size);
+    }
+    /* check the read size equals the count size: */
+    status = (fread_size == data_count) ? IMDGRD_OK : IMDGRD_EREAD;
+  }
+  if (nread != NULL) {
+    *nread = fread_size;
+  }
+  /* return: */
+  return status;
+}
+
+/*
+ * memory map a grd file, and point the data values of a data struct set up
+ * with imdgrd_init_data() straight at the mapping. the mapping is read only,
+ * and is unmapped by imdgrd_free_data(). for a subset of the grid, values
+ * are copied from the mapping in to an array allocated by the library. the
+ * number of values available is stored in nread, if not NULL:
+ */
+int imdgrd_map_data(struct imdgrd_input *input, struct imdgrd_data *data,
+                    size_t *nread) {
+  /* reader, for a subset of the grid: */
+  struct imdgrd_reader reader;
+  /* number of values expected and available: */
+  size_t data_count = imdgrd_data_count(data);
+  size_t map_count = 0;
+  /* return status: */
+  int status = IMDGRD_OK;
+  /* for loop integers: */
+  int i;
+  if (nread != NULL) {
+    *nread = 0;
+  }
+  /* the size of a value in the file has to match the size of a float: */
+  if (data->datasize != sizeof(float)) {
+    return IMDGRD_EVALUE;
+  }
+  /* for a subset, copy the subset one day at a time: */
+  if (is_subset(data)) {
+    if ((data->data = calloc(data_count, sizeof(float))) == NULL) {
+      return IMDGRD_ENOMEM;
+    }
+    data->data_alloc = 1;
+    if ((status = imdgrd_open_reader(input, data, &reader,
+                                     1)) == IMDGRD_OK) {
+      for (i = 0; i < data->ndays; i++) {
+        if ((status = imdgrd_read_day_into(&reader, i, data->data +
+                                           i * reader.day_count)) !=
+            IMDGRD_OK) {
+          break;
+        }
+        map_count += reader.day_count;
+      }
+    }
+    imdgrd_close_reader(&reader);
+    if (nread != NULL) {
+      *nread = map_count;
+    }
+    return status;
+  }
+  /*
+   * map the input file. values start at the beginning of the file, so the
+   * data array can point straight at the mapping:
+   */
+  data->map = map_file(input->filename, &data->map_size);
+  if (data->map == NULL) {
+    return IMDGRD_EMAP;
+  }
+  data->data = data->map;
+  /* number of whole values available in the mapping: */
+  map_count = data->map_size / sizeof(float);
+  if (map_count > data_count) {
+    map_count = data_count;
+  }
+  /*
+   * values which need byte swapping can not be used in place, so are copied
+   * from the mapping, swapping as they are copied:
+   */
+  if (input->swap == 1) {
+    if ((data->data = calloc(data_count, sizeof(float))) == NULL) {
+      return IMDGRD_ENOMEM;
+    }
+    data->data_alloc = 1;
+    imdgrd_swap_values(data->map, data->data, map_count);
+    munmap(data->map, data->map_size);
+    data->map = NULL;
+    data->map_size = 0;
+  }
+  if (nread != NULL) {
+    *nread = map_count;
+  }
+  /* return: */
+  return (map_count == data_count) ? IMDGRD_OK : IMDGRD_EREAD;
+}
+
+/*
+ * open a grd file for reading one day at a time. the file is either memory
+ * mapped, or opened with stdio and a buffer allocated for a single day. the
+ * data struct should remain valid until the reader is closed:
+ */
+int imdgrd_open_reader(struct imdgrd_input *input, struct imdgrd_data *data,
+                       struct imdgrd_reader *reader, int use_mmap) {
+  /* number of values in a single day: */
+  reader->day_count = (size_t) data->nlats * data->nlons;
+  reader->file = NULL;
+  reader->map = NULL;
+  reader->map_size = 0;
+  reader->buffer = NULL;
+  reader->rows = NULL;
+  reader->swap = input->swap;
+  reader->data = data;
+  /* values are read straight in to float buffers: */
+  if (data->datasize != sizeof(float)) {
+    return IMDGRD_EVALUE;
+  }
+  /* memory map the file, or open with stdio: */
+  if (use_mmap == 1) {
+    reader->map = map_file(input->filename, &reader->map_size);
+    if (reader->map == NULL) {
+      return IMDGRD_EMAP;
+    }
+  } else {
+    reader->file = fopen(input->filename, "rb");
+    if (reader->file == NULL) {
+      return IMDGRD_EOPEN;
+    }
+  }
+  /*
+   * rows containing a subset are read, or byte swapped from the mapping,
+   * before copying the subset:
+   */
+  if (is_subset(data) && ((use_mmap != 1) || (input->swap == 1))) {
+    reader->rows = calloc((size_t) data->nlats * data->grid_nlons,
+                          sizeof(float));
+    if (reader->rows == NULL) {
+      imdgrd_close_reader(reader);
+      return IMDGRD_ENOMEM;
+    }
+  }
+  /* day buffer, unless pointing in to the mapping: */
+  if ((use_mmap != 1) || is_subset(data) || (input->swap == 1)) {
+    reader->buffer = calloc(reader->day_count, sizeof(float));
+    if (reader->buffer == NULL) {
+      imdgrd_close_reader(reader);
+      return IMDGRD_ENOMEM;
+    }
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * position a reader so that the next day read is day, for reading days in
+ * order from part way through a grd file:
+ */
+int imdgrd_seek_reader(struct imdgrd_reader *reader, int day) {
+  /* byte offset of the day in the file: */
+  off_t offset = (off_t) day * reader->day_count * sizeof(float);
+  /* subsets and memory mapped files are read from any position: */
+  if ((reader->file == NULL) || is_subset(reader->data)) {
+    return IMDGRD_OK;
+  }
+  return (fseeko(reader->file, offset, SEEK_SET) == 0) ? IMDGRD_OK :
+         IMDGRD_EREAD;
+}
+
+/*
+ * read the values for a single day. days are expected to be read in order.
+ * returns a pointer to the values, or NULL if the day could not be read:
+ */
+float *imdgrd_read_day(struct imdgrd_reader *reader, int day) {
+  /* byte offset of the day in the file: */
+  size_t offset = (size_t) day * reader->day_count * sizeof(float);
+  /* for a subset, read the subset in to the buffer: */
+  if (is_subset(reader->data)) {
+    return (read_subset_day(reader, day, reader->buffer) == IMDGRD_OK) ?
+           reader->buffer : NULL;
+  }
+  /*
+   * if memory mapped, point in to the mapping, or swap the values in to the
+   * buffer:
+   */
+  if (reader->map != NULL) {
+    if (offset + reader->day_count * sizeof(float) > reader->map_size) {
+      return NULL;
+    }
+    if (reader->swap == 1) {
+      imdgrd_swap_values((float *) ((char *) reader->map + offset),
+                         reader->buffer, reader->day_count);
+      return reader->buffer;
+    }
+    return (float *) ((char *) reader->map + offset);
+  }
+  /* otherwise, read the day in to the buffer: */
+  if (fread(reader->buffer, sizeof(float), reader->day_count,
+            reader->file) != reader->day_count) {
+    return NULL;
+  }
+  if (reader->swap == 1) {
+    imdgrd_swap_values(reader->buffer, reader->buffer, reader->day_count);
+  }
+  return reader->buffer;
+}
+
+/*
+ * read the values for a single day in to the supplied buffer. days are
+ * expected to be read in order:
+ */
+int imdgrd_read_day_into(struct imdgrd_reader *reader, int day,
+                         float *buffer) {
+  /* byte offset of the day in the file: */
+  size_t offset = (size_t) day * reader->day_count * sizeof(float);
+  /* for a subset, read the subset: */
+  if (is_subset(reader->data)) {
+    return read_subset_day(reader, day, buffer);
+  }
+  /* if memory mapped, copy from the mapping, swapping if required: */
+  if (reader->map != NULL) {
+    if (offset + reader->day_count * sizeof(float) > reader->map_size) {
+      return IMDGRD_EREAD;
+    }
+    if (reader->swap == 1) {
+      imdgrd_swap_values((float *) ((char *) reader->map + offset), buffer,
+                         reader->day_count);
+    } else {
+      memcpy(buffer, (char *) reader->map + offset,
+             reader->day_count * sizeof(float));
+    }
+    return IMDGRD_OK;
+  }
+  /* otherwise, read the day from the file: */
+  if (fread(buffer, sizeof(float), reader->day_count,
+            reader->file) != reader->day_count) {
+    return IMDGRD_EREAD;
+  }
+  if (reader->swap == 1) {
+    imdgrd_swap_values(buffer, buffer, reader->day_count);
+  }
+  return IMDGRD_OK;
+}
+
+/* close a grd file reader: */
+void imdgrd_close_reader(struct imdgrd_reader *reader) {
+  if (reader->map != NULL) {
+    munmap(reader->map, reader->map_size);
+  }
+  if (reader->file != NULL) {
+    fclose(reader->file);
+  }
+  free(reader->buffer);
+  free(reader->rows);
+  reader->map = NULL;
+  reader->file = NULL;
+  reader->buffer = NULL;
+  reader->rows = NULL;
+}
+
+/*
+ * find the grid point nearest to a lat and lon, in the grid of an input
+ * file. returns IMDGRD_EPOINT if the point is more than half a grid size
+ * outside of the grid:
+ */
+int imdgrd_find_point(struct imdgrd_input *input, float lat, float lon,
+                      int *lat_index, int *lon_index) {
+  /* grid of the input file: */
+  const struct imdgrd_grid *grid = input->grid;
+  /* nearest grid point: */
+  long i = lround((lat - grid->lat0) / grid->grid);
+  long j = lround((lon - grid->lon0) / grid->grid);
+  if ((i < 0) || (i >= grid->nlats) || (j < 0) || (j >= grid->nlons)) {
+    return IMDGRD_EPOINT;
+  }
+  *lat_index = i;
+  *lon_index = j;
+  return IMDGRD_OK;
+}
+
+/*
+ * return the byte offset in a grd file of the value for a grid point on a
+ * day. values are stored a day at a time, each day as rows of longitudes
+ * from the first latitude, so the offset follows from the grid:
+ */
+long long imdgrd_point_offset(const struct imdgrd_grid *grid, int day,
+                              int lat_index, int lon_index) {
+  return (((long long) day * grid->nlats + lat_index) * grid->nlons +
+          lon_index) * sizeof(float);
+}
+
+/*
+ * read the values for a single grid point, for ndays days from first_day,
+ * in to values. only the value for each day is read, with pread, so a time
+ * series can be extracted without reading the rest of the file:
+ */
+int imdgrd_read_point(struct imdgrd_input *input, int lat_index, int lon_index,
+                      int first_day, int ndays, float *values) {
+  /* input file descriptor: */
+  int fd;
+  /* for loop integers: */
+  int i;
+  if ((lat_index < 0) || (lat_index >= input->grid->nlats) ||
+      (lon_index < 0) || (lon_index >= input->grid->nlons) ||
+      (first_day < 0) || (ndays < 0) || (first_day + ndays > input->days)) {
+    return IMDGRD_EPOINT;
+  }
+  if ((fd = open(input->filename, O_RDONLY)) == -1) {
+    return IMDGRD_EOPEN;
+  }
+  /* the reads are a day apart, so reading ahead would be wasted: */
+  posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+  for (i = 0; i < ndays; i++) {
+    if (pread(fd, &values[i], sizeof(float),
+              imdgrd_point_offset(input->grid, first_day + i, lat_index,
+                                  lon_index)) != sizeof(float)) {
+      close(fd);
+      return IMDGRD_EREAD;
+    }
+  }
+  close(fd);
+  if (input->swap == 1) {
+    imdgrd_swap_values(values, values, ndays);
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * check the values for a single day, counting fill values and values which
+ * are outside of the range min to max, or NaN, and finding the minimum and
+ * maximum of the valid values. if remapped is not NULL, the values are
+ * copied to it with any missing value markers replaced by the fill value,
+ * and the copy is checked. written without branches, so that the compiler
+ * can vectorise the loops:
+ */
+SIMD_CLONES
+void imdgrd_check_values(const float *values, float *remapped, size_t count,
+                         float fill, float min, float max,
+                         const float *missing, int nmissing,
+                         struct imdgrd_qc_day *result) {
+  /* values to remap: */
+  const float *source;
+  /* missing value marker: */
+  float marker;
+  /* counts of fill, remapped and out of range values: */
+  size_t nfill = 0, nmiss = 0, ninvalid = 0;
+  /* minimum and maximum valid values: */
+  float vmin = FLT_MAX, vmax = -FLT_MAX;
+  /* value, and whether it is a fill, missing or valid value: */
+  float value;
+  int is_fill, is_missing, is_valid;
+  /* for loop integers: */
+  size_t i;
+  int j;
+  /* remap the missing value markers, one at a time: */
+  if (remapped != NULL) {
+    for (j = 0; j < nmissing; j++) {
+      source = (j == 0) ? values : remapped;
+      marker = missing[j];
+#pragma omp simd reduction(+:nmiss)
+      for (i = 0; i < count; i++) {
+        value = source[i];
+        is_missing = (value == marker);
+        nmiss += is_missing;
+        remapped[i] = is_missing ? fill : value;
+      }
+    }
+    if (nmissing > 0) {
+      values = remapped;
+    }
+  }
+  /* check the values: */
+#pragma omp simd reduction(+:nfill, ninvalid) reduction(min:vmin) \
+                 reduction(max:vmax)
+  for (i = 0; i < count; i++) {
+    value = values[i];
+    is_fill = (value == fill);
+    is_valid = !is_fill && (value >= min) && (value <= max);
+    nfill += is_fill;
+    ninvalid += !is_fill && !is_valid;
+    vmin = (is_valid && (value < vmin)) ? value : vmin;
+    vmax = (is_valid && (value > vmax)) ? value : vmax;
+  }
+  /* store the results: */
+  result->checked = 1;
+  result->fill = nfill;
+  result->missing = nmiss;
+  result->invalid = ninvalid;
+  result->valid = count - nfill - ninvalid;
+  result->min = (result->valid > 0) ? vmin : fill;
+  result->max = (result->valid > 0) ? vmax : fill;
+}
+
+/* initialise a quality control struct, with no missing value markers: */
+void imdgrd_init_qc(struct imdgrd_qc *qc) {
+  memset(qc, 0, sizeof(struct imdgrd_qc));
+}
+
+/* free the quality control results, keeping the settings: */
+void imdgrd_free_qc(struct imdgrd_qc *qc) {
+  free(qc->days);
+  qc->days = NULL;
+  qc->ndays = 0;
+}
+
+/*
+ * check the values for a single day, indexed from the start of the output,
+ * using the range of possible values for the data type, and store the
+ * results. if remapped is not NULL, the values with missing value markers
+ * remapped are stored in it:
+ */
+int imdgrd_qc_day(struct imdgrd_qc *qc, struct imdgrd_data *data, int day,
+                  const float *values, float *remapped) {
+  /* results for each day, and number of days: */
+  struct imdgrd_qc_day *days;
+  int ndays;
+  /* make sure there are results for the day, a year at a time: */
+  if (day >= qc->ndays) {
+    ndays = day + data->ndays;
+    if ((days = realloc(qc->days,
+                        ndays * sizeof(struct imdgrd_qc_day))) == NULL) {
+      return IMDGRD_ENOMEM;
+    }
+    memset(days + qc->ndays, 0,
+           (ndays - qc->ndays) * sizeof(struct imdgrd_qc_day));
+    qc->days = days;
+    qc->ndays = ndays;
+  }
+  /* check the values: */
+  imdgrd_check_values(values, remapped, (size_t) data->nlats * data->nlons,
+                      data->fill, imdgrd_qc_mins[data->type],
+                      imdgrd_qc_maxs[data->type], qc->missing, qc->nmissing,
+                      &qc->days[day]);
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/* initialise an empty statistics struct: */
+void imdgrd_init_stats(struct imdgrd_stats *stats) {
+  memset(stats, 0, sizeof(struct imdgrd_stats));
+}
+
+/* free memory used by a statistics struct: */
+void imdgrd_free_stats(struct imdgrd_stats *stats) {
+  free(stats->lats);
+  free(stats->lons);
+  free(stats->sum);
+  free(stats->max);
+  free(stats->min);
+  free(stats->valid);
+  free(stats->rainy);
+  imdgrd_init_stats(stats);
+}
+
+/*
+ * allocate the statistics arrays for the grid of a data struct, and work out
+ * the first and last day of each period:
+ */
+static int alloc_stats(struct imdgrd_stats *stats, struct imdgrd_data *data) {
+  /* days in each month: */
+  int month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  /* number of grid points, and number of values in the arrays: */
+  size_t count = (size_t) data->nlats * data->nlons;
+  size_t nvalues = count * IMDGRD_STATS_PERIODS;
+  /* for loop integers: */
+  size_t i;
+  int j;
+  /* allocate the arrays: */
+  stats->lats = malloc(data->nlats * sizeof(float));
+  stats->lons = malloc(data->nlons * sizeof(float));
+  stats->sum = calloc(nvalues, sizeof(float));
+  stats->max = malloc(nvalues * sizeof(float));
+  stats->min = malloc(nvalues * sizeof(float));
+  stats->valid = calloc(nvalues, sizeof(int));
+  stats->rainy = (data->type == IMDGRD_RAIN) ?
+                 calloc(nvalues, sizeof(int)) : NULL;
+  if ((stats->lats == NULL) || (stats->lons == NULL) ||
+      (stats->sum == NULL) || (stats->max == NULL) ||
+      (stats->min == NULL) || (stats->valid == NULL) ||
+      ((data->type == IMDGRD_RAIN) && (stats->rainy == NULL))) {
+    imdgrd_free_stats(stats);
+    return IMDGRD_ENOMEM;
+  }
+  for (i = 0; i < nvalues; i++) {
+    stats->max[i] = -FLT_MAX;
+    stats->min[i] = FLT_MAX;
+  }
+  /* store the grid: */
+  memcpy(stats->lats, data->lats, data->nlats * sizeof(float));
+  memcpy(stats->lons, data->lons, data->nlons * sizeof(float));
+  stats->nlats = data->nlats;
+  stats->nlons = data->nlons;
+  stats->type = data->type;
+  stats->year = data->year;
+  stats->ndays = data->ndays;
+  stats->fill = data->fill;
+  /* first and last day of each month: */
+  month_days[1] = (imdgrd_year_days(data->year) == 366) ? 29 : 28;
+  for (j = 0; j < 12; j++) {
+    stats->period_start[j] = (j == 0) ? 0 : stats->period_end[j - 1] + 1;
+    stats->period_end[j] = stats->period_start[j] + month_days[j] - 1;
+  }
+  /* june to september, and the whole year: */
+  stats->period_start[IMDGRD_STATS_JJAS] = stats->period_start[5];
+  stats->period_end[IMDGRD_STATS_JJAS] = stats->period_end[8];
+  stats->period_start[IMDGRD_STATS_ANNUAL] = 0;
+  stats->period_end[IMDGRD_STATS_ANNUAL] = data->ndays - 1;
+  /* storing count last marks the struct as allocated: */
+  stats->count = count;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * add the values for a single day to the statistics for a period. fill
+ * values are skipped. written without branches, so that the compiler can
+ * vectorise the loops:
+ */
+static void add_period_stats(struct imdgrd_stats *stats, int period,
+                             const float *values) {
+  /* offset of the period in the statistics arrays: */
+  size_t offset = (size_t) period * stats->count;
+  float *sum = stats->sum + offset;
+  float *max = stats->max + offset;
+  float *min = stats->min + offset;
+  int *valid = stats->valid + offset;
+  int *rainy;
+  /* fill value: */
+  const float fill = stats->fill;
+  /* value, and whether it is valid: */
+  float value;
+  int ok;
+  /* for loop integers: */
+  size_t i;
+  /* loop through values: */
+#pragma omp simd
+  for (i = 0; i < stats->count; i++) {
+    value = values[i];
+    ok = (value != fill);
+    sum[i] += ok ? value : 0;
+    valid[i] += ok;
+    max[i] = (ok && (value > max[i])) ? value : max[i];
+    min[i] = (ok && (value < min[i])) ? value : min[i];
+  }
+  /* count rainy days, for rainfall data: */
+  if (stats->rainy != NULL) {
+    rainy = stats->rainy + offset;
+#pragma omp simd
+    for (i = 0; i < stats->count; i++) {
+      rainy[i] += ((values[i] != fill) &&
+                   (values[i] >= (float) IMDGRD_RAINY_DAY_THRESHOLD));
+    }
+  }
+}
+
+/*
+ * add the values for a single day, indexed from the start of the year, to
+ * a statistics struct. the statistics arrays are allocated from the data
+ * struct when the first day is added. days outside the year are ignored:
+ */
+int imdgrd_add_stats(struct imdgrd_stats *stats, struct imdgrd_data *data,
+                     int day, const float *values) {
+  /* return status: */
+  int status;
+  /* month of the day: */
+  int month;
+  /* allocate the statistics arrays if required: */
+  if ((stats->count == 0) &&
+      ((status = alloc_stats(stats, data)) != IMDGRD_OK)) {
+    return status;
+  }
+  if ((day < 0) || (day >= stats->ndays)) {
+    return IMDGRD_OK;
+  }
+  /* add to the month, the monsoon and the year: */
+  for (month = 0; day > stats->period_end[month]; month++);
+  add_period_stats(stats, month, values);
+  if ((day >= stats->period_start[IMDGRD_STATS_JJAS]) &&
+      (day <= stats->period_end[IMDGRD_STATS_JJAS])) {
+    add_period_stats(stats, IMDGRD_STATS_JJAS, values);
+  }
+  add_period_stats(stats, IMDGRD_STATS_ANNUAL, values);
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * pack float values in to shorts, as (value - offset) / scale rounded to the
+ * nearest integer. fill values are stored as the packed fill value, and
+ * values out of range are clamped. written without branches, so that the
+ * compiler can vectorise the loop:
+ */
+void imdgrd_pack_values(const float *values, short *packed, size_t count,
+                        float fill, float scale, float offset) {
+  /* inverse of the scale factor: */
+  const float inv_scale = 1 / scale;
+  /* scaled value: */
+  float scaled;
+  /* for loop integers: */
+  size_t i;
+  /* loop through values: */
+#pragma omp simd
+  for (i = 0; i < count; i++) {
+    scaled = (values[i] - offset) * inv_scale;
+    scaled += (scaled >= 0) ? 0.5f : -0.5f;
+    scaled = (scaled > IMDGRD_PACK_MAX) ? IMDGRD_PACK_MAX : scaled;
+    scaled = (scaled < IMDGRD_PACK_MIN) ? IMDGRD_PACK_MIN : scaled;
+    packed[i] = (values[i] == fill) ? imdgrd_pack_fill : (short) scaled;
+  }
+}
+
+/*
+ * round float values to the specified number of mantissa bits, by adding
+ * half of the lowest kept bit and masking off the rest. the zeroed trailing
+ * bits compress much better. fill values are left unchanged. written without
+ * branches, so that the compiler can vectorise the loop:
+ */
+void imdgrd_round_values(const float *values, float *rounded, size_t count,
+                         float fill, int bits) {
+  /* mask for kept bits, and half of the lowest kept bit: */
+  const uint32_t mask =
+    ~((UINT32_C(1) << (IMDGRD_FLOAT_MANTISSA_BITS - bits)) - 1);
+  const uint32_t half = (bits < IMDGRD_FLOAT_MANTISSA_BITS) ?
+    UINT32_C(1) << (IMDGRD_FLOAT_MANTISSA_BITS - bits - 1) : 0;
+  /* bit representation of value: */
+  uint32_t value_bits;
+  /* rounded value: */
+  float value;
+  /* for loop integers: */
+  size_t i;
+  /* loop through values: */
+#pragma omp simd
+  for (i = 0; i < count; i++) {
+    memcpy(&value_bits, &values[i], sizeof(value_bits));
+    value_bits = (value_bits + half) & mask;
+    memcpy(&value, &value_bits, sizeof(value));
+    rounded[i] = (values[i] == fill) ? fill : value;
+  }
+}
+
+/*
+ * transpose 4 byte values from nrows * ncols to ncols * nrows, a tile at a
+ * time, so that the rows being read and written stay in the cache:
+ */
+static void transpose_32(const uint32_t *values, uint32_t *transposed,
+                         size_t nrows, size_t ncols) {
+  /* first and last rows and columns of the tile: */
+  size_t i0, i1, j0, j1;
+  /* for loop integers: */
+  size_t i, j;
+  for (i0 = 0; i0 < nrows; i0 += IMDGRD_TRANSPOSE_TILE) {
+    i1 = (i0 + IMDGRD_TRANSPOSE_TILE < nrows) ?
+         i0 + IMDGRD_TRANSPOSE_TILE : nrows;
+    for (j0 = 0; j0 < ncols; j0 += IMDGRD_TRANSPOSE_TILE) {
+      j1 = (j0 + IMDGRD_TRANSPOSE_TILE < ncols) ?
+           j0 + IMDGRD_TRANSPOSE_TILE : ncols;
+      for (j = j0; j < j1; j++) {
+#pragma omp simd
+        for (i = i0; i < i1; i++) {
+          transposed[j * nrows + i] = values[i * ncols + j];
+        }
+      }
+    }
+  }
+}
+
+/*
+ * transpose 2 byte values from nrows * ncols to ncols * nrows, as
+ * transpose_32():
+ */
+static void transpose_16(const uint16_t *values, uint16_t *transposed,
+                         size_t nrows, size_t ncols) {
+  /* first and last rows and columns of the tile: */
+  size_t i0, i1, j0, j1;
+  /* for loop integers: */
+  size_t i, j;
+  for (i0 = 0; i0 < nrows; i0 += IMDGRD_TRANSPOSE_TILE) {
+    i1 = (i0 + IMDGRD_TRANSPOSE_TILE < nrows) ?
+         i0 + IMDGRD_TRANSPOSE_TILE : nrows;
+    for (j0 = 0; j0 < ncols; j0 += IMDGRD_TRANSPOSE_TILE) {
+      j1 = (j0 + IMDGRD_TRANSPOSE_TILE < ncols) ?
+           j0 + IMDGRD_TRANSPOSE_TILE : ncols;
+      for (j = j0; j < j1; j++) {
+#pragma omp simd
+        for (i = i0; i < i1; i++) {
+          transposed[j * nrows + i] = values[i * ncols + j];
+        }
+      }
+    }
+  }
+}
+
+/*
+ * transpose a matrix of values, stored by row, from nrows * ncols to ncols *
+ * nrows, e.g. days of grid point values in to time series for each grid
+ * point. value_size is the size of a value in bytes, 2 (packed shorts) or 4
+ * (floats):
+ */
+void imdgrd_transpose_values(const void *values, void *transposed,
+                             size_t nrows, size_t ncols, size_t value_size) {
+  if (value_size == sizeof(uint16_t)) {
+    transpose_16(values, transposed, nrows, ncols);
+  } else {
+    transpose_32(values, transposed, nrows, ncols);
+  }
+}
+
+/*
+ * check if a compression codec is available in the netcdf library. returns
+ * 1 if available:
+ */
+int imdgrd_codec_available(int codec) {
+  switch (codec) {
+    case IMDGRD_CODEC_NONE:
+    case IMDGRD_CODEC_DEFLATE:
+      return 1;
+#if NC_HAS_ZSTD
+    case IMDGRD_CODEC_ZSTD:
+      return 1;
+#endif
+#if NC_HAS_SZIP_WRITE
+    case IMDGRD_CODEC_SZIP:
+      return 1;
+#endif
+#if NC_HAS_BLOSC
+    case IMDGRD_CODEC_BLOSC:
+      return 1;
+#endif
+    default:
+      return 0;
+  }
+}
+
+/*
+ * set the shuffle filter and compression codec for a netcdf variable.
+ * returns the netcdf error code:
+ */
+static int set_compression(int ncid, int varid,
+                           struct imdgrd_ncoptions *ncoptions) {
+  /* netcdf function return values: */
+  int ncerr = NC_NOERR;
+  /* deflate also sets the shuffle filter: */
+  if (ncoptions->codec == IMDGRD_CODEC_DEFLATE) {
+    return nc_def_var_deflate(ncid, varid, ncoptions->shuffle, 1,
+                              ncoptions->level);
+  }
+  /* other codecs, shuffle filter first if requested: */
+  if ((ncoptions->shuffle == 1) && (ncoptions->codec != IMDGRD_CODEC_BLOSC)) {
+    ncerr = nc_def_var_deflate(ncid, varid, 1, 0, 0);
+  }
+  if (ncerr != NC_NOERR) {
+    return ncerr;
+  }
+  switch (ncoptions->codec) {
+#if NC_HAS_ZSTD
+    case IMDGRD_CODEC_ZSTD:
+      ncerr = nc_def_var_zstandard(ncid, varid, ncoptions->level);
+      break;
+#endif
+#if NC_HAS_SZIP_WRITE
+    case IMDGRD_CODEC_SZIP:
+      ncerr = nc_def_var_szip(ncid, varid, IMDGRD_SZIP_OPTIONS,
+                              IMDGRD_SZIP_PIXELS);
+      break;
+#endif
+#if NC_HAS_BLOSC
+    case IMDGRD_CODEC_BLOSC:
+      /* blosc applies its own shuffle: */
+      ncerr = nc_def_var_blosc(ncid, varid, BLOSC_LZ4, ncoptions->level, 0,
+                               ncoptions->shuffle);
+      break;
+#endif
+    default:
+      break;
+  }
+  return ncerr;
+}
+
+/*
+ * get the chunk sizes (time, lat, lon) for the data variable, for the
+ * requested chunk layout. returns 0 if the library default should be used:
+ */
+static int get_chunk_sizes(struct imdgrd_data *data,
+                           struct imdgrd_ncoptions *ncoptions,
+                           size_t *chunks) {
+  /* chunk layout: */
+  int chunk_layout = ncoptions->chunk_layout;
+  /*
+   * the library default has a single day per chunk for an unlimited time
+   * dimension, so the time-major layout uses the timeseries chunks instead:
+   */
+  if ((chunk_layout == IMDGRD_CHUNK_DEFAULT) &&
+      (ncoptions->layout == IMDGRD_LAYOUT_TIME_MAJOR)) {
+    chunk_layout = IMDGRD_CHUNK_TIMESERIES;
+  }
+  switch (chunk_layout) {
+    /* a single day per chunk: */
+    case IMDGRD_CHUNK_MAP:
+      chunks[0] = 1;
+      chunks[1] = data->nlats;
+      chunks[2] = data->nlons;
+      break;
+    /* all days, up to a year, for small tiles of grid points: */
+    case IMDGRD_CHUNK_TIMESERIES:
+      chunks[0] = (data->ndays < IMDGRD_TIMESERIES_CHUNK_DAYS) ? data->ndays :
+                  IMDGRD_TIMESERIES_CHUNK_DAYS;
+      chunks[1] = IMDGRD_TIMESERIES_CHUNK_TILE;
+      chunks[2] = IMDGRD_TIMESERIES_CHUNK_TILE;
+      break;
+    /* custom sizes: */
+    case IMDGRD_CHUNK_CUSTOM:
+      chunks[0] = ncoptions->chunk_sizes[0];
+      chunks[1] = ncoptions->chunk_sizes[1];
+      chunks[2] = ncoptions->chunk_sizes[2];
+      break;
+    /* library default: */
+    default:
+      return 0;
+  }
+  /* chunks can not be larger than the lat and lon dimensions: */
+  if (chunks[1] > (size_t) data->nlats) {
+    chunks[1] = data->nlats;
+  }
+  if (chunks[2] > (size_t) data->nlons) {
+    chunks[2] = data->nlons;
+  }
+  return 1;
+}
+
+/* free the grid and buffer for regridded values of an output file: */
+static void free_regrid_data(struct imdgrd_ncfile *ncfile) {
+  if (ncfile->regrid_data != NULL) {
+    imdgrd_free_data(ncfile->regrid_data);
+    free(ncfile->regrid_data);
+    ncfile->regrid_data = NULL;
+  }
+  free(ncfile->regrid_buffer);
+  ncfile->regrid_buffer = NULL;
+  ncfile->regrid_size = 0;
+}
+
+/*
+ * set up the grid of the values written to an output file, if the values
+ * are regridded. data is replaced with the target grid, which describes
+ * the output file:
+ */
+static int create_regrid_data(struct imdgrd_ncfile *ncfile,
+                              struct imdgrd_data **data) {
+  /* return status: */
+  int status;
+  if (ncfile->ncoptions.regrid == NULL) {
+    return IMDGRD_OK;
+  }
+  if ((ncfile->regrid_data = malloc(sizeof(struct imdgrd_data))) == NULL) {
+    return IMDGRD_ENOMEM;
+  }
+  if ((status = imdgrd_init_regrid_data(ncfile->ncoptions.regrid, *data,
+                                        ncfile->regrid_data)) != IMDGRD_OK) {
+    free(ncfile->regrid_data);
+    ncfile->regrid_data = NULL;
+    return status;
+  }
+  *data = ncfile->regrid_data;
+  return IMDGRD_OK;
+}
+
+/*
+ * check if a compression codec can be used for zarr output. zarr chunks are
+ * compressed in the library with zlib, so only deflate is available.
+ * returns 1 if available:
+ */
+int imdgrd_zarr_available(int codec) {
+  return (codec == IMDGRD_CODEC_NONE) || (codec == IMDGRD_CODEC_DEFLATE);
+}
+
+/* join a directory and a name in to a new path, or return NULL: */
+static char *join_path(const char *dir, const char *name) {
+  /* the path: */
+  char *path;
+  if ((path = malloc(strlen(dir) + strlen(name) + 2)) != NULL) {
+    sprintf(path, "%s/%s", dir, name);
+  }
+  return path;
+}
+
+/* write a buffer to a new file. returns 0, or the errno value: */
+static int write_file(const char *path, const void *buffer, size_t size) {
+  /* file descriptor, and number of bytes written by a call to write: */
+  int fd;
+  ssize_t nwritten;
+  /* bytes left to write: */
+  const unsigned char *next = buffer;
+  /* errno value: */
+  int err = 0;
+  if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1) {
+    return errno;
+  }
+  while (size > 0) {
+    if ((nwritten = write(fd, next, size)) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err = errno;
+      break;
+    }
+    next += nwritten;
+    size -= nwritten;
+  }
+  if ((close(fd) != 0) && (err == 0)) {
+    err = errno;
+  }
+  return err;
+}
+
+/*
+ * check if a directory entry is part of a zarr store, i.e. metadata or a
+ * chunk:
+ */
+static int is_zarr_entry(const char *name) {
+  return (strncmp(name, ".z", 2) == 0) ||
+         ((name[0] >= '0') && (name[0] <= '9') &&
+          (strspn(name, "0123456789.") == strlen(name)));
+}
+
+/*
+ * create a directory for a zarr store or array. if the directory exists,
+ * any zarr metadata and chunks in it are removed, so that no chunks are left
+ * from an earlier store. a file of the same name is replaced. returns 0, or
+ * the errno value:
+ */
+static int make_zarr_dir(const char *path) {
+  /* file information: */
+  struct stat file_stat;
+  /* directory, and an entry in it: */
+  DIR *dir;
+  struct dirent *entry;
+  /* path of an entry: */
+  char *entry_path;
+  /* create the directory, replacing a file: */
+  if ((stat(path, &file_stat) == 0) && !S_ISDIR(file_stat.st_mode) &&
+      (unlink(path) != 0)) {
+    return errno;
+  }
+  if (mkdir(path, 0777) == 0) {
+    return 0;
+  }
+  if (errno != EEXIST) {
+    return errno;
+  }
+  /* remove metadata and chunks from an existing directory: */
+  if ((dir = opendir(path)) == NULL) {
+    return errno;
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    if (is_zarr_entry(entry->d_name) == 0) {
+      continue;
+    }
+    if ((entry_path = join_path(path, entry->d_name)) == NULL) {
+      closedir(dir);
+      return ENOMEM;
+    }
+    unlink(entry_path);
+    free(entry_path);
+  }
+  closedir(dir);
+  return 0;
+}
+
+/* write a string to a json document, with quotes and escapes: */
+static void put_json_string(FILE *doc, const char *str) {
+  fputc('"', doc);
+  for (; *str != '\0'; str++) {
+    if ((unsigned char) *str < 0x20) {
+      fprintf(doc, "\\u%04x", *str);
+      continue;
+    }
+    if ((*str == '"') || (*str == '\\')) {
+      fputc('\\', doc);
+    }
+    fputc(*str, doc);
+  }
+  fputc('"', doc);
+}
+
+/*
+ * write a float to a json document. zarr stores values which json numbers
+ * can not represent as strings:
+ */
+static void put_json_float(FILE *doc, float value) {
+  if (isnan(value)) {
+    fprintf(doc, "\"NaN\"");
+  } else if (isinf(value)) {
+    fprintf(doc, (value > 0) ? "\"Infinity\"" : "\"-Infinity\"");
+  } else {
+    fprintf(doc, "%.9g", value);
+  }
+}
+
+/* write a list of sizes to a json document: */
+static void put_json_sizes(FILE *doc, const size_t *sizes, int count) {
+  /* for loop integers: */
+  int i;
+  fputc('[', doc);
+  for (i = 0; i < count; i++) {
+    fprintf(doc, (i > 0) ? ", %zu" : "%zu", sizes[i]);
+  }
+  fputc(']', doc);
+}
+
+/*
+ * write the .zarray metadata for an array of floats (coordinates, with no
+ * compression), or for the data variable:
+ */
+static void put_zarray(FILE *doc, struct imdgrd_ncfile *ncfile, int coord) {
+  /* zarr store and output settings: */
+  struct imdgrd_zarr *zarr = ncfile->zarr;
+  struct imdgrd_ncoptions *ncoptions = &ncfile->ncoptions;
+  /* coordinate shape, the dimension of the data variable at index coord: */
+  size_t coord_shape = (coord == -1) ? 0 : zarr->shape[coord];
+  /* whether the values are shorts: */
+  int packed = (coord == -1) && (zarr->value_size == sizeof(short));
+  fprintf(doc, "{\n    \"chunks\": ");
+  put_json_sizes(doc, (coord == -1) ? zarr->chunks : &coord_shape,
+                 (coord == -1) ? 3 : 1);
+  fprintf(doc, ",\n    \"compressor\": ");
+  if ((coord == -1) && (ncoptions->codec == IMDGRD_CODEC_DEFLATE)) {
+    fprintf(doc, "{\"id\": \"zlib\", \"level\": %d}", ncoptions->level);
+  } else {
+    fprintf(doc, "null");
+  }
+  fprintf(doc, ",\n    \"dimension_separator\": \".\",\n"
+               "    \"dtype\": \"%c%s\",\n"
+               "    \"fill_value\": ",
+          imdgrd_host_big_endian() ? '>' : '<', packed ? "i2" : "f4");
+  if (coord != -1) {
+    fprintf(doc, "null");
+  } else if (packed) {
+    fprintf(doc, "%d", imdgrd_pack_fill);
+  } else {
+    put_json_float(doc, zarr->fill_value);
+  }
+  fprintf(doc, ",\n    \"filters\": ");
+  if ((coord == -1) && (ncoptions->shuffle == 1)) {
+    fprintf(doc, "[{\"elementsize\": %zu, \"id\": \"shuffle\"}]",
+            zarr->value_size);
+  } else {
+    fprintf(doc, "null");
+  }
+  fprintf(doc, ",\n    \"order\": \"C\",\n    \"shape\": ");
+  put_json_sizes(doc, (coord == -1) ? zarr->shape : &coord_shape,
+                 (coord == -1) ? 3 : 1);
+  fprintf(doc, ",\n    \"zarr_format\": %d\n}\n", IMDGRD_ZARR_FORMAT);
+}
+
+/*
+ * write the .zattrs metadata for the group (array is -1), a coordinate
+ * (array is the dimension index) or the data variable (array is 3). the
+ * dimension names are stored for xarray, and the other attributes match
+ * the netcdf output:
+ */
+static void put_zattrs(FILE *doc, struct imdgrd_ncfile *ncfile, int array) {
+  /* zarr store and output settings: */
+  struct imdgrd_zarr *zarr = ncfile->zarr;
+  struct imdgrd_ncoptions *ncoptions = &ncfile->ncoptions;
+  /* dimension names: */
+  const char *dims[] = {IMDGRD_NC_TIME_VAR, IMDGRD_NC_LAT_VAR,
+                        IMDGRD_NC_LON_VAR};
+  /* the group has no attributes: */
+  if (array == -1) {
+    fprintf(doc, "{}\n");
+    return;
+  }
+  /* dimensions: */
+  fprintf(doc, "{\n    \"%s\": [", IMDGRD_ZARR_DIMENSIONS);
+  if (array < 3) {
+    put_json_string(doc, dims[array]);
+  } else {
+    fprintf(doc, "\"%s\", \"%s\", \"%s\"", dims[0], dims[1], dims[2]);
+  }
+  fprintf(doc, "],\n    \"%s\": ", IMDGRD_NC_UNITS);
+  /* units and calendar for time, units for the coordinates ... : */
+  if (array == 0) {
+    fprintf(doc, "\"%.11s%d%s\",\n    \"%s\": \"%s\"\n}\n",
+            IMDGRD_NC_TIME_UNITS, zarr->year, IMDGRD_NC_TIME_UNITS + 15,
+            IMDGRD_NC_CAL, IMDGRD_NC_CAL_TYPE);
+    return;
+  }
+  if (array < 3) {
+    fprintf(doc, "\"%s\"\n}\n",
+            (array == 1) ? IMDGRD_NC_LAT_UNITS : IMDGRD_NC_LON_UNITS);
+    return;
+  }
+  /* ... and units and packing or rounding information for the data: */
+  put_json_string(doc, zarr->units);
+  if (zarr->value_size == sizeof(short)) {
+    fprintf(doc, ",\n    \"%s\": ", IMDGRD_NC_SCALE);
+    put_json_float(doc, imdgrd_pack_scales[zarr->type]);
+    fprintf(doc, ",\n    \"%s\": ", IMDGRD_NC_OFFSET);
+    put_json_float(doc, imdgrd_pack_offsets[zarr->type]);
+  } else if (ncoptions->precision_type == IMDGRD_PRECISION_BITS) {
+    fprintf(doc, ",\n    \"%s\": %d", IMDGRD_NC_NSB,
+            ncoptions->precision_bits);
+  }
+  fprintf(doc, "\n}\n");
+}
+
+/*
+ * write the metadata for a zarr store: the group, each array, and all of it
+ * consolidated in to a single document, so that readers of object stores
+ * only need to fetch one file. returns 0, or the errno value:
+ */
+static int write_zarr_metadata(struct imdgrd_ncfile *ncfile) {
+  /* zarr store: */
+  struct imdgrd_zarr *zarr = ncfile->zarr;
+  /* array names, for the group (NULL), coordinates and data variable: */
+  const char *arrays[] = {NULL, IMDGRD_NC_TIME_VAR, IMDGRD_NC_LAT_VAR,
+                          IMDGRD_NC_LON_VAR, zarr->var};
+  /* consolidated metadata, and a single document, as memory streams: */
+  FILE *all, *doc;
+  char *all_buffer = NULL, *doc_buffer = NULL;
+  size_t all_size, doc_size;
+  /* key of a document, and the path of its file: */
+  char *key, *path;
+  /* errno value: */
+  int err = 0;
+  /* for loop integers: */
+  int i, j;
+  if ((all = open_memstream(&all_buffer, &all_size)) == NULL) {
+    return errno;
+  }
+  fprintf(all, "{\n    \"metadata\": {");
+  /* the group and attributes, then each array and its attributes: */
+  for (i = 0; (i < 5) && (err == 0); i++) {
+    for (j = 0; (j < 2) && (err == 0); j++) {
+      if ((doc = open_memstream(&doc_buffer, &doc_size)) == NULL) {
+        err = errno;
+        break;
+      }
+      if ((i == 0) && (j == 0)) {
+        fprintf(doc, "{\n    \"zarr_format\": %d\n}\n", IMDGRD_ZARR_FORMAT);
+      } else if (j == 0) {
+        put_zarray(doc, ncfile, (i < 4) ? i - 1 : -1);
+      } else {
+        put_zattrs(doc, ncfile, i - 1);
+      }
+      fclose(doc);
+      key = (j == 0) ?
+            ((i == 0) ? IMDGRD_ZARR_GROUP : IMDGRD_ZARR_ARRAY) :
+            IMDGRD_ZARR_ATTRS;
+      key = (i == 0) ? strdup(key) : join_path(arrays[i], key);
+      path = (key != NULL) ? join_path(zarr->path, key) : NULL;
+      if (path == NULL) {
+        err = ENOMEM;
+      } else {
+        err = write_file(path, doc_buffer, doc_size);
+        fprintf(all, "%s\n        ", ((i == 0) && (j == 0)) ? "" : ",");
+        put_json_string(all, key);
+        fprintf(all, ": %.*s", (int) doc_size - 1, doc_buffer);
+      }
+      free(path);
+      free(key);
+      free(doc_buffer);
+      doc_buffer = NULL;
+    }
+  }
+  fprintf(all, "\n    },\n    \"zarr_consolidated_format\": 1\n}\n");
+  fclose(all);
+  if ((err == 0) &&
+      ((path = join_path(zarr->path, IMDGRD_ZARR_METADATA)) == NULL)) {
+    err = ENOMEM;
+  } else if (err == 0) {
+    err = write_file(path, all_buffer, all_size);
+    free(path);
+  }
+  free(all_buffer);
+  return err;
+}
+
+/*
+ * thread for compressing and writing the chunks of one or more rows. each
+ * thread takes the next chunk until all have been written, or any thread
+ * has failed:
+ */
+static void *zarr_writer(void *arg) {
+  /* rows to write, and the zarr store: */
+  struct imdgrd_zarr_rows *rows = arg;
+  struct imdgrd_zarr *zarr = rows->zarr;
+  /* sizes of a value, a day, a row of a chunk and a chunk, in bytes: */
+  size_t value_size = zarr->value_size;
+  size_t day_size = zarr->shape[1] * zarr->shape[2] * value_size;
+  size_t line_size = zarr->chunks[2] * value_size;
+  size_t chunk_size = zarr->chunks[0] * zarr->chunks[1] * line_size;
+  /* number of values in a chunk: */
+  size_t chunk_count = chunk_size / value_size;
+  /* number of chunks across the longitudes: */
+  size_t lon_chunks = (zarr->shape[2] + zarr->chunks[2] - 1) /
+                      zarr->chunks[2];
+  /* chunk values, shuffled values and compressed chunk: */
+  unsigned char *chunk, *shuffled = NULL, *compressed = NULL;
+  const unsigned char *encoded;
+  uLongf compressed_size;
+  size_t bound = compressBound(chunk_size);
+  /* chunk path: */
+  char *path;
+  /* index of this chunk, its row, and chunk indexes of lat and lon: */
+  size_t index, row, lat_chunk, lon_chunk;
+  /* day, lat and first lon of values in the chunk, and number of lons: */
+  size_t day, lat, lon, nlons;
+  /* pointer in to the chunk: */
+  unsigned char *next;
+  /* errno value and failed operation: */
+  int err = 0;
+  const char *error = NULL;
+  /* for loop integers: */
+  size_t i, j, k;
+  /* allocate the buffers: */
+  chunk = malloc(chunk_size);
+  if (rows->shuffle == 1) {
+    shuffled = malloc(chunk_size);
+  }
+  if (rows->codec == IMDGRD_CODEC_DEFLATE) {
+    compressed = malloc(bound);
+  }
+  path = malloc(strlen(zarr->path) + strlen(zarr->var) + 3 * 21 + 4);
+  if ((chunk == NULL) || (path == NULL) ||
+      ((rows->shuffle == 1) && (shuffled == NULL)) ||
+      ((rows->codec == IMDGRD_CODEC_DEFLATE) && (compressed == NULL))) {
+    err = ENOMEM;
+    error = "allocating chunk buffers";
+  }
+  while (err == 0) {
+    /* take the next chunk: */
+    pthread_mutex_lock(&rows->lock);
+    index = rows->next++;
+    if (rows->err != 0) {
+      index = rows->nrows * rows->row_chunks;
+    }
+    pthread_mutex_unlock(&rows->lock);
+    if (index >= rows->nrows * rows->row_chunks) {
+      break;
+    }
+    row = rows->first_row + index / rows->row_chunks;
+    lat_chunk = (index % rows->row_chunks) / lon_chunks;
+    lon_chunk = (index % rows->row_chunks) % lon_chunks;
+    /*
+     * copy the values in to the chunk. edge chunks are stored at full size,
+     * padded with the fill value:
+     */
+    lon = lon_chunk * zarr->chunks[2];
+    next = chunk;
+    for (i = 0; i < zarr->chunks[0]; i++) {
+      day = (row - rows->first_row) * zarr->chunks[0] + i;
+      for (j = 0; j < zarr->chunks[1]; j++) {
+        lat = lat_chunk * zarr->chunks[1] + j;
+        nlons = 0;
+        if ((day < rows->ndays) && (lat < zarr->shape[1])) {
+          nlons = (lon + zarr->chunks[2] <= zarr->shape[2]) ?
+                  zarr->chunks[2] : zarr->shape[2] - lon;
+          memcpy(next, rows->values + day * day_size +
+                       (lat * zarr->shape[2] + lon) * value_size,
+                 nlons * value_size);
+        }
+        for (k = nlons; k < zarr->chunks[2]; k++) {
+          memcpy(next + k * value_size, zarr->fill, value_size);
+        }
+        next += line_size;
+      }
+    }
+    encoded = chunk;
+    /* group the bytes of each value, for the shuffle filter: */
+    if (rows->shuffle == 1) {
+      for (i = 0; i < chunk_count; i++) {
+        for (k = 0; k < value_size; k++) {
+          shuffled[k * chunk_count + i] = chunk[i * value_size + k];
+        }
+      }
+      encoded = shuffled;
+    }
+    /* compress and write the chunk: */
+    compressed_size = chunk_size;
+    if (rows->codec == IMDGRD_CODEC_DEFLATE) {
+      compressed_size = bound;
+      if ((err = compress2(compressed, &compressed_size, encoded,
+                           chunk_size, rows->level)) != Z_OK) {
+        error = "compressing chunk";
+        break;
+      }
+      encoded = compressed;
+    }
+    sprintf(path, "%s/%s/%zu.%zu.%zu", zarr->path, zarr->var, row,
+            lat_chunk, lon_chunk);
+    if ((err = write_file(path, encoded, compressed_size)) != 0) {
+      error = "writing chunk";
+    }
+  }
+  /* record any error: */
+  if (err != 0) {
+    pthread_mutex_lock(&rows->lock);
+    if (rows->err == 0) {
+      rows->err = err;
+      rows->error = error;
+    }
+    pthread_mutex_unlock(&rows->lock);
+  }
+  /* tidy up: */
+  free(chunk);
+  free(shuffled);
+  free(compressed);
+  free(path);
+  return NULL;
+}
+
+/*
+ * compress and write whole rows of chunks of the data variable, in parallel.
+ * values holds ndays days, starting at the first day of first_row. days
+ * after these are padded with the fill value. returns 0, or the errno value,
+ * or the negative zlib error code if compressing failed, with the failed
+ * operation stored in error:
+ */
+static int write_zarr_rows(struct imdgrd_ncfile *ncfile,
+                           const unsigned char *values, size_t ndays,
+                           size_t first_row, size_t nrows,
+                           const char **error) {
+  /* zarr store: */
+  struct imdgrd_zarr *zarr = ncfile->zarr;
+  /* rows to write: */
+  struct imdgrd_zarr_rows rows;
+  /* writer threads, and number of threads: */
+  pthread_t threads[IMDGRD_ZARR_MAX_THREADS];
+  int nthreads;
+  /* for loop integers: */
+  int i;
+  rows.zarr = zarr;
+  rows.values = values;
+  rows.ndays = ndays;
+  rows.first_row = first_row;
+  rows.nrows = nrows;
+  rows.row_chunks = ((zarr->shape[1] + zarr->chunks[1] - 1) /
+                     zarr->chunks[1]) *
+                    ((zarr->shape[2] + zarr->chunks[2] - 1) /
+                     zarr->chunks[2]);
+  rows.next = 0;
+  rows.codec = ncfile->ncoptions.codec;
+  rows.level = ncfile->ncoptions.level;
+  rows.shuffle = ncfile->ncoptions.shuffle;
+  rows.err = 0;
+  rows.error = NULL;
+  pthread_mutex_init(&rows.lock, NULL);
+  /*
+   * start the threads, no more than there are chunks. this thread also
+   * writes chunks, and does all of the work if no threads can be started:
+   */
+  nthreads = zarr->threads - 1;
+  if ((size_t) nthreads > nrows * rows.row_chunks - 1) {
+    nthreads = nrows * rows.row_chunks - 1;
+  }
+  for (i = 0; i < nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, zarr_writer, &rows) != 0) {
+      break;
+    }
+  }
+  nthreads = i;
+  zarr_writer(&rows);
+  for (i = 0; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&rows.lock);
+  *error = rows.error;
+  return rows.err;
+}
+
+/* free the state of a zarr store: */
+static void free_zarr(struct imdgrd_ncfile *ncfile) {
+  if (ncfile->zarr == NULL) {
+    return;
+  }
+  free(ncfile->zarr->path);
+  free(ncfile->zarr->var);
+  free(ncfile->zarr->units);
+  free(ncfile->zarr->row);
+  free(ncfile->zarr);
+  ncfile->zarr = NULL;
+}
+
+/*
+ * record an error writing a zarr store, and close it. err is an errno value,
+ * or a negative zlib error code. returns the library error code:
+ */
+static int zarr_error(struct imdgrd_ncfile *ncfile, int err,
+                      const char *error) {
+  free_zarr(ncfile);
+  free_regrid_data(ncfile);
+  ncfile->ncerr = err;
+  ncfile->error = error;
+  return (err < 0) ? IMDGRD_ECOMPRESS : IMDGRD_EZARR;
+}
+
+/*
+ * create a zarr v2 directory store, named as the output file, with arrays
+ * for the coordinates and the data variable. the coordinate values and all
+ * of the metadata are written, and the data variable chunks are written as
+ * the values are put. t0 is the time at which creating the store started:
+ */
+static int create_zarr(struct imdgrd_data *data, struct imdgrd_output *output,
+                       struct imdgrd_ncfile *ncfile, double t0) {
+  /* output settings: */
+  struct imdgrd_ncoptions *ncoptions = &ncfile->ncoptions;
+  /* zarr store: */
+  struct imdgrd_zarr *zarr;
+  /* array names and coordinate values: */
+  const char *arrays[] = {IMDGRD_NC_TIME_VAR, IMDGRD_NC_LAT_VAR,
+                          IMDGRD_NC_LON_VAR, output->ncvar};
+  const float *coords[] = {data->days, data->lats, data->lons};
+  /* path of an array directory, or chunk: */
+  char *path;
+  /* errno value: */
+  int err = 0;
+  /* for loop integers: */
+  int i;
+  /* set up the store: */
+  if ((zarr = calloc(1, sizeof(struct imdgrd_zarr))) == NULL) {
+    return IMDGRD_ENOMEM;
+  }
+  ncfile->zarr = zarr;
+  zarr->path = strdup(output->filename);
+  zarr->var = strdup(output->ncvar);
+  zarr->units = strdup(output->ncunits);
+  if ((zarr->path == NULL) || (zarr->var == NULL) || (zarr->units == NULL)) {
+    free_zarr(ncfile);
+    return IMDGRD_ENOMEM;
+  }
+  zarr->type = data->type;
+  zarr->year = data->year;
+  zarr->shape[0] = data->ndays;
+  zarr->shape[1] = data->nlats;
+  zarr->shape[2] = data->nlons;
+  /* chunks of a month of days for tiles of grid points, by default: */
+  if (get_chunk_sizes(data, ncoptions, zarr->chunks) == 0) {
+    zarr->chunks[0] = IMDGRD_ZARR_CHUNK_DAYS;
+    zarr->chunks[1] = (data->nlats < IMDGRD_ZARR_CHUNK_TILE) ? data->nlats :
+                      IMDGRD_ZARR_CHUNK_TILE;
+    zarr->chunks[2] = (data->nlons < IMDGRD_ZARR_CHUNK_TILE) ? data->nlons :
+                      IMDGRD_ZARR_CHUNK_TILE;
+  }
+  if (zarr->chunks[0] > zarr->shape[0]) {
+    zarr->chunks[0] = zarr->shape[0];
+  }
+  /* values are stored as shorts, if packing: */
+  if (ncoptions->precision_type == IMDGRD_PRECISION_SHORT) {
+    zarr->value_size = sizeof(short);
+    memcpy(zarr->fill, &imdgrd_pack_fill, sizeof(short));
+  } else {
+    zarr->value_size = sizeof(float);
+    memcpy(zarr->fill, &data->fill, sizeof(float));
+  }
+  zarr->fill_value = data->fill;
+  /* one thread per processor, by default: */
+  zarr->threads = (ncoptions->threads > 0) ? ncoptions->threads :
+                  (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (zarr->threads < 1) {
+    zarr->threads = 1;
+  } else if (zarr->threads > IMDGRD_ZARR_MAX_THREADS) {
+    zarr->threads = IMDGRD_ZARR_MAX_THREADS;
+  }
+  /* create the directories, and write the metadata: */
+  if ((err = make_zarr_dir(zarr->path)) != 0) {
+    return zarr_error(ncfile, err, "creating directory");
+  }
+  for (i = 0; i < 4; i++) {
+    if ((path = join_path(zarr->path, arrays[i])) == NULL) {
+      free_zarr(ncfile);
+      return IMDGRD_ENOMEM;
+    }
+    err = make_zarr_dir(path);
+    free(path);
+    if (err != 0) {
+      return zarr_error(ncfile, err, "creating directory");
+    }
+  }
+  if ((err = write_zarr_metadata(ncfile)) != 0) {
+    return zarr_error(ncfile, err, "writing metadata");
+  }
+  ncfile->define_time = get_time() - t0;
+  /* write the coordinate values, as a single chunk for each: */
+  t0 = get_time();
+  for (i = 0; i < 3; i++) {
+    if ((path = malloc(strlen(zarr->path) + strlen(arrays[i]) + 4)) ==
+        NULL) {
+      free_zarr(ncfile);
+      return IMDGRD_ENOMEM;
+    }
+    sprintf(path, "%s/%s/0", zarr->path, arrays[i]);
+    err = write_file(path, coords[i], zarr->shape[i] * sizeof(float));
+    free(path);
+    if (err != 0) {
+      return zarr_error(ncfile, err, "setting coordinate values");
+    }
+  }
+  ncfile->put_time += get_time() - t0;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * write data values, already converted to the output precision, to the data
+ * variable of a zarr store. whole days have to be written, in order. rows
+ * of chunks which are filled by the values are written straight away, and
+ * any days left over are kept until the rest of the row is written:
+ */
+static int put_zarr(struct imdgrd_ncfile *ncfile, size_t *nc_start,
+                    size_t *nc_count, const void *values) {
+  /* zarr store: */
+  struct imdgrd_zarr *zarr = ncfile->zarr;
+  /* size of a day of values in bytes, and days in a row of chunks: */
+  size_t day_size = zarr->shape[1] * zarr->shape[2] * zarr->value_size;
+  size_t row_days = zarr->chunks[0];
+  /* next day to write, number of days left, and their values: */
+  size_t day = nc_start[0];
+  size_t ndays = nc_count[0];
+  const unsigned char *next = values;
+  /* number of days and rows to write: */
+  size_t n, nrows;
+  /* errno value and failed operation: */
+  int err = 0;
+  const char *error;
+  if ((nc_start[0] != zarr->next_day) || (nc_start[1] != 0) ||
+      (nc_start[2] != 0) || (nc_count[1] != zarr->shape[1]) ||
+      (nc_count[2] != zarr->shape[2]) || (day + ndays > zarr->shape[0])) {
+    return zarr_error(ncfile, EINVAL, "setting data values out of order");
+  }
+  zarr->next_day = day + ndays;
+  /* allocate the row buffer, if any days may need to be kept: */
+  if ((zarr->row == NULL) && ((day + ndays) % row_days != 0) &&
+      (day + ndays < zarr->shape[0]) &&
+      ((zarr->row = malloc(row_days * day_size)) == NULL)) {
+    free_zarr(ncfile);
+    return IMDGRD_ENOMEM;
+  }
+  /* complete a row which has already been started: */
+  if ((day % row_days != 0) && (ndays > 0)) {
+    n = row_days - (day % row_days);
+    n = (n < ndays) ? n : ndays;
+    memcpy(zarr->row + (day % row_days) * day_size, next, n * day_size);
+    day += n;
+    ndays -= n;
+    next += n * day_size;
+    if ((day % row_days == 0) || (day == zarr->shape[0])) {
+      err = write_zarr_rows(ncfile, zarr->row, (day - 1) % row_days + 1,
+                            (day - 1) / row_days, 1, &error);
+    }
+  }
+  /*
+   * write whole rows, and the last row of the array, straight from the
+   * values:
+   */
+  n = (day + ndays == zarr->shape[0]) ? ndays :
+      ndays - (ndays % row_days);
+  nrows = (n + row_days - 1) / row_days;
+  if ((err == 0) && (nrows > 0)) {
+    err = write_zarr_rows(ncfile, next, n, day / row_days, nrows, &error);
+    day += n;
+    ndays -= n;
+    next += n * day_size;
+  }
+  if (err != 0) {
+    return zarr_error(ncfile, err, error);
+  }
+  /* keep the rest of the days, at the start of the next row: */
+  if (ndays > 0) {
+    memcpy(zarr->row, next, ndays * day_size);
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * close a zarr store. if the last row of chunks has been started but not
+ * finished, it is written, padded with the fill value. returns 0, or the
+ * errno value or negative zlib error code, recording the failed operation
+ * as zarr_error does:
+ */
+static int close_zarr(struct imdgrd_ncfile *ncfile) {
+  /* zarr store: */
+  struct imdgrd_zarr *zarr = ncfile->zarr;
+  /* days in the last row: */
+  size_t ndays = zarr->next_day % zarr->chunks[0];
+  /* errno value and failed operation: */
+  int err = 0;
+  const char *error;
+  if ((ndays > 0) && (zarr->next_day < zarr->shape[0])) {
+    err = write_zarr_rows(ncfile, zarr->row, ndays,
+                          zarr->next_day / zarr->chunks[0], 1, &error);
+  }
+  if (err != 0) {
+    zarr_error(ncfile, err, error);
+    return err;
+  }
+  free_zarr(ncfile);
+  return 0;
+}
+
+/*
+ * record a netcdf error for an output file, closing the file if it is open.
+ * returns the library error code:
+ */
+static int output_error(struct imdgrd_ncfile *ncfile, int ncerr,
+                        const char *error) {
+  if (ncfile->ncid != -1) {
+    imdgrd_close_output(ncfile);
+  }
+  free_regrid_data(ncfile);
+  ncfile->ncerr = ncerr;
+  ncfile->error = error;
+  return IMDGRD_ENETCDF;
+}
+
+/*
+ * set up the buffers for writing a data variable with the time-major
+ * layout, a block of block_days days at a time:
+ */
+static int create_time_major(struct imdgrd_data *data,
+                             struct imdgrd_ncfile *ncfile, size_t block_days) {
+  /* values waiting to be written: */
+  struct imdgrd_time_major *time_major;
+  /* size of a block of days in bytes: */
+  size_t block_size;
+  if ((time_major = malloc(sizeof(struct imdgrd_time_major))) == NULL) {
+    imdgrd_close_output(ncfile);
+    return IMDGRD_ENOMEM;
+  }
+  time_major->nlats = data->nlats;
+  time_major->nlons = data->nlons;
+  time_major->value_size =
+    (ncfile->ncoptions.precision_type == IMDGRD_PRECISION_SHORT) ?
+    sizeof(short) : sizeof(float);
+  time_major->block_days = block_days;
+  time_major->first_day = 0;
+  time_major->ndays = 0;
+  block_size = block_days * data->nlats * data->nlons *
+               time_major->value_size;
+  time_major->days = malloc(block_size);
+  time_major->transposed = malloc(block_size);
+  ncfile->time_major = time_major;
+  if ((time_major->days == NULL) || (time_major->transposed == NULL)) {
+    imdgrd_close_output(ncfile);
+    return IMDGRD_ENOMEM;
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/* free the buffers for the time-major layout: */
+static void free_time_major(struct imdgrd_ncfile *ncfile) {
+  if (ncfile->time_major != NULL) {
+    free(ncfile->time_major->days);
+    free(ncfile->time_major->transposed);
+    free(ncfile->time_major);
+    ncfile->time_major = NULL;
+  }
+}
+
+/*
+ * transpose days of values, in the output precision, and write them to a
+ * data variable with the time-major layout, starting at first_day:
+ */
+static int write_time_major(struct imdgrd_ncfile *ncfile, const void *values,
+                            size_t first_day, size_t ndays) {
+  /* values waiting to be written: */
+  struct imdgrd_time_major *time_major = ncfile->time_major;
+  /* netcdf function return values: */
+  int ncerr;
+  /* netcdf start and count arrays: */
+  size_t nc_count[3];
+  size_t nc_start[3];
+  /* start times of transposing and putting the values: */
+  double t0 = get_time(), t1;
+  /* transpose the days in to a time series for each grid point: */
+  imdgrd_transpose_values(values, time_major->transposed, ndays,
+                          time_major->nlats * time_major->nlons,
+                          time_major->value_size);
+  t1 = get_time();
+  ncfile->convert_time += t1 - t0;
+  /* write the values: */
+  nc_count[0] = time_major->nlats;
+  nc_count[1] = time_major->nlons;
+  nc_count[2] = ndays;
+  nc_start[0] = 0;
+  nc_start[1] = 0;
+  nc_start[2] = first_day;
+  if (ncfile->ncoptions.precision_type == IMDGRD_PRECISION_SHORT) {
+    ncerr = nc_put_vara_short(ncfile->ncid, ncfile->data_var, nc_start,
+                              nc_count, (short *) time_major->transposed);
+  } else {
+    ncerr = nc_put_vara_float(ncfile->ncid, ncfile->data_var, nc_start,
+                              nc_count, (float *) time_major->transposed);
+  }
+  ncfile->put_time += get_time() - t1;
+  ncfile->put_calls++;
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting data values");
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * write any days waiting to be written with the time-major layout. on an
+ * error, the file is closed:
+ */
+static int flush_time_major(struct imdgrd_ncfile *ncfile) {
+  /* values waiting to be written: */
+  struct imdgrd_time_major *time_major = ncfile->time_major;
+  /* number of days waiting: */
+  size_t ndays = time_major->ndays;
+  /* the days are gone, whether or not they can be written: */
+  time_major->ndays = 0;
+  if (ndays == 0) {
+    return IMDGRD_OK;
+  }
+  return write_time_major(ncfile, time_major->days, time_major->first_day,
+                          ndays);
+}
+
+/*
+ * write whole days of values, in the output precision, to a data variable
+ * with the time-major layout. blocks of days which fill the chunks in time
+ * are written straight from the values, and the rest are kept until the
+ * block is filled, or the file is closed. days have to be written in order,
+ * for all lats and lons:
+ */
+static int put_time_major(struct imdgrd_ncfile *ncfile, size_t *nc_start,
+                          size_t *nc_count, const void *values) {
+  /* values waiting to be written: */
+  struct imdgrd_time_major *time_major = ncfile->time_major;
+  /* size of a day of values in bytes, and days in a block: */
+  size_t day_size = time_major->nlats * time_major->nlons *
+                    time_major->value_size;
+  size_t block_days = time_major->block_days;
+  /* next day to write, number of days left, and their values: */
+  size_t day = nc_start[0];
+  size_t ndays = nc_count[0];
+  const unsigned char *next = values;
+  /* number of days to add to the waiting days: */
+  size_t n;
+  /* return status: */
+  int status;
+  if ((nc_start[1] != 0) || (nc_start[2] != 0) ||
+      (nc_count[1] != time_major->nlats) ||
+      (nc_count[2] != time_major->nlons) ||
+      ((time_major->ndays > 0) &&
+       (day != time_major->first_day + time_major->ndays))) {
+    return output_error(ncfile, NC_EINVAL,
+                        "setting data values out of order");
+  }
+  /*
+   * add days to a block which has already been started, or which starts
+   * part way through the chunks:
+   */
+  if ((ndays > 0) && ((time_major->ndays > 0) || (day % block_days != 0))) {
+    if (time_major->ndays == 0) {
+      time_major->first_day = day;
+    }
+    n = block_days - (day % block_days);
+    n = (n < ndays) ? n : ndays;
+    memcpy(time_major->days + time_major->ndays * day_size, next,
+           n * day_size);
+    time_major->ndays += n;
+    day += n;
+    ndays -= n;
+    next += n * day_size;
+    if ((day % block_days == 0) &&
+        ((status = flush_time_major(ncfile)) != IMDGRD_OK)) {
+      return status;
+    }
+  }
+  /* write whole blocks straight from the values: */
+  while (ndays >= block_days) {
+    if ((status = write_time_major(ncfile, next, day,
+                                   block_days)) != IMDGRD_OK) {
+      return status;
+    }
+    day += block_days;
+    ndays -= block_days;
+    next += block_days * day_size;
+  }
+  /* keep the rest of the days, at the start of the next block: */
+  if (ndays > 0) {
+    memcpy(time_major->days, next, ndays * day_size);
+    time_major->first_day = day;
+    time_major->ndays = ndays;
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * close a netcdf output file, or zarr store, and free the conversion
+ * buffer. returns the netcdf error code, or for a zarr store, the errno
+ * value or negative zlib error code, with the failed operation recorded in
+ * ncfile->error:
+ */
+int imdgrd_close_output(struct imdgrd_ncfile *ncfile) {
+  /* netcdf id: */
+  int ncid = ncfile->ncid;
+  /* return value of nc_close, and start time: */
+  int ncerr;
+  double t0 = get_time();
+  free(ncfile->pack_buffer);
+  free(ncfile->qc_buffer);
+  ncfile->pack_buffer = NULL;
+  ncfile->pack_size = 0;
+  ncfile->qc_buffer = NULL;
+  ncfile->qc_size = 0;
+  free_regrid_data(ncfile);
+  /*
+   * write any days waiting for the time-major layout. if they can not be
+   * written, the file has already been closed:
+   */
+  if (ncfile->time_major != NULL) {
+    if (flush_time_major(ncfile) != IMDGRD_OK) {
+      return ncfile->ncerr;
+    }
+    free_time_major(ncfile);
+  }
+  /*
+   * zarr stores have no netcdf id, and have already been freed if writing
+   * them failed:
+   */
+  if (ncfile->ncoptions.format == IMDGRD_FORMAT_ZARR) {
+    ncerr = (ncfile->zarr != NULL) ? close_zarr(ncfile) : 0;
+    ncfile->close_time += get_time() - t0;
+    return ncerr;
+  }
+  ncfile->ncid = -1;
+  ncerr = nc_close(ncid);
+  ncfile->close_time += get_time() - t0;
+  return ncerr;
+}
+
+/*
+ * write the time, latitude and longitude values to a netcdf output file,
+ * with a single call for each variable. the time values for all days are
+ * written up front, which also sets the length of the time dimension:
+ */
+static int write_coords(struct imdgrd_ncfile *ncfile,
+                        struct imdgrd_data *data) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* netcdf start and count arrays: */
+  size_t nc_tcount[1];
+  size_t nc_tstart[1];
+  /* add lat values: */
+  ncerr = nc_put_var_float(ncfile->ncid, ncfile->lat_var, &data->lats[0]);
+  ncfile->put_calls++;
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting latitude values");
+  }
+  /* add lon values: */
+  ncerr = nc_put_var_float(ncfile->ncid, ncfile->lon_var, &data->lons[0]);
+  ncfile->put_calls++;
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting longitude values");
+  }
+  /* add time values: */
+  nc_tcount[0] = data->ndays;
+  nc_tstart[0] = 0;
+  ncerr = nc_put_vara_float(ncfile->ncid, ncfile->time_var, nc_tstart,
+                            nc_tcount, &data->days[0]);
+  ncfile->put_calls++;
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting time values");
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * store the output settings in ncfile, before creating an output file. if
+ * ncoptions is NULL, the default settings are used:
+ */
+static void init_ncfile(struct imdgrd_ncfile *ncfile,
+                        struct imdgrd_ncoptions *ncoptions) {
+  ncfile->ncoptions = (ncoptions != NULL) ?
+                      *ncoptions : IMDGRD_DEFAULT_NCOPTIONS;
+  ncfile->pack_buffer = NULL;
+  ncfile->pack_size = 0;
+  ncfile->qc_buffer = NULL;
+  ncfile->qc_size = 0;
+  ncfile->ncerr = NC_NOERR;
+  ncfile->define_time = 0;
+  ncfile->convert_time = 0;
+  ncfile->put_time = 0;
+  ncfile->close_time = 0;
+  ncfile->put_calls = 0;
+  ncfile->error = NULL;
+  ncfile->ncid = -1;
+  ncfile->zarr = NULL;
+  ncfile->time_major = NULL;
+  ncfile->regrid_data = NULL;
+  ncfile->regrid_buffer = NULL;
+  ncfile->regrid_size = 0;
+}
+
+/*
+ * define the dimensions and variables of a newly created netcdf output file,
+ * and add the time, latitude and longitude values. the length of the time
+ * dimension is time_len, which may be NC_UNLIMITED. t0 is the time at which
+ * creating the file started:
+ */
+static int define_output(struct imdgrd_data *data,
+                         struct imdgrd_output *output,
+                         struct imdgrd_ncfile *ncfile, size_t time_len,
+                         double t0) {
+  /* output settings: */
+  struct imdgrd_ncoptions *ncoptions = &ncfile->ncoptions;
+  /* netcdf function return values: */
+  int ncerr;
+  /* dimension ids: */
+  int time_dim, lat_dim, lon_dim;
+  /* char representation of year: */
+  char *yr_str;
+  /* time units: */
+  char *time_units;
+  /* netcdf dimension ids: */
+  int dim_ids[3];
+  /* data variable chunk sizes (time, lat, lon), in the order of the
+     dimensions, and chunk cache size: */
+  size_t chunks[3];
+  size_t var_chunks[3];
+  size_t cache_size;
+  /* create the netcdf dimensions ... time: */
+  ncerr = nc_def_dim(ncfile->ncid, IMDGRD_NC_TIME_VAR, time_len, &time_dim);
+  /* ... latitude ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_dim(ncfile->ncid, IMDGRD_NC_LAT_VAR, data->nlats, &lat_dim);
+  }
+  /* ... longitude: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_dim(ncfile->ncid, IMDGRD_NC_LON_VAR, data->nlons, &lon_dim);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "creating dimension");
+  }
+  /* create the netcdf dimension variables ... time: */
+  ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_TIME_VAR, NC_FLOAT, 1, &time_dim,
+                     &ncfile->time_var);
+  /* ... latitude ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_LAT_VAR, NC_FLOAT, 1, &lat_dim,
+                       &ncfile->lat_var);
+  }
+  /* ... longitude: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_LON_VAR, NC_FLOAT, 1, &lon_dim,
+                       &ncfile->lon_var);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "creating variable");
+  }
+  /* allocate year string and the time units: */
+  yr_str = calloc(4 + 1, sizeof(char));
+  time_units = calloc(strlen(IMDGRD_NC_TIME_UNITS) + 1, sizeof(char));
+  if ((yr_str == NULL) || (time_units == NULL)) {
+    free(yr_str);
+    free(time_units);
+    imdgrd_close_output(ncfile);
+    return IMDGRD_ENOMEM;
+  }
+  sprintf(yr_str, "%d", data->year);
+  /* replace the year: */
+  time_units[0] = '\0';
+  strncat(time_units, IMDGRD_NC_TIME_UNITS, 11 * sizeof(char));
+  strncat(time_units, yr_str, 4 * sizeof(char));
+  strncat(time_units, IMDGRD_NC_TIME_UNITS + 15, 10 * sizeof(char));
+  /* add dimension variable attributes ... time units: */
+  ncerr = nc_put_att_text(ncfile->ncid, ncfile->time_var, IMDGRD_NC_UNITS,
+                          strlen(time_units), time_units);
+  /* free these: */
+  free(yr_str);
+  free(time_units);
+  /* ... time calendar ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, ncfile->time_var, IMDGRD_NC_CAL,
+                            strlen(IMDGRD_NC_CAL_TYPE), IMDGRD_NC_CAL_TYPE);
+  }
+  /* ... latitude ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, ncfile->lat_var, IMDGRD_NC_UNITS,
+                            strlen(IMDGRD_NC_LAT_UNITS), IMDGRD_NC_LAT_UNITS);
+  }
+  /* ... longitude: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, ncfile->lon_var, IMDGRD_NC_UNITS,
+                            strlen(IMDGRD_NC_LON_UNITS), IMDGRD_NC_LON_UNITS);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting variable attributes");
+  }
+  /* set the dimension ids, with time last for the time-major layout: */
+  if (ncoptions->layout == IMDGRD_LAYOUT_TIME_MAJOR) {
+    dim_ids[0] = lat_dim;
+    dim_ids[1] = lon_dim;
+    dim_ids[2] = time_dim;
+  } else {
+    dim_ids[0] = time_dim;
+    dim_ids[1] = lat_dim;
+    dim_ids[2] = lon_dim;
+  }
+  /* create the data variable, as shorts if packing: */
+  ncerr = nc_def_var(ncfile->ncid, output->ncvar,
+                     (ncoptions->precision_type == IMDGRD_PRECISION_SHORT) ?
+                     NC_SHORT : NC_FLOAT, 3, dim_ids, &ncfile->data_var);
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "creating variable");
+  }
+  /* set the chunk layout, if requested: */
+  if (get_chunk_sizes(data, ncoptions, chunks) == 1) {
+    if (ncoptions->layout == IMDGRD_LAYOUT_TIME_MAJOR) {
+      var_chunks[0] = chunks[1];
+      var_chunks[1] = chunks[2];
+      var_chunks[2] = chunks[0];
+    } else {
+      memcpy(var_chunks, chunks, sizeof(chunks));
+    }
+    ncerr = nc_def_var_chunking(ncfile->ncid, ncfile->data_var, NC_CHUNKED,
+                                var_chunks);
+    if (ncerr != NC_NOERR) {
+      return output_error(ncfile, ncerr, "setting variable chunking");
+    }
+    /*
+     * data is written a day at a time when streaming, so the chunk cache
+     * needs to be large enough to hold a full row of chunks across the grid,
+     * otherwise chunks spanning several days are repeatedly compressed and
+     * written:
+     */
+    cache_size = ((data->nlats + chunks[1] - 1) / chunks[1]) *
+                 ((data->nlons + chunks[2] - 1) / chunks[2]);
+    cache_size *= chunks[0] * chunks[1] * chunks[2] * sizeof(float);
+    if (cache_size > IMDGRD_NC_CHUNK_CACHE) {
+      ncerr = nc_set_var_chunk_cache(ncfile->ncid, ncfile->data_var,
+                                     cache_size, IMDGRD_NC_CHUNK_CACHE_NELEMS,
+                                     IMDGRD_NC_CHUNK_CACHE_PREEMPTION);
+      if (ncerr != NC_NOERR) {
+        return output_error(ncfile, ncerr, "setting variable chunk cache");
+      }
+    }
+  }
+  /* enable compression: */
+  ncerr = set_compression(ncfile->ncid, ncfile->data_var, ncoptions);
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting variable compression");
+  }
+  /* set the data units: */
+  ncerr = nc_put_att_text(ncfile->ncid, ncfile->data_var, IMDGRD_NC_UNITS,
+                          strlen(output->ncunits), output->ncunits);
+  /* set the data fill value, and packing or rounding information: */
+  if ((ncerr == NC_NOERR) &&
+      (ncoptions->precision_type == IMDGRD_PRECISION_SHORT)) {
+    ncerr = nc_put_att_short(ncfile->ncid, ncfile->data_var, IMDGRD_NC_FILLV,
+                             NC_SHORT, 1, &imdgrd_pack_fill);
+    if (ncerr == NC_NOERR) {
+      ncerr = nc_put_att_float(ncfile->ncid, ncfile->data_var, IMDGRD_NC_SCALE,
+                               NC_FLOAT, 1, &imdgrd_pack_scales[data->type]);
+    }
+    if (ncerr == NC_NOERR) {
+      ncerr = nc_put_att_float(ncfile->ncid, ncfile->data_var,
+                               IMDGRD_NC_OFFSET, NC_FLOAT, 1,
+                               &imdgrd_pack_offsets[data->type]);
+    }
+  } else if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_float(ncfile->ncid, ncfile->data_var, IMDGRD_NC_FILLV,
+                             NC_FLOAT, 1, &data->fill);
+    if ((ncerr == NC_NOERR) &&
+        (ncoptions->precision_type == IMDGRD_PRECISION_BITS)) {
+      ncerr = nc_put_att_int(ncfile->ncid, ncfile->data_var, IMDGRD_NC_NSB,
+                             NC_INT, 1, &ncoptions->precision_bits);
+    }
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting variable attributes");
+  }
+  /* exit define mode: */
+  ncerr = nc_enddef(ncfile->ncid);
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "ending define mode");
+  }
+  ncfile->define_time = get_time() - t0;
+  /* add the coordinate values: */
+  t0 = get_time();
+  ncerr = write_coords(ncfile, data);
+  ncfile->put_time += get_time() - t0;
+  return ncerr;
+}
+
+/*
+ * create a netcdf output file, define the dimensions and variables, and add
+ * the time, latitude and longitude values. the netcdf ids and output
+ * settings are stored in ncfile. if ncoptions is NULL, the default settings
+ * are used. with the zarr format, a zarr store is created instead, and the
+ * data values have to be written in order of time. with the time-major
+ * layout, whole days also have to be written in order of time, and are
+ * transposed a chunk of days at a time. days which do not fill a chunk are
+ * written when the file is closed, or the source is recorded:
+ */
+int imdgrd_create_output(struct imdgrd_data *data,
+                         struct imdgrd_output *output,
+                         struct imdgrd_ncoptions *ncoptions,
+                         struct imdgrd_ncfile *ncfile) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* start time: */
+  double t0 = get_time();
+  /* store the output settings: */
+  init_ncfile(ncfile, ncoptions);
+  /* data variable chunk sizes (time, lat, lon): */
+  size_t chunks[3];
+  /* when regridding, the output file is on the target grid: */
+  if ((ncerr = create_regrid_data(ncfile, &data)) != IMDGRD_OK) {
+    return ncerr;
+  }
+  /* create a zarr store, if requested. these are always day-major: */
+  if (ncfile->ncoptions.format == IMDGRD_FORMAT_ZARR) {
+    ncfile->ncoptions.layout = IMDGRD_LAYOUT_DAY_MAJOR;
+    return create_zarr(data, output, ncfile, t0);
+  }
+  /* create the output file: */
+  ncerr = nc_create(output->filename, IMDGRD_NC_CREATE_FLAGS, &ncfile->ncid);
+  if (ncerr != NC_NOERR) {
+    ncfile->ncid = -1;
+    return output_error(ncfile, ncerr, "creating file");
+  }
+  /* define the file, with an unlimited time dimension: */
+  if ((ncerr = define_output(data, output, ncfile, NC_UNLIMITED,
+                             t0)) != IMDGRD_OK) {
+    return ncerr;
+  }
+  /*
+   * with the time-major layout, days are written a chunk of days at a time:
+   */
+  if (ncfile->ncoptions.layout == IMDGRD_LAYOUT_TIME_MAJOR) {
+    get_chunk_sizes(data, &ncfile->ncoptions, chunks);
+    return create_time_major(data, ncfile, chunks[0]);
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+#ifdef USE_MPI
+/*
+ * create a netcdf output file for parallel writes by all processes in comm,
+ * as imdgrd_create_output(). every process has to call this, and the time
+ * dimension is fixed at the number of days in data. data values are written
+ * collectively, which parallel compression requires, so every process has
+ * to make the same number of imdgrd_put_data() or imdgrd_put_none() calls.
+ * on any error, the file is closed, which is also collective, so the
+ * caller should abort all processes:
+ */
+int imdgrd_create_output_par(struct imdgrd_data *data,
+                             struct imdgrd_output *output,
+                             struct imdgrd_ncoptions *ncoptions, MPI_Comm comm,
+                             struct imdgrd_ncfile *ncfile) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* start time: */
+  double t0 = get_time();
+  /* store the output settings: */
+  init_ncfile(ncfile, ncoptions);
+  /*
+   * values are written collectively as they are put, so the file is always
+   * day-major:
+   */
+  ncfile->ncoptions.layout = IMDGRD_LAYOUT_DAY_MAJOR;
+  /* each process writes the days it has read, on the grid of the input: */
+  ncfile->ncoptions.regrid = NULL;
+  /* create the output file: */
+  ncerr = nc_create_par(output->filename, IMDGRD_NC_CREATE_FLAGS, comm,
+                        MPI_INFO_NULL, &ncfile->ncid);
+  if (ncerr != NC_NOERR) {
+    ncfile->ncid = -1;
+    return output_error(ncfile, ncerr, "creating file");
+  }
+  /* define the file, with a fixed length time dimension: */
+  if ((ncerr = define_output(data, output, ncfile, data->ndays,
+                             t0)) != IMDGRD_OK) {
+    return ncerr;
+  }
+  /* write the data variable collectively: */
+  ncerr = nc_var_par_access(ncfile->ncid, ncfile->data_var, NC_COLLECTIVE);
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting parallel access");
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+#endif
+
+/*
+ * write data values to a netcdf output file or zarr store, for the given
+ * start and count, converting to the output precision if required:
+ */
+int imdgrd_put_data(struct imdgrd_ncfile *ncfile, struct imdgrd_data *data,
+                    size_t *nc_start, size_t *nc_count, float *values) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* output precision type: */
+  int precision_type = ncfile->ncoptions.precision_type;
+  /* number of values and size of converted values: */
+  size_t count = nc_count[0] * nc_count[1] * nc_count[2];
+  size_t size = count * ((precision_type == IMDGRD_PRECISION_SHORT) ?
+                         sizeof(short) : sizeof(float));
+  /* number of values in a day: */
+  size_t day_count = nc_count[1] * nc_count[2];
+  /* quality control settings and results: */
+  struct imdgrd_qc *qc = ncfile->ncoptions.qc;
+  /* count of regridded values, and fill value of the input: */
+  size_t regrid_count[3];
+  float fill;
+  /* return status: */
+  int status;
+  /* start times of converting and putting the values: */
+  double t0 = get_time(), t1;
+  /* for loop integers: */
+  size_t i;
+  /*
+   * check whole days, if requested. the values may be read only, so missing
+   * value markers are remapped in to a separate buffer:
+   */
+  if ((qc != NULL) && (day_count == (size_t) data->nlats * data->nlons)) {
+    if ((qc->nmissing > 0) && (count * sizeof(float) > ncfile->qc_size)) {
+      free(ncfile->qc_buffer);
+      ncfile->qc_size = 0;
+      if ((ncfile->qc_buffer = malloc(count * sizeof(float))) == NULL) {
+        imdgrd_close_output(ncfile);
+        return IMDGRD_ENOMEM;
+      }
+      ncfile->qc_size = count * sizeof(float);
+    }
+    for (i = 0; i < nc_count[0]; i++) {
+      if ((status = imdgrd_qc_day(qc, data, nc_start[0] + i,
+                                  values + i * day_count,
+                                  (qc->nmissing > 0) ?
+                                  ncfile->qc_buffer + i * day_count :
+                                  NULL)) != IMDGRD_OK) {
+        imdgrd_close_output(ncfile);
+        return status;
+      }
+    }
+    if (qc->nmissing > 0) {
+      values = ncfile->qc_buffer;
+    }
+  }
+  /*
+   * regrid whole days, if requested. the values are checked on the grid of
+   * the input, and everything after is done on the target grid:
+   */
+  if (ncfile->regrid_data != NULL) {
+    if ((day_count != (size_t) data->nlats * data->nlons) ||
+        (nc_start[1] != 0) || (nc_start[2] != 0)) {
+      imdgrd_close_output(ncfile);
+      return IMDGRD_EREGRID;
+    }
+    fill = data->fill;
+    data = ncfile->regrid_data;
+    regrid_count[0] = nc_count[0];
+    regrid_count[1] = data->nlats;
+    regrid_count[2] = data->nlons;
+    nc_count = regrid_count;
+    day_count = (size_t) data->nlats * data->nlons;
+    count = nc_count[0] * day_count;
+    size = count * ((precision_type == IMDGRD_PRECISION_SHORT) ?
+                    sizeof(short) : sizeof(float));
+    if (count * sizeof(float) > ncfile->regrid_size) {
+      free(ncfile->regrid_buffer);
+      ncfile->regrid_size = 0;
+      if ((ncfile->regrid_buffer = malloc(count * sizeof(float))) == NULL) {
+        imdgrd_close_output(ncfile);
+        return IMDGRD_ENOMEM;
+      }
+      ncfile->regrid_size = count * sizeof(float);
+    }
+    imdgrd_regrid_values(ncfile->ncoptions.regrid, values,
+                         ncfile->regrid_buffer, nc_count[0], fill);
+    values = ncfile->regrid_buffer;
+  }
+  /* add whole days to the statistics, if requested: */
+  if ((ncfile->ncoptions.stats != NULL) &&
+      (day_count == (size_t) data->nlats * data->nlons)) {
+    for (i = 0; i < nc_count[0]; i++) {
+      if ((status = imdgrd_add_stats(ncfile->ncoptions.stats, data,
+                                     nc_start[0] + i,
+                                     values + i * day_count)) != IMDGRD_OK) {
+        imdgrd_close_output(ncfile);
+        return status;
+      }
+    }
+  }
+  /* make sure the conversion buffer is large enough: */
+  if ((precision_type != IMDGRD_PRECISION_FLOAT) &&
+      (size > ncfile->pack_size)) {
+    free(ncfile->pack_buffer);
+    ncfile->pack_size = 0;
+    if ((ncfile->pack_buffer = malloc(size)) == NULL) {
+      imdgrd_close_output(ncfile);
+      return IMDGRD_ENOMEM;
+    }
+    ncfile->pack_size = size;
+  }
+  /* convert the values: */
+  if (precision_type == IMDGRD_PRECISION_SHORT) {
+    imdgrd_pack_values(values, ncfile->pack_buffer, count, data->fill,
+                       imdgrd_pack_scales[data->type],
+                       imdgrd_pack_offsets[data->type]);
+  } else if (precision_type == IMDGRD_PRECISION_BITS) {
+    imdgrd_round_values(values, ncfile->pack_buffer, count, data->fill,
+                        ncfile->ncoptions.precision_bits);
+    values = ncfile->pack_buffer;
+  }
+  t1 = get_time();
+  ncfile->convert_time += t1 - t0;
+  /* write the values: */
+  if (ncfile->zarr != NULL) {
+    status = put_zarr(ncfile, nc_start, nc_count,
+                      (precision_type == IMDGRD_PRECISION_SHORT) ?
+                      ncfile->pack_buffer : (void *) values);
+    ncfile->put_time += get_time() - t1;
+    return status;
+  }
+  /* time-major values are timed as they are transposed and written: */
+  if (ncfile->time_major != NULL) {
+    return put_time_major(ncfile, nc_start, nc_count,
+                          (precision_type == IMDGRD_PRECISION_SHORT) ?
+                          ncfile->pack_buffer : (void *) values);
+  }
+  if (precision_type == IMDGRD_PRECISION_SHORT) {
+    ncerr = nc_put_vara_short(ncfile->ncid, ncfile->data_var, nc_start,
+                              nc_count, ncfile->pack_buffer);
+  } else {
+    ncerr = nc_put_vara_float(ncfile->ncid, ncfile->data_var, nc_start,
+                              nc_count, values);
+  }
+  ncfile->put_time += get_time() - t1;
+  ncfile->put_calls++;
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting data values");
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+#ifdef USE_MPI
+/*
+ * take part in a collective write to a parallel netcdf output file, without
+ * writing any values, for a process which has fewer writes to make than the
+ * others:
+ */
+int imdgrd_put_none(struct imdgrd_ncfile *ncfile) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* netcdf start and count arrays, for no values: */
+  size_t nc_count[3] = {0, 0, 0};
+  size_t nc_start[3] = {0, 0, 0};
+  /* a value to point at: */
+  float value = 0;
+  /* start time: */
+  double t0 = get_time();
+  /* write nothing: */
+  ncerr = nc_put_vara_float(ncfile->ncid, ncfile->data_var, nc_start,
+                            nc_count, &value);
+  ncfile->put_time += get_time() - t0;
+  ncfile->put_calls++;
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting data values");
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+#endif
+
+/*
+ * write the data values for a single day to a netcdf output file:
+ */
+int imdgrd_write_day(struct imdgrd_ncfile *ncfile, struct imdgrd_data *data,
+                     int day, float *values) {
+  /* netcdf start and count arrays: */
+  size_t nc_count[3];
+  size_t nc_start[3];
+  /* add data values, as a single nlats * nlons slab: */
+  nc_count[0] = 1;
+  nc_count[1] = data->nlats;
+  nc_count[2] = data->nlons;
+  nc_start[0] = day;
+  nc_start[1] = 0;
+  nc_start[2] = 0;
+  return imdgrd_put_data(ncfile, data, nc_start, nc_count, values);
+}
+
+/*
+ * write all data values from a data struct to a new netcdf file. ncfile is
+ * used for the output file, and holds any netcdf error information:
+ */
+int imdgrd_write_data(struct imdgrd_data *data, struct imdgrd_output *output,
+                      struct imdgrd_ncoptions *ncoptions,
+                      struct imdgrd_ncfile *ncfile) {
+  /* return status: */
+  int status;
+  /* netcdf start and count arrays: */
+  size_t nc_count[3];
+  size_t nc_start[3];
+  /* create the output file: */
+  if ((status = imdgrd_create_output(data, output, ncoptions,
+                                     ncfile)) != IMDGRD_OK) {
+    return status;
+  }
+  /* add data values: */
+  nc_count[0] = data->ndays;
+  nc_count[1] = data->nlats;
+  nc_count[2] = data->nlons;
+  nc_start[0] = 0;
+  nc_start[1] = 0;
+  nc_start[2] = 0;
+  if ((status = imdgrd_put_data(ncfile, data, nc_start, nc_count,
+                                &data->data[0])) != IMDGRD_OK) {
+    return status;
+  }
+  /* record the input file, once all values have been written: */
+  if ((status = imdgrd_put_source(ncfile,
+                                  ncfile->ncoptions.source)) != IMDGRD_OK) {
+    return status;
+  }
+  /* close the output file: */
+  if ((status = imdgrd_close_output(ncfile)) != NC_NOERR) {
+    /* a zarr store records the failed operation as it is closed: */
+    if (ncfile->ncoptions.format == IMDGRD_FORMAT_ZARR) {
+      return (status < 0) ? IMDGRD_ECOMPRESS : IMDGRD_EZARR;
+    }
+    ncfile->ncerr = status;
+    ncfile->error = "closing file";
+    return IMDGRD_ENETCDF;
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * record information about the input file as global attributes of an open
+ * netcdf output file. this should be done after all values have been
+ * written, so that an incomplete output file is not taken to be up to date.
+ * does nothing if source is NULL, or for a zarr store, which
+ * imdgrd_read_source() can not read:
+ */
+int imdgrd_put_source(struct imdgrd_ncfile *ncfile,
+                      struct imdgrd_source *source) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* hash as hexadecimal text: */
+  char hash[16 + 1];
+  /* start time: */
+  double t0 = get_time();
+  if ((source == NULL) ||
+      (ncfile->ncoptions.format == IMDGRD_FORMAT_ZARR)) {
+    return IMDGRD_OK;
+  }
+  /*
+   * write any days waiting for the time-major layout first, so that the
+   * information is only recorded once all values are in the file:
+   */
+  if ((ncfile->time_major != NULL) &&
+      ((ncerr = flush_time_major(ncfile)) != IMDGRD_OK)) {
+    return ncerr;
+  }
+  sprintf(hash, "%016llx", (unsigned long long) source->hash);
+  /* add the attributes, in define mode: */
+  ncerr = nc_redef(ncfile->ncid);
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_longlong(ncfile->ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_SIZE,
+                                NC_INT64, 1, &source->size);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_longlong(ncfile->ncid, NC_GLOBAL,
+                                IMDGRD_NC_SOURCE_MTIME, NC_INT64, 1,
+                                &source->mtime);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_int(ncfile->ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_DAYS,
+                           NC_INT, 1, &source->days);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_HASH,
+                            strlen(hash), hash);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_enddef(ncfile->ncid);
+  }
+  ncfile->define_time += get_time() - t0;
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting source attributes");
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * read the information about the input file recorded in a netcdf output
+ * file by imdgrd_put_source(). returns IMDGRD_ESOURCE if the file can not be
+ * read, or does not have the information:
+ */
+int imdgrd_read_source(const char *filename, struct imdgrd_source *source) {
+  /* netcdf id: */
+  int ncid;
+  /* netcdf function return values: */
+  int ncerr;
+  /* length of the hash attribute, and the hash as text: */
+  size_t hash_len;
+  char hash[16 + 1];
+  /* end of the hash text: */
+  char *end;
+  if (nc_open(filename, NC_NOWRITE, &ncid) != NC_NOERR) {
+    return IMDGRD_ESOURCE;
+  }
+  ncerr = nc_get_att_longlong(ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_SIZE,
+                              &source->size);
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_get_att_longlong(ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_MTIME,
+                                &source->mtime);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_get_att_int(ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_DAYS,
+                           &source->days);
+  }
+  if ((ncerr == NC_NOERR) &&
+      ((ncerr = nc_inq_attlen(ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_HASH,
+                              &hash_len)) == NC_NOERR) &&
+      (hash_len != 16)) {
+    ncerr = NC_ENOTATT;
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_get_att_text(ncid, NC_GLOBAL, IMDGRD_NC_SOURCE_HASH, hash);
+  }
+  nc_close(ncid);
+  if (ncerr != NC_NOERR) {
+    return IMDGRD_ESOURCE;
+  }
+  hash[16] = '\0';
+  source->hash = strtoull(hash, &end, 16);
+  /* return: */
+  return (*end == '\0') ? IMDGRD_OK : IMDGRD_ESOURCE;
+}
+
+/*
+ * open an existing netcdf output file, created by imdgrd_create_output()
+ * for the same grid and subset as data, so that more days can be written.
+ * the output precision and layout are taken from the file, and the other
+ * settings, apart from quality control and statistics, are fixed when the
+ * file is created. the number of days already in the file is stored in
+ * ndays, and time values are added for the rest of the days in data:
+ */
+int imdgrd_open_output(struct imdgrd_data *data, struct imdgrd_output *output,
+                       struct imdgrd_ncoptions *ncoptions,
+                       struct imdgrd_ncfile *ncfile, int *ndays) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* dimension ids, data variable type, and dimension lengths: */
+  int time_dim, lat_dim, lon_dim;
+  nc_type data_type;
+  size_t time_len, lat_len, lon_len;
+  /* data variable dimension ids, storage and chunk sizes: */
+  int dim_ids[3];
+  int storage;
+  size_t var_chunks[3];
+  /* coordinate values in the file: */
+  float *coords;
+  size_t ncoords;
+  /* netcdf start and count arrays: */
+  size_t nc_tcount[1];
+  size_t nc_tstart[1];
+  /* for loop integers: */
+  int i;
+  /* start time: */
+  double t0 = get_time();
+  /* store the output settings: */
+  init_ncfile(ncfile, ncoptions);
+  ncoptions = &ncfile->ncoptions;
+  /* when regridding, the output file is on the target grid: */
+  if ((ncerr = create_regrid_data(ncfile, &data)) != IMDGRD_OK) {
+    return ncerr;
+  }
+  ncoords = (data->nlats > data->nlons) ? data->nlats : data->nlons;
+  /* open the file, and find the dimensions and variables: */
+  ncerr = nc_open(output->filename, NC_WRITE, &ncfile->ncid);
+  if (ncerr != NC_NOERR) {
+    ncfile->ncid = -1;
+    return output_error(ncfile, ncerr, "opening file");
+  }
+  ncerr = nc_inq_dimid(ncfile->ncid, IMDGRD_NC_TIME_VAR, &time_dim);
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_dimlen(ncfile->ncid, time_dim, &time_len);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_dimid(ncfile->ncid, IMDGRD_NC_LAT_VAR, &lat_dim);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_dimlen(ncfile->ncid, lat_dim, &lat_len);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_dimid(ncfile->ncid, IMDGRD_NC_LON_VAR, &lon_dim);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_dimlen(ncfile->ncid, lon_dim, &lon_len);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_varid(ncfile->ncid, IMDGRD_NC_TIME_VAR, &ncfile->time_var);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_varid(ncfile->ncid, IMDGRD_NC_LAT_VAR, &ncfile->lat_var);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_varid(ncfile->ncid, IMDGRD_NC_LON_VAR, &ncfile->lon_var);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_varid(ncfile->ncid, output->ncvar, &ncfile->data_var);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_vartype(ncfile->ncid, ncfile->data_var, &data_type);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_vardimid(ncfile->ncid, ncfile->data_var, dim_ids);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_var_chunking(ncfile->ncid, ncfile->data_var, &storage,
+                                var_chunks);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "reading file");
+  }
+  /* the layout is time-major if time is the last dimension: */
+  ncoptions->layout = (dim_ids[2] == time_dim) ? IMDGRD_LAYOUT_TIME_MAJOR :
+                      IMDGRD_LAYOUT_DAY_MAJOR;
+  /* the output precision is packed, rounded or full: */
+  if (data_type == NC_SHORT) {
+    ncoptions->precision_type = IMDGRD_PRECISION_SHORT;
+  } else if (nc_get_att_int(ncfile->ncid, ncfile->data_var, IMDGRD_NC_NSB,
+                            &ncoptions->precision_bits) == NC_NOERR) {
+    ncoptions->precision_type = IMDGRD_PRECISION_BITS;
+  } else {
+    ncoptions->precision_type = IMDGRD_PRECISION_FLOAT;
+  }
+  /*
+   * the grid has to be the same size, and the file can not have more days
+   * than the input:
+   */
+  if ((lat_len != (size_t) data->nlats) ||
+      (lon_len != (size_t) data->nlons) || (time_len > (size_t) data->ndays)) {
+    imdgrd_close_output(ncfile);
+    return IMDGRD_EAPPEND;
+  }
+  /* check the coordinates match: */
+  if ((coords = malloc(ncoords * sizeof(float))) == NULL) {
+    imdgrd_close_output(ncfile);
+    return IMDGRD_ENOMEM;
+  }
+  nc_tstart[0] = 0;
+  nc_tcount[0] = data->nlats;
+  ncerr = nc_get_vara_float(ncfile->ncid, ncfile->lat_var, nc_tstart,
+                            nc_tcount, coords);
+  for (i = 0; (ncerr == NC_NOERR) && (i < data->nlats); i++) {
+    if (coords[i] != data->lats[i]) {
+      ncerr = NC_EINVAL;
+    }
+  }
+  nc_tcount[0] = data->nlons;
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_get_vara_float(ncfile->ncid, ncfile->lon_var, nc_tstart,
+                              nc_tcount, coords);
+  }
+  for (i = 0; (ncerr == NC_NOERR) && (i < data->nlons); i++) {
+    if (coords[i] != data->lons[i]) {
+      ncerr = NC_EINVAL;
+    }
+  }
+  free(coords);
+  if (ncerr != NC_NOERR) {
+    imdgrd_close_output(ncfile);
+    return IMDGRD_EAPPEND;
+  }
+  /* days are written a chunk of days at a time, for the time-major layout: */
+  if ((ncoptions->layout == IMDGRD_LAYOUT_TIME_MAJOR) &&
+      ((ncerr = create_time_major(data, ncfile,
+                                  ((storage == NC_CHUNKED) &&
+                                   (var_chunks[2] > 0)) ?
+                                  var_chunks[2] : 1)) != IMDGRD_OK)) {
+    return ncerr;
+  }
+  *ndays = time_len;
+  ncfile->define_time = get_time() - t0;
+  /* add the time values for the new days: */
+  t0 = get_time();
+  if (time_len < (size_t) data->ndays) {
+    nc_tstart[0] = time_len;
+    nc_tcount[0] = data->ndays - time_len;
+    ncerr = nc_put_vara_float(ncfile->ncid, ncfile->time_var, nc_tstart,
+                              nc_tcount, &data->days[time_len]);
+    ncfile->put_calls++;
+    if (ncerr != NC_NOERR) {
+      return output_error(ncfile, ncerr, "setting time values");
+    }
+  }
+  ncfile->put_time += get_time() - t0;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * check if a statistic is written for the data type of a statistics struct.
+ * the sum and rainy days are only written for rainfall:
+ */
+static int stat_written(struct imdgrd_stats *stats, int stat) {
+  return (stats->rainy != NULL) ||
+         ((stat != IMDGRD_STAT_SUM) && (stat != IMDGRD_STAT_RAINY_DAYS));
+}
+
+/*
+ * get the values of a statistic for all periods and grid points, with the
+ * fill value where there are no valid values. rainy day counts are stored
+ * as ints:
+ */
+static void get_stat_values(struct imdgrd_stats *stats, int stat,
+                            void *buffer) {
+  /* output values: */
+  float *values = buffer;
+  int *counts = buffer;
+  /* number of values: */
+  size_t nvalues = stats->count * IMDGRD_STATS_PERIODS;
+  /* for loop integers: */
+  size_t i;
+  /* loop through values: */
+  for (i = 0; i < nvalues; i++) {
+    switch (stat) {
+      case IMDGRD_STAT_SUM:
+        values[i] = (stats->valid[i] > 0) ? stats->sum[i] : stats->fill;
+        break;
+      case IMDGRD_STAT_MEAN:
+        values[i] = (stats->valid[i] > 0) ?
+                    stats->sum[i] / stats->valid[i] : stats->fill;
+        break;
+      case IMDGRD_STAT_MAX:
+        values[i] = (stats->valid[i] > 0) ? stats->max[i] : stats->fill;
+        break;
+      case IMDGRD_STAT_MIN:
+        values[i] = (stats->valid[i] > 0) ? stats->min[i] : stats->fill;
+        break;
+      default:
+        counts[i] = (stats->valid[i] > 0) ? stats->rainy[i] :
+                    IMDGRD_RAINY_DAYS_FILL;
+    }
+  }
+}
+
+/*
+ * write statistics to a new netcdf file, with a (period, latitude,
+ * longitude) variable for each statistic, named from the output variable
+ * name, e.g. rainfall_mean. ncfile is used for the output file, and holds
+ * any netcdf error information. if ncoptions is NULL, the default settings
+ * are used:
+ */
+int imdgrd_write_stats(struct imdgrd_stats *stats,
+                       struct imdgrd_output *output,
+                       struct imdgrd_ncoptions *ncoptions,
+                       struct imdgrd_ncfile *ncfile) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* dimension ids: */
+  int period_dim, lat_dim, lon_dim;
+  /* netcdf dimension ids: */
+  int dim_ids[3];
+  /* period variable ids: */
+  int period_var, start_var, end_var;
+  /* statistic variable ids: */
+  int stat_vars[IMDGRD_STATS_COUNT];
+  /* statistic variable name: */
+  char name[NC_MAX_NAME + 1];
+  /* time units: */
+  char time_units[sizeof(IMDGRD_NC_TIME_UNITS) + 16];
+  /* period numbers, and first and last days: */
+  int periods[IMDGRD_STATS_PERIODS];
+  float starts[IMDGRD_STATS_PERIODS];
+  float ends[IMDGRD_STATS_PERIODS];
+  /* rainy days fill value: */
+  const int rainy_fill = IMDGRD_RAINY_DAYS_FILL;
+  /* netcdf start and count arrays: */
+  size_t nc_count[3];
+  size_t nc_start[3];
+  /* for loop integers: */
+  int i;
+  /* store the output settings: */
+  init_ncfile(ncfile, ncoptions);
+  ncoptions = &ncfile->ncoptions;
+  /* check there are some statistics: */
+  if (stats->count == 0) {
+    return IMDGRD_ESTATS;
+  }
+  /* allocate buffer for statistic values: */
+  ncfile->pack_size = stats->count * IMDGRD_STATS_PERIODS * sizeof(float);
+  if ((ncfile->pack_buffer = malloc(ncfile->pack_size)) == NULL) {
+    ncfile->pack_size = 0;
+    return IMDGRD_ENOMEM;
+  }
+  /* create the output file: */
+  ncerr = nc_create(output->filename, IMDGRD_NC_CREATE_FLAGS, &ncfile->ncid);
+  if (ncerr != NC_NOERR) {
+    free(ncfile->pack_buffer);
+    ncfile->pack_buffer = NULL;
+    ncfile->ncid = -1;
+    return output_error(ncfile, ncerr, "creating file");
+  }
+  /* create the netcdf dimensions ... period ... : */
+  ncerr = nc_def_dim(ncfile->ncid, IMDGRD_NC_PERIOD_VAR, IMDGRD_STATS_PERIODS,
+                     &period_dim);
+  /* ... latitude ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_dim(ncfile->ncid, IMDGRD_NC_LAT_VAR, stats->nlats,
+                       &lat_dim);
+  }
+  /* ... longitude: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_dim(ncfile->ncid, IMDGRD_NC_LON_VAR, stats->nlons,
+                       &lon_dim);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "creating dimension");
+  }
+  /* create the period variables ... period ... : */
+  ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_PERIOD_VAR, NC_INT, 1,
+                     &period_dim, &period_var);
+  /* ... first day ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_PERIOD_START, NC_FLOAT, 1,
+                       &period_dim, &start_var);
+  }
+  /* ... last day: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_PERIOD_END, NC_FLOAT, 1,
+                       &period_dim, &end_var);
+  }
+  /* create the dimension variables ... latitude ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_LAT_VAR, NC_FLOAT, 1, &lat_dim,
+                       &ncfile->lat_var);
+  }
+  /* ... longitude: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_def_var(ncfile->ncid, IMDGRD_NC_LON_VAR, NC_FLOAT, 1, &lon_dim,
+                       &ncfile->lon_var);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "creating variable");
+  }
+  /* period numbers and first and last days: */
+  for (i = 0; i < IMDGRD_STATS_PERIODS; i++) {
+    periods[i] = i + 1;
+    starts[i] = stats->period_start[i];
+    ends[i] = stats->period_end[i];
+  }
+  snprintf(time_units, sizeof(time_units), "days since %d-1-1 0:0:0",
+           stats->year);
+  /* add period variable attributes ... flag values ... : */
+  ncerr = nc_put_att_int(ncfile->ncid, period_var, IMDGRD_NC_FLAG_VALUES,
+                         NC_INT, IMDGRD_STATS_PERIODS, periods);
+  /* ... flag meanings ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, period_var, IMDGRD_NC_FLAG_MEANINGS,
+                            strlen(imdgrd_stats_periods),
+                            imdgrd_stats_periods);
+  }
+  /* ... day units and calendars ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, start_var, IMDGRD_NC_UNITS,
+                            strlen(time_units), time_units);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, start_var, IMDGRD_NC_CAL,
+                            strlen(IMDGRD_NC_CAL_TYPE), IMDGRD_NC_CAL_TYPE);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, end_var, IMDGRD_NC_UNITS,
+                            strlen(time_units), time_units);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, end_var, IMDGRD_NC_CAL,
+                            strlen(IMDGRD_NC_CAL_TYPE), IMDGRD_NC_CAL_TYPE);
+  }
+  /* ... latitude ... : */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, ncfile->lat_var, IMDGRD_NC_UNITS,
+                            strlen(IMDGRD_NC_LAT_UNITS), IMDGRD_NC_LAT_UNITS);
+  }
+  /* ... longitude: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_att_text(ncfile->ncid, ncfile->lon_var, IMDGRD_NC_UNITS,
+                            strlen(IMDGRD_NC_LON_UNITS), IMDGRD_NC_LON_UNITS);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting variable attributes");
+  }
+  /* set the dimension ids: */
+  dim_ids[0] = period_dim;
+  dim_ids[1] = lat_dim;
+  dim_ids[2] = lon_dim;
+  /* create the statistic variables: */
+  for (i = 0; i < IMDGRD_STATS_COUNT; i++) {
+    if (stat_written(stats, i) == 0) {
+      continue;
+    }
+    if (i == IMDGRD_STAT_RAINY_DAYS) {
+      snprintf(name, sizeof(name), "%s", IMDGRD_NC_RAINY_DAYS_VAR);
+    } else {
+      snprintf(name, sizeof(name), "%s_%s", output->ncvar,
+               imdgrd_stats_names[i]);
+    }
+    ncerr = nc_def_var(ncfile->ncid, name, (i == IMDGRD_STAT_RAINY_DAYS) ?
+                       NC_INT : NC_FLOAT, 3, dim_ids, &stat_vars[i]);
+    if (ncerr != NC_NOERR) {
+      return output_error(ncfile, ncerr, "creating variable");
+    }
+    ncerr = set_compression(ncfile->ncid, stat_vars[i], ncoptions);
+    if (ncerr != NC_NOERR) {
+      return output_error(ncfile, ncerr, "setting variable compression");
+    }
+    /* set the units and fill value: */
+    if (i == IMDGRD_STAT_RAINY_DAYS) {
+      ncerr = nc_put_att_text(ncfile->ncid, stat_vars[i], IMDGRD_NC_UNITS,
+                              strlen(IMDGRD_NC_RAINY_DAYS_UNITS),
+                              IMDGRD_NC_RAINY_DAYS_UNITS);
+      if (ncerr == NC_NOERR) {
+        ncerr = nc_put_att_int(ncfile->ncid, stat_vars[i], IMDGRD_NC_FILLV,
+                               NC_INT, 1, &rainy_fill);
+      }
+    } else {
+      ncerr = nc_put_att_text(ncfile->ncid, stat_vars[i], IMDGRD_NC_UNITS,
+                              strlen(output->ncunits), output->ncunits);
+      if (ncerr == NC_NOERR) {
+        ncerr = nc_put_att_float(ncfile->ncid, stat_vars[i], IMDGRD_NC_FILLV,
+                                 NC_FLOAT, 1, &stats->fill);
+      }
+    }
+    if (ncerr != NC_NOERR) {
+      return output_error(ncfile, ncerr, "setting variable attributes");
+    }
+  }
+  /* exit define mode: */
+  ncerr = nc_enddef(ncfile->ncid);
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "ending define mode");
+  }
+  /* add the period values ... : */
+  nc_count[0] = IMDGRD_STATS_PERIODS;
+  nc_start[0] = 0;
+  ncerr = nc_put_vara_int(ncfile->ncid, period_var, nc_start, nc_count,
+                          periods);
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_var_float(ncfile->ncid, start_var, starts);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_put_var_float(ncfile->ncid, end_var, ends);
+  }
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting period values");
+  }
+  /* ... lat values ... : */
+  ncerr = nc_put_var_float(ncfile->ncid, ncfile->lat_var, stats->lats);
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting latitude values");
+  }
+  /* ... lon values ... : */
+  ncerr = nc_put_var_float(ncfile->ncid, ncfile->lon_var, stats->lons);
+  if (ncerr != NC_NOERR) {
+    return output_error(ncfile, ncerr, "setting longitude values");
+  }
+  /* ... and statistic values: */
+  nc_count[1] = stats->nlats;
+  nc_count[2] = stats->nlons;
+  nc_start[1] = 0;
+  nc_start[2] = 0;
+  for (i = 0; i < IMDGRD_STATS_COUNT; i++) {
+    if (stat_written(stats, i) == 0) {
+      continue;
+    }
+    get_stat_values(stats, i, ncfile->pack_buffer);
+    if (i == IMDGRD_STAT_RAINY_DAYS) {
+      ncerr = nc_put_vara_int(ncfile->ncid, stat_vars[i], nc_start,
+                              nc_count, ncfile->pack_buffer);
+    } else {
+      ncerr = nc_put_vara_float(ncfile->ncid, stat_vars[i], nc_start,
+                                nc_count, ncfile->pack_buffer);
+    }
+    if (ncerr != NC_NOERR) {
+      return output_error(ncfile, ncerr, "setting statistic values");
+    }
+  }
+  /* close the output file: */
+  if ((ncerr = imdgrd_close_output(ncfile)) != NC_NOERR) {
+    ncfile->ncerr = ncerr;
+    ncfile->error = "closing file";
+    return IMDGRD_ENETCDF;
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * convert the days from a grd file to netcdf one day at a time, so that only
+ * a single day of data is held in memory. the days are written to an open
+ * netcdf file, starting at time index offset. the number of days which were
+ * converted is stored in ndone, if not NULL. the output file is closed if
+ * anything fails:
+ */
+int imdgrd_stream_days(struct imdgrd_input *input, struct imdgrd_data *data,
+                       struct imdgrd_ncfile *ncfile, int offset, int use_mmap,
+                       int *ndone) {
+  /* grd file reader: */
+  struct imdgrd_reader reader;
+  /* values for a single day: */
+  float *values;
+  /* return status: */
+  int status;
+  /* for loop integers: */
+  int i = 0;
+  /* open the input file: */
+  if ((status = imdgrd_open_reader(input, data, &reader,
+                                   use_mmap)) != IMDGRD_OK) {
+    imdgrd_close_output(ncfile);
+  } else {
+    /* loop through days: */
+    for (i = 0; i < input->days; i++) {
+      /* read the day: */
+      if ((values = imdgrd_read_day(&reader, i)) == NULL) {
+        imdgrd_close_output(ncfile);
+        status = IMDGRD_EREAD;
+        break;
+      }
+      /* write the day: */
+      if ((status = imdgrd_write_day(ncfile, data, offset + i,
+                                     values)) != IMDGRD_OK) {
+        break;
+      }
+    }
+  }
+  /* tidy up: */
+  imdgrd_close_reader(&reader);
+  if (ndone != NULL) {
+    *ndone = i;
+  }
+  /* return: */
+  return status;
+}
+
+/*
+ * move a year and day of the year (from 0) on by a number of days, which
+ * may be negative:
+ */
+static void add_days(int *year, int *day, long ndays) {
+  /* day of the year, which may be outside of the year: */
+  long day_of_year = *day + ndays;
+  while (day_of_year < 0) {
+    *year -= 1;
+    day_of_year += imdgrd_year_days(*year);
+  }
+  while (day_of_year >= imdgrd_year_days(*year)) {
+    day_of_year -= imdgrd_year_days(*year);
+    *year += 1;
+  }
+  *day = day_of_year;
+}
+
+/*
+ * record a netcdf error for a netcdf input file, closing the file. returns
+ * the library error code:
+ */
+static int ncinput_error(struct imdgrd_ncinput *ncinput, int ncerr,
+                         const char *error) {
+  imdgrd_close_ncinput(ncinput);
+  ncinput->ncerr = ncerr;
+  ncinput->error = error;
+  return IMDGRD_ENETCDF;
+}
+
+/*
+ * find the registered grid which the coordinates of a netcdf input file are
+ * points of, and the grid indexes of the first lat and lon. lats may be in
+ * either order. returns 1 if a grid is found:
+ */
+static int find_nc_grid(struct imdgrd_ncinput *ncinput, const float *lats,
+                        const float *lons) {
+  /* grid being checked: */
+  const struct imdgrd_grid *grid;
+  /* grid index of the southernmost lat, and the first lon: */
+  int lat0, lon0;
+  /* for loop integers: */
+  int i, j;
+  /* make sure the built in grids are registered: */
+  pthread_once(&grids_once, register_builtin_grids);
+  ncinput->lat_descending = (ncinput->nlats > 1) && (lats[1] < lats[0]);
+  for (i = 0; i < ngrids; i++) {
+    grid = grids[i];
+    lat0 = grid_index(lats[ncinput->lat_descending ? ncinput->nlats - 1 : 0],
+                      grid->lat0, grid->grid, grid->nlats);
+    lon0 = grid_index(lons[0], grid->lon0, grid->grid, grid->nlons);
+    if ((lat0 == -1) || (lon0 == -1)) {
+      continue;
+    }
+    /* every lat and lon has to be the next point of the grid: */
+    for (j = 0; j < ncinput->nlats; j++) {
+      if (grid_index(lats[j], grid->lat0, grid->grid, grid->nlats) !=
+          lat0 + (ncinput->lat_descending ? ncinput->nlats - 1 - j : j)) {
+        break;
+      }
+    }
+    if (j < ncinput->nlats) {
+      continue;
+    }
+    for (j = 0; j < ncinput->nlons; j++) {
+      if (grid_index(lons[j], grid->lon0, grid->grid, grid->nlons) !=
+          lon0 + j) {
+        break;
+      }
+    }
+    if (j < ncinput->nlons) {
+      continue;
+    }
+    ncinput->grid = grid;
+    ncinput->lat0 = lat0;
+    ncinput->lon0 = lon0;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * check if a year and day of the year (from 0) are before the first day of
+ * the gregorian calendar:
+ */
+static int before_gregorian(int year, int day) {
+  return (year < IMDGRD_GREGORIAN_YEAR) ||
+         ((year == IMDGRD_GREGORIAN_YEAR) && (day < IMDGRD_GREGORIAN_DAY));
+}
+
+/*
+ * find the year and day of the year of the first time value of a netcdf
+ * input file, from the time units, and check that the time values are
+ * consecutive days. days are counted with the gregorian leap year rules,
+ * which the standard and gregorian calendars (proleptic is 0) only follow
+ * from 1582-10-15, so earlier dates are not accepted for them. returns 1 if
+ * the days are consecutive and can be counted:
+ */
+static int get_nc_days(struct imdgrd_ncinput *ncinput, const char *units,
+                       const double *times, int proleptic) {
+  /* time unit, and the date the times are counted from: */
+  char unit[16];
+  int year, month, day;
+  /* days in each time unit: */
+  double unit_days;
+  /* days in each month: */
+  int month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  /* days since the date, for the first time value: */
+  long first;
+  /* for loop integers: */
+  int i;
+  if (sscanf(units, "%15s since %d-%d-%d", unit, &year, &month,
+             &day) != 4) {
+    return 0;
+  }
+  if (strcmp(unit, "days") == 0) {
+    unit_days = 1;
+  } else if (strcmp(unit, "hours") == 0) {
+    unit_days = 1.0 / 24;
+  } else {
+    return 0;
+  }
+  if ((month < 1) || (month > 12) || (day < 1) || (day > 31)) {
+    return 0;
+  }
+  /* days are counted from the start of the day, so times within it are
+     the same day: */
+  first = floor(times[0] * unit_days + 1e-6);
+  for (i = 1; i < ncinput->ndays; i++) {
+    if ((long) floor(times[i] * unit_days + 1e-6) != first + i) {
+      return 0;
+    }
+  }
+  /* day of the year of the date, then of the first time value: */
+  month_days[1] = (imdgrd_year_days(year) == 366) ? 29 : 28;
+  ncinput->year = year;
+  ncinput->day = day - 1;
+  for (i = 0; i < month - 1; i++) {
+    ncinput->day += month_days[i];
+  }
+  if ((proleptic == 0) && before_gregorian(ncinput->year, ncinput->day)) {
+    return 0;
+  }
+  add_days(&ncinput->year, &ncinput->day, first);
+  if ((proleptic == 0) && before_gregorian(ncinput->year, ncinput->day)) {
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * open a netcdf file for reading back as grd, such as an output file of
+ * imdgrd_write_data(), or any file with a variable of daily values on one
+ * of the grids. the data variable is ncvar, or if that is NULL or empty,
+ * the first variable with three dimensions. the dimensions have to be
+ * time, then latitude and longitude (day-major), or latitude, longitude,
+ * then time (time-major). the coordinates can be a subset of the grid, with
+ * lats in either order, and values outside of the subset are read as the
+ * fill value of the grid. the time values have to be consecutive days of
+ * the standard, gregorian or proleptic_gregorian calendar:
+ */
+int imdgrd_open_ncinput(const char *filename, const char *ncvar,
+                        struct imdgrd_ncinput *ncinput) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* netcdf ids and storage type: */
+  int nvars, ndims, dim_ids[3], time_var, lat_var, lon_var, storage;
+  /* dimension names, lengths and chunk sizes: */
+  char dim_names[3][NC_MAX_NAME + 1];
+  size_t dim_lens[3], chunks[3];
+  /* index of the time dimension: */
+  int time_dim;
+  /* time units and calendar, and whether it is proleptic gregorian: */
+  char units[NC_MAX_NAME + 1], calendar[NC_MAX_NAME + 1];
+  size_t att_len;
+  int proleptic = 0;
+  /* coordinate values: */
+  float *lats = NULL, *lons = NULL;
+  double *times = NULL;
+  /* netcdf start and count arrays: */
+  size_t nc_start[1] = {0};
+  size_t nc_count[1];
+  /* number of values in a block of days: */
+  size_t block_count;
+  /* return status: */
+  int status = IMDGRD_OK;
+  /* for loop integers: */
+  int i;
+  /* start time: */
+  double t0 = get_time();
+  ncinput->filename = filename;
+  ncinput->ncid = -1;
+  ncinput->grid = NULL;
+  ncinput->buffer = NULL;
+  ncinput->transposed = NULL;
+  ncinput->ncerr = NC_NOERR;
+  ncinput->error = NULL;
+  ncinput->read_time = 0;
+  ncinput->convert_time = 0;
+  /* open the file: */
+  if ((ncerr = nc_open(filename, NC_NOWRITE, &ncinput->ncid)) != NC_NOERR) {
+    ncinput->ncid = -1;
+    return ncinput_error(ncinput, ncerr, "opening file");
+  }
+  /* find the data variable: */
+  if ((ncvar != NULL) && (strcmp(ncvar, "") != 0)) {
+    ncerr = nc_inq_varid(ncinput->ncid, ncvar, &ncinput->data_var);
+  } else {
+    ncinput->data_var = -1;
+    ncerr = nc_inq_nvars(ncinput->ncid, &nvars);
+    for (i = 0; (ncerr == NC_NOERR) && (i < nvars); i++) {
+      if ((nc_inq_varndims(ncinput->ncid, i, &ndims) == NC_NOERR) &&
+          (ndims == 3)) {
+        ncinput->data_var = i;
+        break;
+      }
+    }
+    if ((ncerr == NC_NOERR) && (ncinput->data_var == -1)) {
+      imdgrd_close_ncinput(ncinput);
+      return IMDGRD_ENCGRID;
+    }
+  }
+  /* get the dimensions: */
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_varndims(ncinput->ncid, ncinput->data_var, &ndims);
+  }
+  if ((ncerr == NC_NOERR) && (ndims != 3)) {
+    imdgrd_close_ncinput(ncinput);
+    return IMDGRD_ENCGRID;
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_vardimid(ncinput->ncid, ncinput->data_var, dim_ids);
+  }
+  for (i = 0; (ncerr == NC_NOERR) && (i < 3); i++) {
+    ncerr = nc_inq_dimname(ncinput->ncid, dim_ids[i], dim_names[i]);
+    if (ncerr == NC_NOERR) {
+      ncerr = nc_inq_dimlen(ncinput->ncid, dim_ids[i], &dim_lens[i]);
+    }
+  }
+  if (ncerr != NC_NOERR) {
+    return ncinput_error(ncinput, ncerr, "reading file");
+  }
+  /* time is the first or last dimension, then latitude and longitude: */
+  if (strcmp(dim_names[0], IMDGRD_NC_TIME_VAR) == 0) {
+    ncinput->layout = IMDGRD_LAYOUT_DAY_MAJOR;
+    time_dim = 0;
+  } else if (strcmp(dim_names[2], IMDGRD_NC_TIME_VAR) == 0) {
+    ncinput->layout = IMDGRD_LAYOUT_TIME_MAJOR;
+    time_dim = 2;
+  } else {
+    imdgrd_close_ncinput(ncinput);
+    return IMDGRD_ENCTIME;
+  }
+  i = (time_dim == 0) ? 1 : 0;
+  if (((strcmp(dim_names[i], IMDGRD_NC_LAT_VAR) != 0) &&
+       (strcmp(dim_names[i], IMDGRD_NC_LAT_NAME) != 0)) ||
+      ((strcmp(dim_names[i + 1], IMDGRD_NC_LON_VAR) != 0) &&
+       (strcmp(dim_names[i + 1], IMDGRD_NC_LON_NAME) != 0)) ||
+      (dim_lens[i] == 0) || (dim_lens[i + 1] == 0)) {
+    imdgrd_close_ncinput(ncinput);
+    return IMDGRD_ENCGRID;
+  }
+  if (dim_lens[time_dim] == 0) {
+    imdgrd_close_ncinput(ncinput);
+    return IMDGRD_ENCTIME;
+  }
+  ncinput->nlats = dim_lens[i];
+  ncinput->nlons = dim_lens[i + 1];
+  ncinput->ndays = dim_lens[time_dim];
+  /* read the coordinates and time units: */
+  ncerr = nc_inq_varid(ncinput->ncid, dim_names[time_dim], &time_var);
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_varid(ncinput->ncid, dim_names[i], &lat_var);
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_inq_varid(ncinput->ncid, dim_names[i + 1], &lon_var);
+  }
+  if ((ncerr == NC_NOERR) &&
+      (((ncerr = nc_inq_attlen(ncinput->ncid, time_var, IMDGRD_NC_UNITS,
+                               &att_len)) != NC_NOERR) ||
+       (att_len > NC_MAX_NAME))) {
+    imdgrd_close_ncinput(ncinput);
+    return IMDGRD_ENCTIME;
+  }
+  if (ncerr == NC_NOERR) {
+    ncerr = nc_get_att_text(ncinput->ncid, time_var, IMDGRD_NC_UNITS, units);
+    units[att_len] = '\0';
+  }
+  if (ncerr != NC_NOERR) {
+    return ncinput_error(ncinput, ncerr, "reading file");
+  }
+  /*
+   * grd files have the days of the gregorian calendar. the standard calendar
+   * is the default, and other calendars, with different leap years or month
+   * lengths, are not accepted:
+   */
+  if ((nc_inq_attlen(ncinput->ncid, time_var, IMDGRD_NC_CAL,
+                     &att_len) == NC_NOERR) && (att_len <= NC_MAX_NAME) &&
+      (nc_get_att_text(ncinput->ncid, time_var, IMDGRD_NC_CAL,
+                       calendar) == NC_NOERR)) {
+    calendar[att_len] = '\0';
+    if ((strcmp(calendar, IMDGRD_NC_CAL_TYPE) != 0) &&
+        (strcmp(calendar, IMDGRD_NC_CAL_GREGORIAN) != 0) &&
+        (strcmp(calendar, IMDGRD_NC_CAL_PROLEPTIC) != 0)) {
+      imdgrd_close_ncinput(ncinput);
+      return IMDGRD_ENCTIME;
+    }
+    proleptic = (strcmp(calendar, IMDGRD_NC_CAL_PROLEPTIC) == 0);
+  }
+  lats = malloc(ncinput->nlats * sizeof(float));
+  lons = malloc(ncinput->nlons * sizeof(float));
+  times = malloc(ncinput->ndays * sizeof(double));
+  if ((lats == NULL) || (lons == NULL) || (times == NULL)) {
+    status = IMDGRD_ENOMEM;
+  } else {
+    nc_count[0] = ncinput->nlats;
+    ncerr = nc_get_vara_float(ncinput->ncid, lat_var, nc_start, nc_count,
+                              lats);
+    if (ncerr == NC_NOERR) {
+      nc_count[0] = ncinput->nlons;
+      ncerr = nc_get_vara_float(ncinput->ncid, lon_var, nc_start, nc_count,
+                                lons);
+    }
+    if (ncerr == NC_NOERR) {
+      nc_count[0] = ncinput->ndays;
+      ncerr = nc_get_vara_double(ncinput->ncid, time_var, nc_start,
+                                 nc_count, times);
+    }
+    if (ncerr != NC_NOERR) {
+      status = IMDGRD_ENETCDF;
+    } else if (find_nc_grid(ncinput, lats, lons) == 0) {
+      status = IMDGRD_ENCGRID;
+    } else if (get_nc_days(ncinput, units, times, proleptic) == 0) {
+      status = IMDGRD_ENCTIME;
+    }
+  }
+  free(lats);
+  free(lons);
+  free(times);
+  if (status == IMDGRD_ENETCDF) {
+    return ncinput_error(ncinput, ncerr, "reading coordinates");
+  } else if (status != IMDGRD_OK) {
+    imdgrd_close_ncinput(ncinput);
+    return status;
+  }
+  /* values which are missing, and unpacking of packed values: */
+  ncinput->has_fill = (nc_get_att_float(ncinput->ncid, ncinput->data_var,
+                                        IMDGRD_NC_FILLV,
+                                        &ncinput->fill) == NC_NOERR);
+  ncinput->has_missing = (nc_get_att_float(ncinput->ncid, ncinput->data_var,
+                                           IMDGRD_NC_MISSING,
+                                           &ncinput->missing) == NC_NOERR);
+  if (nc_get_att_float(ncinput->ncid, ncinput->data_var, IMDGRD_NC_SCALE,
+                       &ncinput->scale) != NC_NOERR) {
+    ncinput->scale = 1;
+  }
+  if (nc_get_att_float(ncinput->ncid, ncinput->data_var, IMDGRD_NC_OFFSET,
+                       &ncinput->offset) != NC_NOERR) {
+    ncinput->offset = 0;
+  }
+  /*
+   * read a chunk of days at a time, so that each chunk is only
+   * decompressed once, or a number of days if each chunk is a single day:
+   */
+  ncerr = nc_inq_var_chunking(ncinput->ncid, ncinput->data_var, &storage,
+                              chunks);
+  if (ncerr != NC_NOERR) {
+    return ncinput_error(ncinput, ncerr, "reading file");
+  }
+  ncinput->block_days = ((storage == NC_CHUNKED) &&
+                         (chunks[time_dim] > 1)) ?
+                        chunks[time_dim] : IMDGRD_NC_READ_DAYS;
+  if (ncinput->block_days > (size_t) ncinput->ndays) {
+    ncinput->block_days = ncinput->ndays;
+  }
+  block_count = ncinput->block_days * ncinput->nlats * ncinput->nlons;
+  ncinput->buffer = malloc(block_count * sizeof(float));
+  if ((ncinput->buffer == NULL) ||
+      ((ncinput->layout == IMDGRD_LAYOUT_TIME_MAJOR) &&
+       ((ncinput->transposed = malloc(block_count *
+                                      sizeof(float))) == NULL))) {
+    imdgrd_close_ncinput(ncinput);
+    return IMDGRD_ENOMEM;
+  }
+  ncinput->read_time = get_time() - t0;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * read a block of days from a netcdf input file, and convert them to grd
+ * values for the whole grid:
+ */
+static int read_nc_block(struct imdgrd_ncinput *ncinput, int first_day,
+                         int ndays, float *values) {
+  /* netcdf function return values: */
+  int ncerr;
+  /* grid of the data: */
+  const struct imdgrd_grid *grid = ncinput->grid;
+  /* number of values in a day, in the file and for the grid: */
+  size_t count = (size_t) ncinput->nlats * ncinput->nlons;
+  size_t grid_count = (size_t) grid->nlats * grid->nlons;
+  /* netcdf start and count arrays: */
+  size_t nc_count[3];
+  size_t nc_start[3];
+  /* values for each day, in the file's rows: */
+  const float *rows;
+  /* row of values being converted, and where they go in the grid: */
+  const float *row;
+  float *dest;
+  /* value being converted: */
+  float value;
+  /* start times of reading and converting the values: */
+  double t0 = get_time(), t1;
+  /* for loop integers: */
+  size_t i;
+  int day, j, k;
+  /* read the values: */
+  if (ncinput->layout == IMDGRD_LAYOUT_TIME_MAJOR) {
+    nc_start[0] = 0;
+    nc_start[1] = 0;
+    nc_start[2] = first_day;
+    nc_count[0] = ncinput->nlats;
+    nc_count[1] = ncinput->nlons;
+    nc_count[2] = ndays;
+  } else {
+    nc_start[0] = first_day;
+    nc_start[1] = 0;
+    nc_start[2] = 0;
+    nc_count[0] = ndays;
+    nc_count[1] = ncinput->nlats;
+    nc_count[2] = ncinput->nlons;
+  }
+  ncerr = nc_get_vara_float(ncinput->ncid, ncinput->data_var, nc_start,
+                            nc_count, ncinput->buffer);
+  t1 = get_time();
+  ncinput->read_time += t1 - t0;
+  if (ncerr != NC_NOERR) {
+    return ncinput_error(ncinput, ncerr, "reading data values");
+  }
+  /* time series for each grid point are transposed in to days: */
+  if (ncinput->layout == IMDGRD_LAYOUT_TIME_MAJOR) {
+    imdgrd_transpose_values(ncinput->buffer, ncinput->transposed, count,
+                            ndays, sizeof(float));
+    rows = ncinput->transposed;
+  } else {
+    rows = ncinput->buffer;
+  }
+  /* grid points outside of the file are missing: */
+  if (count < grid_count) {
+    for (i = 0; i < ndays * grid_count; i++) {
+      values[i] = grid->fill;
+    }
+  }
+  /*
+   * copy each row to its place in the grid, with missing values set to the
+   * fill value of the grid, and packed values unpacked:
+   */
+  for (day = 0; day < ndays; day++) {
+    for (j = 0; j < ncinput->nlats; j++) {
+      row = rows + ((size_t) day * ncinput->nlats + j) * ncinput->nlons;
+      dest = values + (size_t) day * grid_count +
+             (size_t) (ncinput->lat0 + (ncinput->lat_descending ?
+                                        ncinput->nlats - 1 - j : j)) *
+             grid->nlons + ncinput->lon0;
+#pragma omp simd
+      for (k = 0; k < ncinput->nlons; k++) {
+        value = row[k];
+        dest[k] = ((value != value) ||
+                   (ncinput->has_fill && (value == ncinput->fill)) ||
+                   (ncinput->has_missing && (value == ncinput->missing))) ?
+                  grid->fill : value * ncinput->scale + ncinput->offset;
+      }
+    }
+  }
+  ncinput->convert_time += get_time() - t1;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * read days from a netcdf input file, as grd values, i.e. each day of
+ * values for the whole grid, in rows from the first lat. values has to hold
+ * ndays days. days are read a block at a time, so reads are fastest when
+ * first_day is a multiple of block_days. on an error, the file is closed:
+ */
+int imdgrd_read_ncinput(struct imdgrd_ncinput *ncinput, int first_day,
+                        int ndays, float *values) {
+  /* number of values in a day for the grid: */
+  size_t grid_count = (size_t) ncinput->grid->nlats * ncinput->grid->nlons;
+  /* number of days in the next read: */
+  int n;
+  /* return status: */
+  int status;
+  if ((first_day < 0) || (ndays < 0) ||
+      (first_day + ndays > ncinput->ndays)) {
+    return IMDGRD_EPOINT;
+  }
+  while (ndays > 0) {
+    /* read up to the end of the block containing the first day: */
+    n = ncinput->block_days - first_day % ncinput->block_days;
+    n = (n < ndays) ? n : ndays;
+    if ((status = read_nc_block(ncinput, first_day, n,
+                                values)) != IMDGRD_OK) {
+      return status;
+    }
+    first_day += n;
+    ndays -= n;
+    values += n * grid_count;
+  }
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/* close a netcdf input file, and free the buffers: */
+void imdgrd_close_ncinput(struct imdgrd_ncinput *ncinput) {
+  if (ncinput->ncid != -1) {
+    nc_close(ncinput->ncid);
+    ncinput->ncid = -1;
+  }
+  free(ncinput->buffer);
+  free(ncinput->transposed);
+  ncinput->buffer = NULL;
+  ncinput->transposed = NULL;
+}
+
+/*
+ * define struct for the header of a file of cached regridding weights. the
+ * grids identify the weights, and the header is followed by the rows,
+ * columns and weights, and an xxh64 hash of everything before it:
+ */
+struct imdgrd_regrid_header {
+  /* IMDGRD_REGRID_MAGIC, without the terminating null, and
+     IMDGRD_REGRID_VERSION: */
+  char magic[8];
+  uint32_t version;
+  /* source and target grids (lat0, lon0 and grid size), and numbers of lats
+     and lons: */
+  float source[3];
+  int32_t source_nlats;
+  int32_t source_nlons;
+  float target[3];
+  int32_t target_nlats;
+  int32_t target_nlons;
+  /* number of weights: */
+  uint64_t nweights;
+};
+
+/*
+ * define struct for a range of days regridded by a thread. each thread
+ * regrids its own days, so no locking is needed:
+ */
+struct imdgrd_regrid_days {
+  /* regridding weights: */
+  struct imdgrd_regrid *regrid;
+  /* values for the first day, and regridded values for the first day: */
+  const float *values;
+  float *regridded;
+  /* number of days, and fill value: */
+  size_t ndays;
+  float fill;
+};
+
+/* set up a regrid struct for regridding to the target grid: */
+void imdgrd_init_regrid(struct imdgrd_regrid *regrid,
+                        const struct imdgrd_grid *target,
+                        const char *cache_dir, int threads) {
+  regrid->target = target;
+  regrid->cache_dir = cache_dir;
+  regrid->threads = threads;
+  regrid->source[0] = 0;
+  regrid->source[1] = 0;
+  regrid->source[2] = 0;
+  regrid->source_nlats = 0;
+  regrid->source_nlons = 0;
+  regrid->ntarget = (size_t) target->nlats * target->nlons;
+  regrid->nweights = 0;
+  regrid->rows = NULL;
+  regrid->columns = NULL;
+  regrid->weights = NULL;
+  regrid->cached = 0;
+  regrid->weights_time = 0;
+}
+
+/* free the weights held by a regrid struct: */
+void imdgrd_free_regrid(struct imdgrd_regrid *regrid) {
+  free(regrid->rows);
+  free(regrid->columns);
+  free(regrid->weights);
+  regrid->rows = NULL;
+  regrid->columns = NULL;
+  regrid->weights = NULL;
+  regrid->nweights = 0;
+  regrid->source_nlats = 0;
+  regrid->source_nlons = 0;
+}
+
+/*
+ * set the header of a cache file for weights from the grid of data to the
+ * target grid. the number of weights is left as 0:
+ */
+static void regrid_header(struct imdgrd_regrid *regrid,
+                          struct imdgrd_data *data,
+                          struct imdgrd_regrid_header *header) {
+  /* target grid: */
+  const struct imdgrd_grid *target = regrid->target;
+  /* padding is zeroed, so that headers can be compared and hashed: */
+  memset(header, 0, sizeof(struct imdgrd_regrid_header));
+  memcpy(header->magic, IMDGRD_REGRID_MAGIC, sizeof(header->magic));
+  header->version = IMDGRD_REGRID_VERSION;
+  header->source[0] = data->lat0;
+  header->source[1] = data->lon0;
+  header->source[2] = data->grid;
+  header->source_nlats = data->nlats;
+  header->source_nlons = data->nlons;
+  header->target[0] = target->lat0;
+  header->target[1] = target->lon0;
+  header->target[2] = target->grid;
+  header->target_nlats = target->nlats;
+  header->target_nlons = target->nlons;
+}
+
+/*
+ * return the area of a grid cell, or the part of one, between two lats and
+ * two lons. the area is proportional to the difference in the sine of the
+ * lats, and only ratios of areas are used:
+ */
+static double cell_area(double lat0, double lat1, double lon0, double lon1) {
+  return (sin(lat1 * IMDGRD_DEG_TO_RAD) - sin(lat0 * IMDGRD_DEG_TO_RAD)) *
+         (lon1 - lon0);
+}
+
+/*
+ * calculate the weights for regridding from the grid of data to the target
+ * grid. each grid point is the centre of a cell, a grid size across, and
+ * cells are clipped at the poles. the weight of a source grid point for a
+ * target grid point is the fraction of the area of the target cell which
+ * the source cell covers:
+ */
+static int calc_weights(struct imdgrd_regrid *regrid,
+                        struct imdgrd_data *data) {
+  /* target grid: */
+  const struct imdgrd_grid *target = regrid->target;
+  /* half of the source and target grid sizes: */
+  double half = data->grid / 2.0;
+  double target_half = target->grid / 2.0;
+  /* most source lats or lons which the cell of a target grid point can
+     overlap: */
+  size_t span = (size_t) ceil(target->grid / data->grid) + 2;
+  /* weights, and number of weights: */
+  uint32_t *rows, *columns;
+  float *weights;
+  size_t n = 0;
+  /* bounds of the target cell, and of its overlap with a source cell: */
+  double lat0, lat1, lon0, lon1, olat0, olat1, olon0, olon1;
+  /* area of the target cell, and weight of a source grid point: */
+  double area, weight;
+  /* first and last source lats and lons which may overlap the target
+     cell: */
+  long i0, i1, j0, j1;
+  /* for loop integers: */
+  long i, j;
+  int ti, tj;
+  /* allocate for the most weights there can be: */
+  if ((double) regrid->ntarget * span * span > UINT32_MAX) {
+    return IMDGRD_ENOMEM;
+  }
+  rows = malloc((regrid->ntarget + 1) * sizeof(uint32_t));
+  columns = malloc(regrid->ntarget * span * span * sizeof(uint32_t));
+  weights = malloc(regrid->ntarget * span * span * sizeof(float));
+  if ((rows == NULL) || (columns == NULL) || (weights == NULL)) {
+    free(rows);
+    free(columns);
+    free(weights);
+    return IMDGRD_ENOMEM;
+  }
+  for (ti = 0; ti < target->nlats; ti++) {
+    lat0 = fmax(target->lat0 + ti * target->grid - target_half, -90);
+    lat1 = fmin(target->lat0 + ti * target->grid + target_half, 90);
+    i0 = (long) floor((lat0 - (data->lat0 - half)) / data->grid);
+    i1 = (long) floor((lat1 - (data->lat0 - half)) / data->grid);
+    i0 = (i0 < 0) ? 0 : i0;
+    i1 = (i1 >= data->nlats) ? data->nlats - 1 : i1;
+    for (tj = 0; tj < target->nlons; tj++) {
+      lon0 = target->lon0 + tj * target->grid - target_half;
+      lon1 = target->lon0 + tj * target->grid + target_half;
+      j0 = (long) floor((lon0 - (data->lon0 - half)) / data->grid);
+      j1 = (long) floor((lon1 - (data->lon0 - half)) / data->grid);
+      j0 = (j0 < 0) ? 0 : j0;
+      j1 = (j1 >= data->nlons) ? data->nlons - 1 : j1;
+      rows[ti * target->nlons + tj] = n;
+      area = cell_area(lat0, lat1, lon0, lon1);
+      if (area <= 0) {
+        continue;
+      }
+      for (i = i0; i <= i1; i++) {
+        olat0 = fmax(lat0, data->lat0 + i * data->grid - half);
+        olat1 = fmin(lat1, data->lat0 + i * data->grid + half);
+        if (olat1 <= olat0) {
+          continue;
+        }
+        for (j = j0; j <= j1; j++) {
+          olon0 = fmax(lon0, data->lon0 + j * data->grid - half);
+          olon1 = fmin(lon1, data->lon0 + j * data->grid + half);
+          if (olon1 <= olon0) {
+            continue;
+          }
+          weight = cell_area(olat0, olat1, olon0, olon1) / area;
+          if (weight < IMDGRD_REGRID_MIN_WEIGHT) {
+            continue;
+          }
+          columns[n] = i * data->nlons + j;
+          weights[n] = weight;
+          n++;
+        }
+      }
+    }
+  }
+  rows[regrid->ntarget] = n;
+  /* give back the memory which is not needed: */
+  if (n > 0) {
+    columns = realloc(columns, n * sizeof(uint32_t));
+    weights = realloc(weights, n * sizeof(float));
+  }
+  regrid->rows = rows;
+  regrid->columns = columns;
+  regrid->weights = weights;
+  regrid->nweights = n;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * read weights from a cache file, if it is for the grids in header and is
+ * complete. returns IMDGRD_OK if the weights have been read:
+ */
+static int read_weights(struct imdgrd_regrid *regrid, const char *path,
+                        const struct imdgrd_regrid_header *header) {
+  /* cache file, and its header: */
+  FILE *cache_file;
+  struct imdgrd_regrid_header file_header;
+  /* hash of the file, and the hash stored in it: */
+  struct imdgrd_hash_state state;
+  uint64_t hash;
+  /* number of source grid points: */
+  uint32_t nsource = header->source_nlats * header->source_nlons;
+  /* weights: */
+  uint32_t *rows = NULL, *columns = NULL;
+  float *weights = NULL;
+  size_t nrows = regrid->ntarget + 1, nweights;
+  /* return status: */
+  int status = IMDGRD_EREAD;
+  /* for loop integers: */
+  size_t i;
+  /* the grids have to match: */
+  if ((cache_file = fopen(path, "rb")) == NULL) {
+    return IMDGRD_EOPEN;
+  }
+  if ((fread(&file_header, sizeof(file_header), 1, cache_file) != 1) ||
+      (memcmp(&file_header, header,
+              offsetof(struct imdgrd_regrid_header, nweights)) != 0) ||
+      (file_header.nweights > UINT32_MAX)) {
+    fclose(cache_file);
+    return IMDGRD_EREAD;
+  }
+  nweights = file_header.nweights;
+  rows = malloc(nrows * sizeof(uint32_t));
+  columns = malloc((nweights > 0 ? nweights : 1) * sizeof(uint32_t));
+  weights = malloc((nweights > 0 ? nweights : 1) * sizeof(float));
+  if ((rows == NULL) || (columns == NULL) || (weights == NULL)) {
+    status = IMDGRD_ENOMEM;
+  } else if ((fread(rows, sizeof(uint32_t), nrows, cache_file) == nrows) &&
+             (fread(columns, sizeof(uint32_t), nweights,
+                    cache_file) == nweights) &&
+             (fread(weights, sizeof(float), nweights,
+                    cache_file) == nweights) &&
+             (fread(&hash, sizeof(hash), 1, cache_file) == 1)) {
+    /* check the hash, and that the rows and columns are in range: */
+    hash_init(&state);
+    hash_update(&state, (const unsigned char *) &file_header,
+                sizeof(file_header));
+    hash_update(&state, (const unsigned char *) rows,
+                nrows * sizeof(uint32_t));
+    hash_update(&state, (const unsigned char *) columns,
+                nweights * sizeof(uint32_t));
+    hash_update(&state, (const unsigned char *) weights,
+                nweights * sizeof(float));
+    if ((hash_digest(&state) == hash) && (rows[0] == 0) &&
+        (rows[nrows - 1] == nweights)) {
+      status = IMDGRD_OK;
+    }
+    for (i = 1; (status == IMDGRD_OK) && (i < nrows); i++) {
+      status = (rows[i] < rows[i - 1]) ? IMDGRD_EREAD : status;
+    }
+    for (i = 0; (status == IMDGRD_OK) && (i < nweights); i++) {
+      status = (columns[i] >= nsource) ? IMDGRD_EREAD : status;
+    }
+  }
+  fclose(cache_file);
+  if (status != IMDGRD_OK) {
+    free(rows);
+    free(columns);
+    free(weights);
+    return status;
+  }
+  regrid->rows = rows;
+  regrid->columns = columns;
+  regrid->weights = weights;
+  regrid->nweights = nweights;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/* create a directory, and any parent directories which do not exist: */
+static void make_dirs(const char *path) {
+  /* copy of the path, which is cut at each separator: */
+  char *dirs = strdup(path);
+  /* separator: */
+  char *sep;
+  if (dirs == NULL) {
+    return;
+  }
+  for (sep = strchr(dirs + 1, '/'); sep != NULL; sep = strchr(sep + 1, '/')) {
+    *sep = '\0';
+    mkdir(dirs, 0777);
+    *sep = '/';
+  }
+  mkdir(dirs, 0777);
+  free(dirs);
+}
+
+/*
+ * write weights to a cache file. the file is written under a temporary name
+ * and renamed, so that processes regridding at the same time never read a
+ * partly written file. the cache only saves time, so errors are ignored:
+ */
+static void write_weights(struct imdgrd_regrid *regrid, const char *path,
+                          struct imdgrd_regrid_header *header) {
+  /* temporary file name, and cache file: */
+  char *temp_path;
+  FILE *cache_file;
+  /* hash of the file: */
+  struct imdgrd_hash_state state;
+  uint64_t hash;
+  /* number of rows: */
+  size_t nrows = regrid->ntarget + 1;
+  /* whether the file has been written: */
+  int written;
+  if ((temp_path = malloc(strlen(path) + 32)) == NULL) {
+    return;
+  }
+  sprintf(temp_path, "%s.%ld", path, (long) getpid());
+  if ((cache_file = fopen(temp_path, "wb")) == NULL) {
+    free(temp_path);
+    return;
+  }
+  header->nweights = regrid->nweights;
+  hash_init(&state);
+  hash_update(&state, (const unsigned char *) header,
+              sizeof(struct imdgrd_regrid_header));
+  hash_update(&state, (const unsigned char *) regrid->rows,
+              nrows * sizeof(uint32_t));
+  hash_update(&state, (const unsigned char *) regrid->columns,
+              regrid->nweights * sizeof(uint32_t));
+  hash_update(&state, (const unsigned char *) regrid->weights,
+              regrid->nweights * sizeof(float));
+  hash = hash_digest(&state);
+  written = (fwrite(header, sizeof(struct imdgrd_regrid_header), 1,
+                    cache_file) == 1) &&
+            (fwrite(regrid->rows, sizeof(uint32_t), nrows,
+                    cache_file) == nrows) &&
+            (fwrite(regrid->columns, sizeof(uint32_t), regrid->nweights,
+                    cache_file) == regrid->nweights) &&
+            (fwrite(regrid->weights, sizeof(float), regrid->nweights,
+                    cache_file) == regrid->nweights) &&
+            (fwrite(&hash, sizeof(hash), 1, cache_file) == 1);
+  written = (fclose(cache_file) == 0) && written;
+  if ((written == 0) || (rename(temp_path, path) != 0)) {
+    unlink(temp_path);
+  }
+  free(temp_path);
+}
+
+/*
+ * get the weights for regridding from the grid of data to the target grid.
+ * nothing is done if the weights are already for this grid. otherwise, the
+ * weights are read from the cache directory, or calculated and saved
+ * there:
+ */
+int imdgrd_regrid_weights(struct imdgrd_regrid *regrid,
+                          struct imdgrd_data *data) {
+  /* header identifying the weights: */
+  struct imdgrd_regrid_header header;
+  /* hash of the header, for the cache file name: */
+  struct imdgrd_hash_state state;
+  char name[64];
+  /* cache file: */
+  char *path = NULL;
+  /* return status: */
+  int status;
+  /* start time: */
+  double t0 = get_time();
+  if ((regrid->rows != NULL) && (regrid->source_nlats == data->nlats) &&
+      (regrid->source_nlons == data->nlons) &&
+      (regrid->source[0] == data->lat0) &&
+      (regrid->source[1] == data->lon0) &&
+      (regrid->source[2] == data->grid)) {
+    return IMDGRD_OK;
+  }
+  imdgrd_free_regrid(regrid);
+  regrid_header(regrid, data, &header);
+  /* the cache file is named from a hash of the grids: */
+  if (regrid->cache_dir != NULL) {
+    hash_init(&state);
+    hash_update(&state, (const unsigned char *) &header, sizeof(header));
+    snprintf(name, sizeof(name), "%s%016llx%s", IMDGRD_REGRID_CACHE_PREFIX,
+             (unsigned long long) hash_digest(&state),
+             IMDGRD_REGRID_CACHE_EXT);
+    if ((path = join_path(regrid->cache_dir, name)) == NULL) {
+      return IMDGRD_ENOMEM;
+    }
+  }
+  /* read the weights, or calculate and save them: */
+  regrid->cached = 0;
+  if ((path != NULL) && (read_weights(regrid, path, &header) == IMDGRD_OK)) {
+    regrid->cached = 1;
+  } else if ((status = calc_weights(regrid, data)) != IMDGRD_OK) {
+    free(path);
+    return status;
+  } else if (path != NULL) {
+    make_dirs(regrid->cache_dir);
+    write_weights(regrid, path, &header);
+  }
+  free(path);
+  /* store the grid the weights are for: */
+  regrid->source[0] = data->lat0;
+  regrid->source[1] = data->lon0;
+  regrid->source[2] = data->grid;
+  regrid->source_nlats = data->nlats;
+  regrid->source_nlons = data->nlons;
+  regrid->weights_time += get_time() - t0;
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * set up a data struct for values regridded from data, on the target grid,
+ * with the same data type, year, days and fill value, but without any data
+ * values. the weights are also set up for the grid of data:
+ */
+int imdgrd_init_regrid_data(struct imdgrd_regrid *regrid,
+                            struct imdgrd_data *data,
+                            struct imdgrd_data *target) {
+  /* target grid: */
+  const struct imdgrd_grid *grid = regrid->target;
+  /* return status: */
+  int status;
+  /* for loop integers: */
+  int i;
+  /* get the weights: */
+  if ((status = imdgrd_regrid_weights(regrid, data)) != IMDGRD_OK) {
+    return status;
+  }
+  /* set up the data struct from the target grid: */
+  target->type = data->type;
+  target->grid = grid->grid;
+  target->nlats = grid->nlats;
+  target->nlons = grid->nlons;
+  target->lat0 = grid->lat0;
+  target->lon0 = grid->lon0;
+  target->year = data->year;
+  target->ndays = data->ndays;
+  target->datasize = sizeof(float);
+  target->fill = data->fill;
+  target->lats = calloc(target->nlats, sizeof(float));
+  target->lons = calloc(target->nlons, sizeof(float));
+  target->days = calloc(target->ndays, sizeof(float));
+  target->data = NULL;
+  target->data_alloc = 0;
+  target->map = NULL;
+  target->map_size = 0;
+  target->grid_nlats = target->nlats;
+  target->grid_nlons = target->nlons;
+  target->lat_start = 0;
+  target->lon_start = 0;
+  target->mask = NULL;
+  if ((target->lats == NULL) || (target->lons == NULL) ||
+      (target->days == NULL)) {
+    imdgrd_free_data(target);
+    return IMDGRD_ENOMEM;
+  }
+  /* store the lat, lon and day values: */
+  for (i = 0; i < target->nlats; i++) {
+    target->lats[i] = target->lat0 + (i * target->grid);
+  }
+  for (i = 0; i < target->nlons; i++) {
+    target->lons[i] = target->lon0 + (i * target->grid);
+  }
+  memcpy(target->days, data->days, target->ndays * sizeof(float));
+  /* return: */
+  return IMDGRD_OK;
+}
+
+/*
+ * regrid the values for a single day, as a sparse matrix vector product.
+ * fill values are left out, and the sum of the weights of the values used
+ * is the fraction of the target cell they cover. target grid points which
+ * are covered less than IMDGRD_REGRID_MIN_COVERAGE are set to the fill
+ * value. the inner loop is written without branches, so that the compiler
+ * can vectorise it, with gathers of the source values where available:
+ */
+SIMD_CLONES
+static void regrid_day(const struct imdgrd_regrid *regrid, const float *values,
+                       float *regridded, float fill) {
+  /* weights: */
+  const uint32_t *rows = regrid->rows;
+  const uint32_t *columns = regrid->columns;
+  const float *weights = regrid->weights;
+  /* source value and its weight, and weighted sum and coverage for a
+     target grid point: */
+  float value, weight, sum, coverage;
+  /* for loop integers: */
+  size_t i;
+  uint32_t k;
+  for (i = 0; i < regrid->ntarget; i++) {
+    sum = 0;
+    coverage = 0;
+#pragma omp simd reduction(+:sum, coverage)
+    for (k = rows[i]; k < rows[i + 1]; k++) {
+      value = values[columns[k]];
+      weight = (value != fill) ? weights[k] : 0;
+      sum += weight * value;
+      coverage += weight;
+    }
+    regridded[i] = (coverage >= IMDGRD_REGRID_MIN_COVERAGE) ?
+                   sum / coverage : fill;
+  }
+}
+
+/* regrid a range of days, in a thread: */
+static void *regrid_worker(void *arg) {
+  /* days to regrid: */
+  struct imdgrd_regrid_days *days = arg;
+  /* number of values in a source and a target day: */
+  size_t nsource = (size_t) days->regrid->source_nlats *
+                   days->regrid->source_nlons;
+  size_t ntarget = days->regrid->ntarget;
+  /* for loop integers: */
+  size_t i;
+  for (i = 0; i < days->ndays; i++) {
+    regrid_day(days->regrid, days->values + i * nsource,
+               days->regridded + i * ntarget, days->fill);
+  }
+  return NULL;
+}
+
+/*
+ * regrid ndays days of values, on the grid the weights are for, to the
+ * target grid. the days are split between the threads, and fill values are
+ * not used:
+ */
+void imdgrd_regrid_values(struct imdgrd_regrid *regrid, const float *values,
+                          float *regridded, size_t ndays, float fill) {
+  /* days for each thread, and the threads: */
+  struct imdgrd_regrid_days days[IMDGRD_REGRID_MAX_THREADS];
+  pthread_t threads[IMDGRD_REGRID_MAX_THREADS];
+  /* number of threads, and number started: */
+  int nthreads, started;
+  /* number of values in a source day, and first day for a thread: */
+  size_t nsource = (size_t) regrid->source_nlats * regrid->source_nlons;
+  size_t first_day = 0;
+  /* for loop integers: */
+  int i;
+  /* one thread per processor, by default, but no more than there are
+     days: */
+  nthreads = (regrid->threads > 0) ? regrid->threads :
+             (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (nthreads > IMDGRD_REGRID_MAX_THREADS) {
+    nthreads = IMDGRD_REGRID_MAX_THREADS;
+  }
+  if ((size_t) nthreads > ndays) {
+    nthreads = ndays;
+  }
+  if (nthreads < 1) {
+    nthreads = 1;
+  }
+  for (i = 0; i < nthreads; i++) {
+    days[i].regrid = regrid;
+    days[i].values = values + first_day * nsource;
+    days[i].regridded = regridded + first_day * regrid->ntarget;
+    days[i].ndays = ndays * (i + 1) / nthreads - first_day;
+    days[i].fill = fill;
+    first_day += days[i].ndays;
+  }
+  /*
+   * this thread regrids the first days, and the days of any threads which
+   * can not be started:
+   */
+  for (i = 1; i < nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, regrid_worker, &days[i]) != 0) {
+      break;
+    }
+  }
+  started = i;
+  regrid_worker(&days[0]);
+  for (i = started; i < nthreads; i++) {
+    regrid_worker(&days[i]);
+  }
+  for (i = 1; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
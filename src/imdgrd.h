@@ -0,0 +1,860 @@
+/*
+ * libimdgrd, for reading IMD GRD files and writing the data to NetCDF.
+ *
+ * library functions do not exit or print anything. errors are returned as
+ * IMDGRD_* error codes, which can be described with imdgrd_strerror(). for
+ * NetCDF errors, the NetCDF error code and a description of the operation
+ * which failed are stored in the _ncfile struct.
+ */
+#ifndef IMDGRD_H
+#define IMDGRD_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+/* error codes: */
+#define IMDGRD_OK 0
+#define IMDGRD_ENOINPUT 1
+#define IMDGRD_ENOFILE 2
+#define IMDGRD_ESIZE 3
+#define IMDGRD_ETEMP 4
+#define IMDGRD_ETYPE 5
+#define IMDGRD_ENOYEAR 6
+#define IMDGRD_ELEAP 7
+#define IMDGRD_ENOTLEAP 8
+#define IMDGRD_EVALUE 9
+#define IMDGRD_EOPEN 10
+#define IMDGRD_EMAP 11
+#define IMDGRD_EREAD 12
+#define IMDGRD_ENOMEM 13
+#define IMDGRD_ENETCDF 14
+#define IMDGRD_EGRIDFILE 15
+#define IMDGRD_EGRID 16
+#define IMDGRD_ESUBSET 17
+#define IMDGRD_EMASK 18
+#define IMDGRD_ESTATS 19
+#define IMDGRD_ESOURCE 20
+#define IMDGRD_EAPPEND 21
+#define IMDGRD_EZARR 22
+#define IMDGRD_EPOINT 23
+#define IMDGRD_ENCGRID 24
+#define IMDGRD_ENCTIME 25
+#define IMDGRD_EREGRID 26
+#define IMDGRD_ECOMPRESS 27
+
+/* data types: */
+#define IMDGRD_RAIN 0
+#define IMDGRD_TEMP 1
+#define IMDGRD_MINTEMP 2
+#define IMDGRD_MAXTEMP 3
+extern const char *imdgrd_data_types[];
+
+/* default output variable names: */
+extern const char *imdgrd_nc_vars[];
+
+/* default output units: */
+extern const char *imdgrd_nc_units[];
+
+/* define struct for describing a grid of values in a grd file: */
+struct imdgrd_grid {
+  /* name of the grid: */
+  const char *name;
+  /* data type: */
+  int type;
+  /* initial lat and lon values: */
+  float lat0;
+  float lon0;
+  /* grid size: */
+  float grid;
+  /* number of lats and lons: */
+  int nlats;
+  int nlons;
+  /* fill value: */
+  float fill;
+  /* variable name and units for netcdf output, or NULL for the defaults: */
+  const char *ncvar;
+  const char *ncunits;
+};
+/* built in grids: */
+extern const struct imdgrd_grid imdgrd_builtin_grids[];
+/* maximum number of grids, and number of slots in the grid lookup table: */
+#define IMDGRD_MAX_GRIDS 64
+#define IMDGRD_GRID_TABLE_SIZE 256
+/* environment variable containing the name of a grid file to load: */
+#define IMDGRD_GRIDS_ENV "IMDGRD_GRIDS"
+/*
+ * name of the mask variable in a mask file, and tolerance for matching
+ * coordinates to grid points, as a fraction of the grid size:
+ */
+#define IMDGRD_MASK_VAR "mask"
+#define IMDGRD_SUBSET_TOLERANCE 0.01
+
+/* output precision types: */
+#define IMDGRD_PRECISION_FLOAT 0
+#define IMDGRD_PRECISION_SHORT 1
+#define IMDGRD_PRECISION_BITS 2
+/* maximum number of mantissa bits in a float: */
+#define IMDGRD_FLOAT_MANTISSA_BITS 23
+/*
+ * scale factors and offsets for packing data in to shorts, i.e. rainfall to
+ * 0.1 mm and temperature to 0.01 celsius:
+ */
+extern const float imdgrd_pack_scales[];
+extern const float imdgrd_pack_offsets[];
+/* fill value for packed data: */
+extern const short imdgrd_pack_fill;
+/* minimum and maximum valid packed values: */
+#define IMDGRD_PACK_MIN -32766
+#define IMDGRD_PACK_MAX 32767
+
+/* chunk layouts for the netcdf data variable: */
+#define IMDGRD_CHUNK_DEFAULT 0
+#define IMDGRD_CHUNK_MAP 1
+#define IMDGRD_CHUNK_TIMESERIES 2
+#define IMDGRD_CHUNK_CUSTOM 3
+extern const char *imdgrd_chunk_layouts[];
+/* lat and lon size of chunks, and maximum days, for the timeseries layout: */
+#define IMDGRD_TIMESERIES_CHUNK_TILE 8
+#define IMDGRD_TIMESERIES_CHUNK_DAYS 366
+
+/*
+ * order of the dimensions of the netcdf data variable. day-major is (time,
+ * lat, lon), as in the grd file. time-major is (lat, lon, time), so that the
+ * values for each grid point are contiguous:
+ */
+#define IMDGRD_LAYOUT_DAY_MAJOR 0
+#define IMDGRD_LAYOUT_TIME_MAJOR 1
+extern const char *imdgrd_layout_names[];
+/* size of the square tiles of values transposed at a time: */
+#define IMDGRD_TRANSPOSE_TILE 32
+
+/*
+ * fraction of a target grid cell which has to be covered by valid values
+ * for a regridded value, rather than the fill value, and smallest weight
+ * kept, so that cells which only touch are not counted as overlapping:
+ */
+#define IMDGRD_REGRID_MIN_COVERAGE 0.5
+#define IMDGRD_REGRID_MIN_WEIGHT 1e-6
+/* radians in a degree, for the areas of grid cells: */
+#define IMDGRD_DEG_TO_RAD 0.017453292519943295
+/*
+ * environment variable containing the directory for cached regridding
+ * weights, and the start and extension of the names of the cache files:
+ */
+#define IMDGRD_REGRID_CACHE_ENV "IMDGRD_REGRID_CACHE"
+#define IMDGRD_REGRID_CACHE_PREFIX "regrid_"
+#define IMDGRD_REGRID_CACHE_EXT ".weights"
+/* identifier and version at the start of a cache file: */
+#define IMDGRD_REGRID_MAGIC "IMDGRDRW"
+#define IMDGRD_REGRID_VERSION 1
+/* maximum number of threads regridding days: */
+#define IMDGRD_REGRID_MAX_THREADS 256
+
+/* compression codecs for the netcdf data variable: */
+#define IMDGRD_CODEC_NONE 0
+#define IMDGRD_CODEC_DEFLATE 1
+#define IMDGRD_CODEC_ZSTD 2
+#define IMDGRD_CODEC_SZIP 3
+#define IMDGRD_CODEC_BLOSC 4
+extern const char *imdgrd_codec_names[];
+/* default compression levels for each codec: */
+extern const int imdgrd_codec_levels[];
+/* szip options mask and pixels per block: */
+#define IMDGRD_SZIP_OPTIONS 32
+#define IMDGRD_SZIP_PIXELS 32
+
+/* define struct for storing input file information: */
+struct imdgrd_input {
+  /* input file name: */
+  const char *filename;
+  /* file size: */
+  int size;
+  /* data type. rainfall = 0, temperature = 1: */
+  int type;
+  /* number of days in year: */
+  int days;
+  /* input data year: */
+  int year;
+  /* indicates year has been matched from file name: */
+  int year_match;
+  /* grid of values in the file: */
+  const struct imdgrd_grid *grid;
+  /* whether values in the file need byte swapping: */
+  int swap;
+  /*
+   * whether the file was opened as possibly holding only the first days of
+   * a year, so that the number of days does not show whether it is a leap
+   * year:
+   */
+  int partial;
+};
+extern const struct imdgrd_input IMDGRD_DEFAULT_INPUT;
+
+/* define struct for storing output file information: */
+struct imdgrd_output {
+  /* output file name: */
+  char *filename;
+  /* variable name for netcdf output: */
+  const char *ncvar;
+  /* units for netcdf output: */
+  const char *ncunits;
+};
+extern const struct imdgrd_output IMDGRD_DEFAULT_OUTPUT;
+
+/* byte orders of input files: */
+#define IMDGRD_ENDIAN_AUTO 0
+#define IMDGRD_ENDIAN_NATIVE 1
+#define IMDGRD_ENDIAN_LITTLE 2
+#define IMDGRD_ENDIAN_BIG 3
+extern const char *imdgrd_endian_names[];
+/*
+ * maximum number of days checked when detecting the byte order, and the
+ * smallest magnitude of a plausible non zero value. byte swapped values are
+ * often tiny or denormal:
+ */
+#define IMDGRD_ENDIAN_CHECK_DAYS 2
+#define IMDGRD_ENDIAN_MIN_MAGNITUDE 1e-6
+
+/* range of physically possible values for each data type: */
+extern const float imdgrd_qc_mins[];
+extern const float imdgrd_qc_maxs[];
+/* maximum number of alternative missing value markers: */
+#define IMDGRD_QC_MAX_MISSING 8
+
+/* define struct for storing quality control results for a single day: */
+struct imdgrd_qc_day {
+  /* whether the day has been checked: */
+  int checked;
+  /* numbers of valid, fill, remapped missing and out of range values: */
+  size_t valid;
+  size_t fill;
+  size_t missing;
+  size_t invalid;
+  /* minimum and maximum valid values: */
+  float min;
+  float max;
+};
+
+/*
+ * define struct for quality control settings, and results for each day. the
+ * results are allocated as days are checked:
+ */
+struct imdgrd_qc {
+  /* alternative missing value markers, which are remapped to the fill
+     value: */
+  float missing[IMDGRD_QC_MAX_MISSING];
+  int nmissing;
+  /* results for each day, and number of days allocated: */
+  struct imdgrd_qc_day *days;
+  int ndays;
+};
+
+/*
+ * periods for statistics, i.e. each month, june to september (the monsoon)
+ * and the whole year:
+ */
+#define IMDGRD_STATS_PERIODS 14
+#define IMDGRD_STATS_JJAS 12
+#define IMDGRD_STATS_ANNUAL 13
+extern const char *imdgrd_stats_periods;
+/* statistics: */
+#define IMDGRD_STAT_SUM 0
+#define IMDGRD_STAT_MEAN 1
+#define IMDGRD_STAT_MAX 2
+#define IMDGRD_STAT_MIN 3
+#define IMDGRD_STAT_RAINY_DAYS 4
+#define IMDGRD_STATS_COUNT 5
+extern const char *imdgrd_stats_names[];
+/* minimum rainfall for a rainy day, in mm: */
+#define IMDGRD_RAINY_DAY_THRESHOLD 2.5
+/* fill value for rainy day counts: */
+#define IMDGRD_RAINY_DAYS_FILL -1
+
+/*
+ * define struct for accumulating statistics for each period, from daily
+ * values. the arrays are allocated when the first day is added:
+ */
+struct imdgrd_stats {
+  /* number of grid points, or 0 if no values have been added: */
+  size_t count;
+  /* data type, year, number of days and fill value: */
+  int type;
+  int year;
+  int ndays;
+  float fill;
+  /* number of lats and lons, and lat and lon values: */
+  int nlats;
+  int nlons;
+  float *lats;
+  float *lons;
+  /* first and last day of each period: */
+  int period_start[IMDGRD_STATS_PERIODS];
+  int period_end[IMDGRD_STATS_PERIODS];
+  /*
+   * sum, maximum and minimum of valid values, number of valid values and
+   * number of rainy days, for each period and grid point:
+   */
+  float *sum;
+  float *max;
+  float *min;
+  int *valid;
+  int *rainy;
+};
+
+/*
+ * define struct for storing information about the grd file which an output
+ * file was converted from. this is recorded in the output file, so that the
+ * conversion can be skipped if the input file has not changed, or only new
+ * days converted if the input file has grown:
+ */
+struct imdgrd_source {
+  /* file size in bytes, and modification time in seconds since the epoch: */
+  long long size;
+  long long mtime;
+  /* number of days in the file: */
+  int days;
+  /* xxh64 hash of the values for all days: */
+  uint64_t hash;
+};
+/* number of bytes read at a time when hashing a file: */
+#define IMDGRD_HASH_BLOCK_SIZE 1048576
+
+/* output formats: */
+#define IMDGRD_FORMAT_NETCDF 0
+#define IMDGRD_FORMAT_ZARR 1
+extern const char *imdgrd_format_names[];
+
+/* define struct for storing netcdf output settings: */
+struct imdgrd_ncoptions {
+  /* chunk layout for the data variable: */
+  int chunk_layout;
+  /* chunk sizes (time, lat, lon) for the custom chunk layout: */
+  size_t chunk_sizes[3];
+  /* output precision type: */
+  int precision_type;
+  /* number of mantissa bits to keep, for the bits precision type: */
+  int precision_bits;
+  /* compression codec and level: */
+  int codec;
+  int level;
+  /* whether shuffle filter is enabled: */
+  int shuffle;
+  /* quality control of the values written, or NULL: */
+  struct imdgrd_qc *qc;
+  /* statistics to accumulate from the values written, or NULL: */
+  struct imdgrd_stats *stats;
+  /* input file information to record in the output file, or NULL: */
+  struct imdgrd_source *source;
+  /* output format: */
+  int format;
+  /* number of threads compressing zarr chunks, or 0 for one per
+     processor: */
+  int threads;
+  /* order of the dimensions of the data variable, for netcdf output: */
+  int layout;
+  /* regridding of the values to another grid, or NULL: */
+  struct imdgrd_regrid *regrid;
+};
+extern const struct imdgrd_ncoptions IMDGRD_DEFAULT_NCOPTIONS;
+
+/* define structs for storing data: */
+struct imdgrd_data {
+  /* data type: */
+  int type;
+  /* grid size: */
+  float grid;
+  /* number of lats: */
+  int nlats;
+  /* number of lons: */
+  int nlons;
+  /* initial lat value: */
+  float lat0;
+  /* initial lon value: */
+  float lon0;
+  /* year: */
+  int year;
+  /* number of days: */
+  int ndays;
+  /* day values: */
+  float *days;
+  /* lat values: */
+  float *lats;
+  /* lon values: */
+  float *lons;
+  /* size of a single data value in bytes: */
+  int datasize;
+  /* data: */
+  float *data;
+  /* whether data has been allocated by the library: */
+  int data_alloc;
+  /* fill value: */
+  float fill;
+  /* memory mapped input file, if data points in to a mapping: */
+  void *map;
+  /* size of the memory mapped input file: */
+  size_t map_size;
+  /* number of lats and lons in the grid of the input file: */
+  int grid_nlats;
+  int grid_nlons;
+  /* index in the grid of the first lat and lon of the data: */
+  int lat_start;
+  int lon_start;
+  /* grid points to keep (1) or set to the fill value (0), or NULL: */
+  unsigned char *mask;
+};
+
+/* define struct for reading data from a grd file one day at a time: */
+struct imdgrd_reader {
+  /* input file, if reading with stdio: */
+  FILE *file;
+  /* memory mapped input file, if memory mapping: */
+  void *map;
+  /* size of the memory mapped input file: */
+  size_t map_size;
+  /* buffer for a single day of values, if reading with stdio or a subset: */
+  float *buffer;
+  /* buffer for the rows containing a subset, if reading with stdio: */
+  float *rows;
+  /* number of values in a single day: */
+  size_t day_count;
+  /* whether values need byte swapping: */
+  int swap;
+  /* data struct, describing the values to read: */
+  struct imdgrd_data *data;
+};
+
+/*
+ * define struct for regridding values to another grid, with first order
+ * conservative remapping. each weight is the fraction of the area of a
+ * target grid cell covered by a source grid cell, and the weights are
+ * stored as a sparse matrix, with a compressed row for each target grid
+ * point. the weights are calculated for the grid of the data they are
+ * first used with, or read from the cache directory if they have been
+ * calculated before:
+ */
+struct imdgrd_regrid {
+  /* grid to regrid to: */
+  const struct imdgrd_grid *target;
+  /* directory for cached weights, or NULL: */
+  const char *cache_dir;
+  /* number of threads regridding days, or 0 for one per processor: */
+  int threads;
+  /*
+   * grid of the values the weights are for (lat0, lon0 and grid size), and
+   * number of lats and lons, or 0 if there are no weights:
+   */
+  float source[3];
+  int source_nlats;
+  int source_nlons;
+  /* number of target grid points, and number of weights: */
+  size_t ntarget;
+  size_t nweights;
+  /* index of the first weight for each target grid point, and the end of
+     the last row: */
+  uint32_t *rows;
+  /* source grid point and weight: */
+  uint32_t *columns;
+  float *weights;
+  /* whether the weights were read from the cache: */
+  int cached;
+  /* time spent calculating or reading the weights, in seconds: */
+  double weights_time;
+};
+
+/*
+ * define struct for storing the values waiting to be written to a netcdf
+ * data variable with the time-major layout. days are kept until the chunks
+ * for a block of days can be filled, then transposed and written together,
+ * so that each chunk is compressed and written once:
+ */
+struct imdgrd_time_major {
+  /* number of lats and lons, and size of a value in bytes: */
+  size_t nlats;
+  size_t nlons;
+  size_t value_size;
+  /* number of days in a chunk, which are transposed and written at once: */
+  size_t block_days;
+  /* days waiting to be written, the first of these days, and how many: */
+  unsigned char *days;
+  size_t first_day;
+  size_t ndays;
+  /* buffer for the transposed values: */
+  unsigned char *transposed;
+};
+
+/*
+ * define struct for storing the state of a zarr v2 directory store. the
+ * data variable is written a row of chunks (all chunks for the same days)
+ * at a time. days which do not fill a row are kept in the row buffer until
+ * the rest of the days are written:
+ */
+struct imdgrd_zarr {
+  /* store directory: */
+  char *path;
+  /* data variable name and units: */
+  char *var;
+  char *units;
+  /* data type and year: */
+  int type;
+  int year;
+  /* shape and chunk sizes (time, lat, lon) of the data variable: */
+  size_t shape[3];
+  size_t chunks[3];
+  /* size of a value in bytes, and the fill value as stored: */
+  size_t value_size;
+  unsigned char fill[sizeof(float)];
+  /* float fill value, for the metadata: */
+  float fill_value;
+  /* buffer for a row of chunks, and index of the next day to write: */
+  unsigned char *row;
+  size_t next_day;
+  /* number of threads compressing chunks: */
+  int threads;
+};
+
+/*
+ * define struct for sharing the chunks of one or more rows between the
+ * threads which compress and write them:
+ */
+struct imdgrd_zarr_rows {
+  /* zarr store: */
+  struct imdgrd_zarr *zarr;
+  /* values for whole days, from the first day of the first row, and number
+     of days: */
+  const unsigned char *values;
+  size_t ndays;
+  /* first row and number of rows to write: */
+  size_t first_row;
+  size_t nrows;
+  /* number of chunks in a row, and index of the next chunk to write: */
+  size_t row_chunks;
+  size_t next;
+  /* compression codec and level, and whether shuffle filter is enabled: */
+  int codec;
+  int level;
+  int shuffle;
+  /*
+   * errno value, or negative zlib error code, and failed operation, after
+   * an error:
+   */
+  int err;
+  const char *error;
+  /* lock for access to the next chunk and error: */
+  pthread_mutex_t lock;
+};
+
+/* define struct for storing netcdf output file ids: */
+struct imdgrd_ncfile {
+  /* netcdf id: */
+  int ncid;
+  /* variable ids: */
+  int time_var;
+  int lat_var;
+  int lon_var;
+  int data_var;
+  /* output settings: */
+  struct imdgrd_ncoptions ncoptions;
+  /* buffer for converting data to the output precision: */
+  void *pack_buffer;
+  /* size of the conversion buffer in bytes: */
+  size_t pack_size;
+  /* buffer for values with missing value markers remapped, and size in
+     bytes: */
+  float *qc_buffer;
+  size_t qc_size;
+  /* zarr store, when writing zarr output, or NULL: */
+  struct imdgrd_zarr *zarr;
+  /* values waiting to be written with the time-major layout, or NULL: */
+  struct imdgrd_time_major *time_major;
+  /*
+   * grid of the values written when regridding, or NULL, and buffer for
+   * regridded values, and size in bytes:
+   */
+  struct imdgrd_data *regrid_data;
+  float *regrid_buffer;
+  size_t regrid_size;
+  /*
+   * netcdf error code and failed operation, after an error. for zarr
+   * output, the errno value is stored, or the zlib error code when
+   * compressing failed:
+   */
+  int ncerr;
+  const char *error;
+  /*
+   * time spent defining the file, converting values (quality control,
+   * statistics and output precision), putting values and closing the file,
+   * in seconds. compression happens when values are put, or when cached
+   * chunks are flushed on closing:
+   */
+  double define_time;
+  double convert_time;
+  double put_time;
+  double close_time;
+  /* number of netcdf calls putting values in to the file: */
+  size_t put_calls;
+};
+
+/*
+ * define struct for storing a netcdf file which is being read back, for
+ * writing as grd. values are read a block of days at a time, and returned
+ * in the grd layout, for the whole grid:
+ */
+struct imdgrd_ncinput {
+  /* input file name: */
+  const char *filename;
+  /* netcdf id and data variable id: */
+  int ncid;
+  int data_var;
+  /* grid of the data: */
+  const struct imdgrd_grid *grid;
+  /*
+   * number of lats and lons in the file, grid indexes of the first lat and
+   * lon, and whether lats are in descending order:
+   */
+  int nlats;
+  int nlons;
+  int lat0;
+  int lon0;
+  int lat_descending;
+  /* order of the dimensions of the data variable: */
+  int layout;
+  /* number of days, and the year and day of the year (from 0) of the first
+     day: */
+  int ndays;
+  int year;
+  int day;
+  /* number of days in a block, read at once, from the time chunk size: */
+  size_t block_days;
+  /* fill value and missing value in the file, if any, and unpacking: */
+  int has_fill;
+  float fill;
+  int has_missing;
+  float missing;
+  float scale;
+  float offset;
+  /* buffers for a block of days as read, and transposed: */
+  float *buffer;
+  float *transposed;
+  /* netcdf error code and failed operation, after an error: */
+  int ncerr;
+  const char *error;
+  /* time spent reading and converting values, in seconds: */
+  double read_time;
+  double convert_time;
+};
+
+/* netcdf creation flags: */
+#define IMDGRD_NC_CREATE_FLAGS NC_CLOBBER|NC_NETCDF4
+/* netcdf variable names, etc.: */
+#define IMDGRD_NC_TIME_VAR "time"
+#define IMDGRD_NC_LAT_VAR "latitude"
+#define IMDGRD_NC_LON_VAR "longitude"
+#define IMDGRD_NC_CAL "calendar"
+#define IMDGRD_NC_CAL_TYPE "standard"
+#define IMDGRD_NC_UNITS "units"
+#define IMDGRD_NC_TIME_UNITS "days since XXXX-1-1 0:0:0"
+#define IMDGRD_NC_LAT_UNITS "degrees_north"
+#define IMDGRD_NC_LON_UNITS "degrees_east"
+#define IMDGRD_NC_FILLV "_FillValue"
+#define IMDGRD_NC_SCALE "scale_factor"
+#define IMDGRD_NC_OFFSET "add_offset"
+#define IMDGRD_NC_NSB "quantization_nsb"
+#define IMDGRD_NC_MISSING "missing_value"
+/*
+ * other names of the latitude and longitude dimensions accepted when
+ * reading netcdf files, and the calendars which have the same days as grd
+ * files:
+ */
+#define IMDGRD_NC_LAT_NAME "lat"
+#define IMDGRD_NC_LON_NAME "lon"
+#define IMDGRD_NC_CAL_GREGORIAN "gregorian"
+#define IMDGRD_NC_CAL_PROLEPTIC "proleptic_gregorian"
+/*
+ * first day of the gregorian calendar, as a year and day of the year (from
+ * 0). the standard and gregorian calendars are julian before this day:
+ */
+#define IMDGRD_GREGORIAN_YEAR 1582
+#define IMDGRD_GREGORIAN_DAY 287
+/* days read at a time from a netcdf file with no time chunking: */
+#define IMDGRD_NC_READ_DAYS 32
+/* netcdf global attributes for the input file information: */
+#define IMDGRD_NC_SOURCE_SIZE "source_size"
+#define IMDGRD_NC_SOURCE_MTIME "source_mtime"
+#define IMDGRD_NC_SOURCE_DAYS "source_days"
+#define IMDGRD_NC_SOURCE_HASH "source_xxh64"
+/* netcdf names for statistics output: */
+#define IMDGRD_NC_PERIOD_VAR "period"
+#define IMDGRD_NC_PERIOD_START "period_start"
+#define IMDGRD_NC_PERIOD_END "period_end"
+#define IMDGRD_NC_FLAG_VALUES "flag_values"
+#define IMDGRD_NC_FLAG_MEANINGS "flag_meanings"
+#define IMDGRD_NC_RAINY_DAYS_VAR "rainy_days"
+#define IMDGRD_NC_RAINY_DAYS_UNITS "days"
+/* zarr metadata, and chunk sizes used if no chunk layout is requested: */
+#define IMDGRD_ZARR_FORMAT 2
+#define IMDGRD_ZARR_GROUP ".zgroup"
+#define IMDGRD_ZARR_ARRAY ".zarray"
+#define IMDGRD_ZARR_ATTRS ".zattrs"
+#define IMDGRD_ZARR_METADATA ".zmetadata"
+#define IMDGRD_ZARR_DIMENSIONS "_ARRAY_DIMENSIONS"
+#define IMDGRD_ZARR_CHUNK_DAYS 32
+#define IMDGRD_ZARR_CHUNK_TILE 64
+/* maximum number of threads compressing zarr chunks: */
+#define IMDGRD_ZARR_MAX_THREADS 256
+/* default deflate compression level: */
+#define IMDGRD_NC_COMP 3
+/*
+ * default chunk cache size in bytes, and number of cache slots and
+ * preemption used if a larger chunk cache is needed:
+ */
+#define IMDGRD_NC_CHUNK_CACHE 4194304
+#define IMDGRD_NC_CHUNK_CACHE_NELEMS 4133
+#define IMDGRD_NC_CHUNK_CACHE_PREEMPTION 0.75
+
+/* describe an error code: */
+const char *imdgrd_strerror(int err);
+
+/* grids: */
+int imdgrd_add_grid(const struct imdgrd_grid *grid);
+int imdgrd_load_grids(const char *filename, int *line);
+const struct imdgrd_grid *imdgrd_find_grid(int size, int *days);
+const struct imdgrd_grid *imdgrd_get_grid(const char *name);
+
+/* input files: */
+int imdgrd_year_days(int year);
+int imdgrd_file_exists(const char *filename);
+int imdgrd_get_input(const char *filename, struct imdgrd_input *input);
+int imdgrd_get_partial_input(const char *filename, struct imdgrd_input *input);
+int imdgrd_check_input(struct imdgrd_input *input_in, int type, int year,
+                       struct imdgrd_input *input_out);
+
+/* byte order: */
+int imdgrd_host_big_endian(void);
+int imdgrd_set_byte_order(struct imdgrd_input *input, int endian);
+void imdgrd_swap_values(const float *values, float *swapped, size_t count);
+
+/* recording input files for incremental conversion: */
+int imdgrd_hash_file(const char *filename, size_t length, size_t prefix,
+                     uint64_t *hash, uint64_t *prefix_hash);
+int imdgrd_stat_source(struct imdgrd_input *input,
+                       struct imdgrd_source *source);
+int imdgrd_hash_source(struct imdgrd_input *input,
+                       struct imdgrd_source *source, int prefix_days,
+                       uint64_t *prefix_hash);
+
+/* reading whole files: */
+int imdgrd_init_data(struct imdgrd_input *input, struct imdgrd_data *data);
+size_t imdgrd_data_count(struct imdgrd_data *data);
+int imdgrd_read_data(struct imdgrd_input *input, struct imdgrd_data *data,
+                     float *buffer, size_t *nread);
+int imdgrd_map_data(struct imdgrd_input *input, struct imdgrd_data *data,
+                    size_t *nread);
+void imdgrd_free_data(struct imdgrd_data *data);
+
+/* selecting a subset of the grid: */
+int imdgrd_set_bbox(struct imdgrd_data *data, float lat0, float lat1,
+                    float lon0, float lon1);
+int imdgrd_load_mask(struct imdgrd_data *data, const char *filename);
+
+/* reading one day at a time: */
+int imdgrd_open_reader(struct imdgrd_input *input, struct imdgrd_data *data,
+                       struct imdgrd_reader *reader, int use_mmap);
+int imdgrd_seek_reader(struct imdgrd_reader *reader, int day);
+float *imdgrd_read_day(struct imdgrd_reader *reader, int day);
+int imdgrd_read_day_into(struct imdgrd_reader *reader, int day, float *buffer);
+void imdgrd_close_reader(struct imdgrd_reader *reader);
+
+/* reading time series for a single grid point: */
+int imdgrd_find_point(struct imdgrd_input *input, float lat, float lon,
+                      int *lat_index, int *lon_index);
+long long imdgrd_point_offset(const struct imdgrd_grid *grid, int day,
+                              int lat_index, int lon_index);
+int imdgrd_read_point(struct imdgrd_input *input, int lat_index, int lon_index,
+                      int first_day, int ndays, float *values);
+
+/* conversion of values to the output precision: */
+void imdgrd_pack_values(const float *values, short *packed, size_t count,
+                        float fill, float scale, float offset);
+void imdgrd_round_values(const float *values, float *rounded, size_t count,
+                         float fill, int bits);
+void imdgrd_transpose_values(const void *values, void *transposed,
+                             size_t nrows, size_t ncols, size_t value_size);
+
+/* regridding: */
+void imdgrd_init_regrid(struct imdgrd_regrid *regrid,
+                        const struct imdgrd_grid *target,
+                        const char *cache_dir, int threads);
+int imdgrd_regrid_weights(struct imdgrd_regrid *regrid,
+                          struct imdgrd_data *data);
+int imdgrd_init_regrid_data(struct imdgrd_regrid *regrid,
+                            struct imdgrd_data *data,
+                            struct imdgrd_data *target);
+void imdgrd_regrid_values(struct imdgrd_regrid *regrid, const float *values,
+                          float *regridded, size_t ndays, float fill);
+void imdgrd_free_regrid(struct imdgrd_regrid *regrid);
+
+/* quality control: */
+void imdgrd_check_values(const float *values, float *remapped, size_t count,
+                         float fill, float min, float max,
+                         const float *missing, int nmissing,
+                         struct imdgrd_qc_day *result);
+void imdgrd_init_qc(struct imdgrd_qc *qc);
+int imdgrd_qc_day(struct imdgrd_qc *qc, struct imdgrd_data *data, int day,
+                  const float *values, float *remapped);
+void imdgrd_free_qc(struct imdgrd_qc *qc);
+
+/* statistics: */
+void imdgrd_init_stats(struct imdgrd_stats *stats);
+int imdgrd_add_stats(struct imdgrd_stats *stats, struct imdgrd_data *data,
+                     int day, const float *values);
+void imdgrd_free_stats(struct imdgrd_stats *stats);
+
+/* writing netcdf: */
+int imdgrd_codec_available(int codec);
+int imdgrd_zarr_available(int codec);
+int imdgrd_create_output(struct imdgrd_data *data,
+                         struct imdgrd_output *output,
+                         struct imdgrd_ncoptions *ncoptions,
+                         struct imdgrd_ncfile *ncfile);
+int imdgrd_put_data(struct imdgrd_ncfile *ncfile, struct imdgrd_data *data,
+                    size_t *nc_start, size_t *nc_count, float *values);
+#ifdef USE_MPI
+int imdgrd_create_output_par(struct imdgrd_data *data,
+                             struct imdgrd_output *output,
+                             struct imdgrd_ncoptions *ncoptions, MPI_Comm comm,
+                             struct imdgrd_ncfile *ncfile);
+int imdgrd_put_none(struct imdgrd_ncfile *ncfile);
+#endif
+int imdgrd_write_day(struct imdgrd_ncfile *ncfile, struct imdgrd_data *data,
+                     int day, float *values);
+int imdgrd_close_output(struct imdgrd_ncfile *ncfile);
+int imdgrd_write_data(struct imdgrd_data *data, struct imdgrd_output *output,
+                      struct imdgrd_ncoptions *ncoptions,
+                      struct imdgrd_ncfile *ncfile);
+int imdgrd_write_stats(struct imdgrd_stats *stats,
+                       struct imdgrd_output *output,
+                       struct imdgrd_ncoptions *ncoptions,
+                       struct imdgrd_ncfile *ncfile);
+int imdgrd_put_source(struct imdgrd_ncfile *ncfile,
+                      struct imdgrd_source *source);
+int imdgrd_read_source(const char *filename, struct imdgrd_source *source);
+int imdgrd_open_output(struct imdgrd_data *data, struct imdgrd_output *output,
+                       struct imdgrd_ncoptions *ncoptions,
+                       struct imdgrd_ncfile *ncfile, int *ndays);
+int imdgrd_stream_days(struct imdgrd_input *input, struct imdgrd_data *data,
+                       struct imdgrd_ncfile *ncfile, int offset, int use_mmap,
+                       int *ndone);
+
+/* reading netcdf files back, for writing as grd: */
+int imdgrd_open_ncinput(const char *filename, const char *ncvar,
+                        struct imdgrd_ncinput *ncinput);
+int imdgrd_read_ncinput(struct imdgrd_ncinput *ncinput, int first_day,
+                        int ndays, float *values);
+void imdgrd_close_ncinput(struct imdgrd_ncinput *ncinput);
+
+#endif
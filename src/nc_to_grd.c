@@ -0,0 +1,339 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+#include <imdgrd.h>
+#include <nc_to_grd.h>
+
+/*
+ * convert NetCDF files, such as those written by imd_grd_to_nc, back to IMD
+ * GRD files, for programs which still read GRD. a file holding more than
+ * one year is written as one GRD file for each year
+ */
+
+/* print program usage information, and exit: */
+void usage(const char *program_name) {
+  printf("Usage: %s -i input-file [-o output-file] [-v netcdf-varname] "
+         "[-c] [-p] [-e byte-order]\n"
+         "\n"
+         "Convert a NetCDF file of daily values on an IMD grid to GRD\n"
+         "\n"
+         "  -i --infile   The input NetCDF file to read\n"
+         "  -o --outfile  The output GRD file to create. If the input has\n"
+         "                more than one year, a GRD file is written for each\n"
+         "                year, and the name has to contain '%s', which is\n"
+         "                replaced by the year. If not specified, the input\n"
+         "                file name is used, with '_%s' added for more\n"
+         "                than one year, and the extension '%s'\n"
+         "  -v --ncvar    The NetCDF variable to convert. If not specified,\n"
+         "                the first variable with three dimensions is used\n"
+         "  -c --clobber  Overwrite existing output files\n"
+         "  -p --partial  Write the last year even if it does not have all\n"
+         "                of its days, as a file for the current year\n"
+         "  -e --endian   Byte order of the output files: 'native'\n"
+         "                (default), 'little' or 'big'\n",
+         program_name, YEAR_PATTERN, YEAR_PATTERN, GRD_EXT);
+  exit(1);
+}
+
+/* get program options: */
+struct _options get_options(int argc, char **argv) {
+  /* create the struct for storing program options: */
+  struct _options options = DEFAULT_OPTIONS;
+  /* define the possible getopt options: */
+  static struct option long_options[] = {
+    {"infile", required_argument, 0, 'i'},
+    {"outfile", required_argument, 0, 'o'},
+    {"ncvar", required_argument, 0, 'v'},
+    {"clobber", no_argument, 0, 'c'},
+    {"partial", no_argument, 0, 'p'},
+    {"endian", required_argument, 0, 'e'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+  /* opt will be returned by getopt_long: */
+  int opt;
+  /* loop through arguments: */
+  while ((opt = getopt_long(argc, argv, "i:o:v:cpe:h", long_options,
+                            NULL)) != -1) {
+    switch (opt) {
+      case 'i':
+        options.infile = optarg;
+        break;
+      case 'o':
+        options.outfile = optarg;
+        break;
+      case 'v':
+        options.ncvar = optarg;
+        break;
+      case 'c':
+        options.clobber = 1;
+        break;
+      case 'p':
+        options.partial = 1;
+        break;
+      case 'e':
+        if (strcmp(optarg, imdgrd_endian_names[IMDGRD_ENDIAN_NATIVE]) == 0) {
+          options.endian = IMDGRD_ENDIAN_NATIVE;
+        } else if (strcmp(optarg,
+                          imdgrd_endian_names[IMDGRD_ENDIAN_LITTLE]) == 0) {
+          options.endian = IMDGRD_ENDIAN_LITTLE;
+        } else if (strcmp(optarg,
+                          imdgrd_endian_names[IMDGRD_ENDIAN_BIG]) == 0) {
+          options.endian = IMDGRD_ENDIAN_BIG;
+        } else {
+          fprintf(stderr, "Invalid byte order specified: %s\n", optarg);
+          exit(1);
+        }
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  /* input file is required: */
+  if (strcmp(options.infile, "") == 0) {
+    usage(argv[0]);
+  }
+  /* return the program options: */
+  return options;
+}
+
+/*
+ * get the output file name pattern. if no output file is specified, the
+ * input file name is used, without its extension, and with the year added
+ * if there is more than one year:
+ */
+char *get_pattern(struct _options *options, int nyears) {
+  /* output file name pattern: */
+  char *pattern;
+  /* start of the input file name, and of its extension: */
+  const char *name, *ext;
+  /* length of the input file name without its extension: */
+  size_t len;
+  if (strcmp(options->outfile, "") != 0) {
+    return strdup(options->outfile);
+  }
+  name = strrchr(options->infile, '/');
+  name = (name != NULL) ? name + 1 : options->infile;
+  ext = strrchr(name, '.');
+  len = (ext != NULL) ? (size_t) (ext - options->infile) :
+        strlen(options->infile);
+  if ((pattern = malloc(len + strlen(YEAR_PATTERN) + strlen(GRD_EXT) +
+                        2)) != NULL) {
+    sprintf(pattern, "%.*s%s%s%s", (int) len, options->infile,
+            (nyears > 1) ? "_" : "", (nyears > 1) ? YEAR_PATTERN : "",
+            GRD_EXT);
+  }
+  return pattern;
+}
+
+/*
+ * get the output file name for a year, from the pattern, replacing the
+ * first YEAR_PATTERN with the year:
+ */
+char *get_filename(const char *pattern, int year) {
+  /* output file name: */
+  char *filename;
+  /* position of the year in the pattern: */
+  const char *match = strstr(pattern, YEAR_PATTERN);
+  /* the year has at most 4 digits, so the name is no longer than the
+     pattern plus 2: */
+  if ((filename = malloc(strlen(pattern) + 3)) == NULL) {
+    return NULL;
+  }
+  if (match == NULL) {
+    strcpy(filename, pattern);
+  } else {
+    sprintf(filename, "%.*s%04d%s", (int) (match - pattern), pattern, year,
+            match + strlen(YEAR_PATTERN));
+  }
+  return filename;
+}
+
+/*
+ * finish a grd file, with the trailing byte found at the end of grd files,
+ * and close it. returns 0 if the file has been written:
+ */
+int close_grd(FILE *output_file) {
+  /* return value: */
+  int status = 0;
+  if (fputc(0, output_file) == EOF) {
+    status = 1;
+  }
+  if (fclose(output_file) != 0) {
+    status = 1;
+  }
+  return status;
+}
+
+/* display an error returned by the library: */
+void print_error(int status, struct imdgrd_ncinput *ncinput) {
+  if (status == IMDGRD_ENETCDF) {
+    fprintf(stderr, "NetCDF error %s: %s\n", ncinput->error,
+            nc_strerror(ncinput->ncerr));
+  } else {
+    fprintf(stderr, "%s: %s\n", imdgrd_strerror(status), ncinput->filename);
+  }
+}
+
+/* main program: */
+int main(int argc, char **argv) {
+  /* program options: */
+  struct _options options = get_options(argc, argv);
+  /* netcdf input file: */
+  struct imdgrd_ncinput ncinput;
+  /* number of years, and days in the last year: */
+  int nyears, last_days;
+  /* output file name pattern, and file name for each year: */
+  char *pattern = NULL;
+  char **filenames = NULL;
+  /* whether values need byte swapping: */
+  int swap;
+  /* number of values in a day, and values for a block of days: */
+  size_t count;
+  float *values = NULL;
+  /* first day and number of days in the block, and days still to write: */
+  int first_day, ndays, left;
+  /* output file, the year being written, and days written to it: */
+  FILE *output_file = NULL;
+  int year, done = 0;
+  /* next values to write, and number of days to write to the file: */
+  float *next;
+  int n;
+  /* return status: */
+  int status = 0;
+  /* for loop integers: */
+  int i;
+  /* open the input file: */
+  if ((status = imdgrd_open_ncinput(options.infile, options.ncvar,
+                                    &ncinput)) != IMDGRD_OK) {
+    print_error(status, &ncinput);
+    exit(1);
+  }
+  /* grd files start on 1 january: */
+  if (ncinput.day != 0) {
+    fprintf(stderr, "The first day of %s is not 1 January: day %d of %d\n",
+            options.infile, ncinput.day + 1, ncinput.year);
+    imdgrd_close_ncinput(&ncinput);
+    exit(1);
+  }
+  /* find the number of years, and the number of days in the last year: */
+  nyears = 0;
+  last_days = ncinput.ndays;
+  for (year = ncinput.year; last_days > imdgrd_year_days(year); year++) {
+    last_days -= imdgrd_year_days(year);
+    nyears++;
+  }
+  nyears++;
+  if ((last_days < imdgrd_year_days(year)) && (options.partial != 1)) {
+    fprintf(stderr, "Year %d has %d of %d days. Use -p to write a file "
+                    "with only the first days of the year\n", year,
+            last_days, imdgrd_year_days(year));
+    imdgrd_close_ncinput(&ncinput);
+    exit(1);
+  }
+  if ((nyears > 1) && (strcmp(options.outfile, "") != 0) &&
+      (strstr(options.outfile, YEAR_PATTERN) == NULL)) {
+    fprintf(stderr, "The input file has %d years, so the output file name "
+                    "has to contain %s\n", nyears, YEAR_PATTERN);
+    imdgrd_close_ncinput(&ncinput);
+    exit(1);
+  }
+  /* get the output file names, and check they do not exist: */
+  pattern = get_pattern(&options, nyears);
+  filenames = calloc(nyears, sizeof(char *));
+  count = (size_t) ncinput.grid->nlats * ncinput.grid->nlons;
+  values = malloc(ncinput.block_days * count * sizeof(float));
+  if ((pattern == NULL) || (filenames == NULL) || (values == NULL)) {
+    fprintf(stderr, "Unable to allocate memory\n");
+    status = 1;
+  }
+  for (i = 0; (status == 0) && (i < nyears); i++) {
+    if ((filenames[i] = get_filename(pattern, ncinput.year + i)) == NULL) {
+      fprintf(stderr, "Unable to allocate memory\n");
+      status = 1;
+    } else if ((imdgrd_file_exists(filenames[i]) != -1) &&
+               (options.clobber != 1)) {
+      fprintf(stderr, "Output file: %s exists. Use -c option to "
+                      "overwrite\n", filenames[i]);
+      status = 1;
+    }
+  }
+  swap = ((options.endian == IMDGRD_ENDIAN_LITTLE) &&
+          imdgrd_host_big_endian()) ||
+         ((options.endian == IMDGRD_ENDIAN_BIG) && !imdgrd_host_big_endian());
+  /*
+   * read a block of days at a time, and write the days of the block for
+   * each year with a single write:
+   */
+  year = 0;
+  for (first_day = 0; (status == 0) && (first_day < ncinput.ndays);
+       first_day += ndays) {
+    ndays = ncinput.ndays - first_day;
+    ndays = ((size_t) ndays < ncinput.block_days) ? ndays :
+            (int) ncinput.block_days;
+    if ((status = imdgrd_read_ncinput(&ncinput, first_day, ndays,
+                                      values)) != IMDGRD_OK) {
+      print_error(status, &ncinput);
+      status = 1;
+      break;
+    }
+    if (swap == 1) {
+      imdgrd_swap_values(values, values, ndays * count);
+    }
+    next = values;
+    for (left = ndays; left > 0; left -= n) {
+      if ((output_file == NULL) &&
+          ((output_file = fopen(filenames[year], "wb")) == NULL)) {
+        fprintf(stderr, "Unable to open output file: %s\n",
+                filenames[year]);
+        status = 1;
+        break;
+      }
+      n = imdgrd_year_days(ncinput.year + year) - done;
+      n = (n < left) ? n : left;
+      if (fwrite(next, count * sizeof(float), n, output_file) !=
+          (size_t) n) {
+        fprintf(stderr, "Error writing output file: %s\n", filenames[year]);
+        status = 1;
+        break;
+      }
+      next += n * count;
+      done += n;
+      /* the year is complete: */
+      if (done == imdgrd_year_days(ncinput.year + year)) {
+        status = close_grd(output_file);
+        output_file = NULL;
+        if (status != 0) {
+          fprintf(stderr, "Error writing output file: %s\n",
+                  filenames[year]);
+          break;
+        }
+        year++;
+        done = 0;
+      }
+    }
+  }
+  /* finish the last year, if it is not complete: */
+  if (output_file != NULL) {
+    if (status == 0) {
+      status = close_grd(output_file);
+      if (status != 0) {
+        fprintf(stderr, "Error writing output file: %s\n", filenames[year]);
+      }
+    } else {
+      fclose(output_file);
+    }
+  }
+  /* tidy up: */
+  imdgrd_close_ncinput(&ncinput);
+  free(values);
+  free(pattern);
+  for (i = 0; (filenames != NULL) && (i < nyears); i++) {
+    free(filenames[i]);
+  }
+  free(filenames);
+  /* exit: */
+  exit(status);
+}
@@ -0,0 +1,23 @@
+/* extension for output files: */
+#define GRD_EXT ".grd"
+/* text replaced by the year in output file names: */
+#define YEAR_PATTERN "%Y"
+
+/* define struct for storing program options: */
+struct _options {
+  /* input file: */
+  const char *infile;
+  /* output file, or pattern containing YEAR_PATTERN: */
+  const char *outfile;
+  /* data variable name, or empty for the first variable on a grid: */
+  const char *ncvar;
+  /* whether output files should be overwritten: */
+  int clobber;
+  /* whether a year with fewer days than a whole year should be written: */
+  int partial;
+  /* byte order of the output files: */
+  int endian;
+};
+const struct _options DEFAULT_OPTIONS = {
+  "", "", "", 0, 0, IMDGRD_ENDIAN_NATIVE
+};